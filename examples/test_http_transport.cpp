@@ -0,0 +1,319 @@
+#include <ioc_gaialib/gaia_client.h>
+#include <ioc_gaialib/types.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <algorithm>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace ioc::gaia;
+
+// ANSI color codes for better output
+#define RESET   "\033[0m"
+#define RED     "\033[31m"
+#define GREEN   "\033[32m"
+#define BLUE    "\033[34m"
+#define CYAN    "\033[36m"
+#define BOLD    "\033[1m"
+
+void printHeader(const std::string& title) {
+    std::cout << "\n" << BOLD << CYAN << "═══════════════════════════════════════════════════════" << RESET << "\n";
+    std::cout << BOLD << CYAN << "  " << title << RESET << "\n";
+    std::cout << BOLD << CYAN << "═══════════════════════════════════════════════════════" << RESET << "\n\n";
+}
+
+void printSuccess(const std::string& msg) {
+    std::cout << GREEN << "✓ " << msg << RESET << "\n";
+}
+
+void printError(const std::string& msg) {
+    std::cout << RED << "✗ " << msg << RESET << "\n";
+}
+
+void printInfo(const std::string& msg) {
+    std::cout << BLUE << "ℹ " << msg << RESET << "\n";
+}
+
+/**
+ * Minimal keep-alive HTTP/1.1 stand-in for the Gaia TAP service
+ *
+ * Answers every POST with a small CSV table, except queries carrying a
+ * marker: RETRY503 / RETRY429 fail once with that status, BAD400 always
+ * fails with 400. Counts accepted connections, attempts per marker and
+ * the arrival time of every request.
+ */
+class LocalTapServer {
+public:
+    LocalTapServer() {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;  // Any free port
+        socklen_t length = sizeof(address);
+        if (listen_fd_ < 0 ||
+            bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(listen_fd_, 64) != 0 ||
+            getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            throw std::runtime_error("Cannot start local HTTP listener");
+        }
+        port_ = ntohs(address.sin_port);
+        acceptor_ = std::thread([this] { acceptLoop(); });
+    }
+
+    ~LocalTapServer() {
+        stopping_ = true;
+        shutdown(listen_fd_, SHUT_RDWR);
+        close(listen_fd_);
+        acceptor_.join();
+        std::vector<std::thread> handlers;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int fd : client_fds_) {
+                shutdown(fd, SHUT_RDWR);
+            }
+            handlers.swap(handlers_);
+        }
+        for (auto& handler : handlers) {
+            handler.join();
+        }
+    }
+
+    std::string url() const {
+        return "http://127.0.0.1:" + std::to_string(port_) + "/tap/sync";
+    }
+
+    int connections() const { return connections_.load(); }
+    int requests() const { return requests_.load(); }
+
+    int attempts(const std::string& marker) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return attempts_[marker];
+    }
+
+    std::vector<std::chrono::steady_clock::time_point> arrivals(const std::string& marker) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return arrivals_[marker];
+    }
+
+private:
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::atomic<bool> stopping_{false};
+    std::atomic<int> connections_{0};
+    std::atomic<int> requests_{0};
+    std::thread acceptor_;
+    std::mutex mutex_;
+    std::vector<std::thread> handlers_;  // Guarded by mutex_
+    std::vector<int> client_fds_;        // Guarded by mutex_
+    std::map<std::string, int> attempts_;
+    std::map<std::string, std::vector<std::chrono::steady_clock::time_point>> arrivals_;
+
+    void acceptLoop() {
+        while (!stopping_) {
+            int fd = accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0) continue;
+            ++connections_;
+            std::lock_guard<std::mutex> lock(mutex_);
+            client_fds_.push_back(fd);
+            handlers_.emplace_back([this, fd] { serve(fd); });
+        }
+    }
+
+    void closeClient(int fd) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        client_fds_.erase(std::remove(client_fds_.begin(), client_fds_.end(), fd), client_fds_.end());
+        close(fd);
+    }
+
+    // Requests on one connection, until the client closes it
+    void serve(int fd) {
+        std::string buffer;
+        char chunk[4096];
+        for (;;) {
+            size_t header_end;
+            while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) {
+                    closeClient(fd);
+                    return;
+                }
+                buffer.append(chunk, n);
+            }
+
+            size_t content_length = 0;
+            std::string headers = buffer.substr(0, header_end);
+            std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+            size_t field = headers.find("content-length:");
+            if (field != std::string::npos) {
+                content_length = std::stoul(headers.substr(field + 15));
+            }
+            while (buffer.size() < header_end + 4 + content_length) {
+                ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) {
+                    closeClient(fd);
+                    return;
+                }
+                buffer.append(chunk, n);
+            }
+            std::string body = buffer.substr(header_end + 4, content_length);
+            buffer.erase(0, header_end + 4 + content_length);
+
+            std::string response = respond(body);
+            if (send(fd, response.data(), response.size(), MSG_NOSIGNAL) < 0) {
+                closeClient(fd);
+                return;
+            }
+        }
+    }
+
+    std::string respond(const std::string& body) {
+        ++requests_;
+        std::string marker = "CONE";
+        for (const char* candidate : {"RETRY503", "RETRY429", "BAD400", "RATE"}) {
+            if (body.find(candidate) != std::string::npos) marker = candidate;
+        }
+
+        int attempt;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            attempt = ++attempts_[marker];
+            arrivals_[marker].push_back(std::chrono::steady_clock::now());
+        }
+
+        if (marker == "RETRY503" && attempt == 1) return reply("503 Service Unavailable", "");
+        if (marker == "RETRY429" && attempt == 1) return reply("429 Too Many Requests", "");
+        if (marker == "BAD400") return reply("400 Bad Request", "");
+
+        // Slow enough that concurrent queries overlap on the wire
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::string csv = "source_id,ra,dec,parallax,parallax_error,pmra,pmdec,pmra_error,pmdec_error,"
+                          "phot_g_mean_mag,phot_bp_mean_mag,phot_rp_mean_mag,"
+                          "astrometric_excess_noise,astrometric_chi2_al,visibility_periods_used\n";
+        for (int i = 0; i < 10; ++i) {
+            csv += std::to_string(1000 + i) + ",10.0" + std::to_string(i) +
+                   ",20.0,1.0,0.1,2.0,3.0,0.1,0.1,12.5,13.0,12.0,0.1,1.0,10\n";
+        }
+        return reply("200 OK", csv);
+    }
+
+    static std::string reply(const std::string& status, const std::string& content) {
+        return "HTTP/1.1 " + status + "\r\n"
+               "Content-Type: text/csv\r\n"
+               "Content-Length: " + std::to_string(content.size()) + "\r\n"
+               "\r\n" + content;
+    }
+};
+
+int main() {
+    printHeader("IOC_GaiaLib: HTTP Transport Test (local TAP listener)");
+
+    LocalTapServer server;
+    printInfo("Listening on " + server.url());
+
+    int failures = 0;
+    auto check = [&](bool ok, const std::string& what) {
+        if (ok) {
+            printSuccess(what);
+        } else {
+            printError(what);
+            ++failures;
+        }
+    };
+
+    GaiaClient client;
+    client.setTapUrl(server.url());
+    client.setRateLimit(0);
+    client.setTimeout(10);
+    client.setMaxRetries(3);
+
+    // 1. 5xx and 429 are retried (first backoff step is 2 s)
+    std::cout << "\n" << BOLD << "Retries" << RESET << "\n";
+    for (const std::string marker : {"RETRY503", "RETRY429"}) {
+        try {
+            auto stars = client.queryADQL("SELECT " + marker);
+            check(stars.size() == 10 && server.attempts(marker) == 2,
+                  marker.substr(5) + " retried once, then " + std::to_string(stars.size()) + " stars");
+        } catch (const GaiaException& e) {
+            check(false, marker.substr(5) + " not retried: " + e.what());
+        }
+    }
+
+    // 2. 4xx fails at once
+    try {
+        client.queryADQL("SELECT BAD400");
+        check(false, "400 did not throw");
+    } catch (const GaiaException& e) {
+        check(server.attempts("BAD400") == 1,
+              "400 failed without retry (" + std::string(e.what()) + ", " +
+              std::to_string(server.attempts("BAD400")) + " attempt)");
+    }
+
+    // 3. Rate limiter spaces requests: 120/min = one every 500 ms
+    std::cout << "\n" << BOLD << "Rate limiting" << RESET << "\n";
+    {
+        GaiaClient limited;
+        limited.setTapUrl(server.url());
+        limited.setRateLimit(120);
+
+        std::vector<std::future<std::vector<GaiaStar>>> pending;
+        for (int i = 0; i < 4; ++i) {
+            pending.push_back(limited.queryADQLAsync("SELECT RATE " + std::to_string(i)));
+        }
+        for (auto& future : pending) {
+            future.get();
+        }
+
+        auto arrivals = server.arrivals("RATE");
+        std::sort(arrivals.begin(), arrivals.end());
+        double min_gap_ms = 1e9;
+        for (size_t i = 1; i < arrivals.size(); ++i) {
+            min_gap_ms = std::min(min_gap_ms,
+                std::chrono::duration<double, std::milli>(arrivals[i] - arrivals[i - 1]).count());
+        }
+        check(arrivals.size() == 4 && min_gap_ms >= 450.0,
+              "4 queries at 120/min, smallest gap " + std::to_string(static_cast<int>(min_gap_ms)) + " ms");
+    }
+
+    // 4. Concurrent cone queries share the transport's connections
+    std::cout << "\n" << BOLD << "Connection reuse" << RESET << "\n";
+    {
+        const int connections_before = server.connections();
+        const int requests_before = server.requests();
+
+        std::vector<std::future<std::vector<GaiaStar>>> pending;
+        for (int i = 0; i < 32; ++i) {
+            pending.push_back(client.queryConeAsync(10.0, 20.0, 0.1 + i * 0.01, 15.0));
+        }
+        size_t total = 0;
+        for (auto& future : pending) {
+            total += future.get().size();
+        }
+
+        const int opened = server.connections() - connections_before;
+        const int served = server.requests() - requests_before;
+        check(total == 320 && served == 32 && opened <= 4,
+              "32 concurrent cones: " + std::to_string(served) + " requests over " +
+              std::to_string(opened) + " new connection(s)");
+    }
+
+    std::cout << "\n";
+    if (failures > 0) {
+        printError(std::to_string(failures) + " check(s) failed");
+        return 1;
+    }
+    printSuccess("All HTTP transport checks passed");
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <chrono>
 #include <vector>
+#include <cmath>
 
 using namespace ioc::gaia;
 
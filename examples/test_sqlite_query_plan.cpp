@@ -0,0 +1,174 @@
+#include <ioc_gaialib/gaia_sqlite_catalog.h>
+#include <sqlite3.h>
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace ioc::gaia;
+
+// ANSI color codes for better output
+#define RESET   "\033[0m"
+#define RED     "\033[31m"
+#define GREEN   "\033[32m"
+#define BLUE    "\033[34m"
+#define CYAN    "\033[36m"
+#define BOLD    "\033[1m"
+
+void printHeader(const std::string& title) {
+    std::cout << "\n" << BOLD << CYAN << "═══════════════════════════════════════════════════════" << RESET << "\n";
+    std::cout << BOLD << CYAN << "  " << title << RESET << "\n";
+    std::cout << BOLD << CYAN << "═══════════════════════════════════════════════════════" << RESET << "\n\n";
+}
+
+void printSuccess(const std::string& msg) {
+    std::cout << GREEN << "✓ " << msg << RESET << "\n";
+}
+
+void printError(const std::string& msg) {
+    std::cout << RED << "✗ " << msg << RESET << "\n";
+}
+
+void printInfo(const std::string& msg) {
+    std::cout << BLUE << "ℹ " << msg << RESET << "\n";
+}
+
+bool exec(sqlite3* db, const char* sql) {
+    char* error = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+        printError(std::string("SQLite error: ") + (error ? error : "unknown"));
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+// Same layout as tools/export_sqlite_catalog: one star every 2 degrees in RA and Dec
+bool buildDatabase(const std::string& path) {
+    sqlite3* db = nullptr;
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        printError("Cannot create " + path);
+        sqlite3_close(db);
+        return false;
+    }
+
+    bool ok = exec(db, "CREATE TABLE stars ("
+                       "sid INTEGER PRIMARY KEY, ra REAL NOT NULL, dec REAL NOT NULL, "
+                       "pmra REAL, pmdec REAL, parallax REAL, mag REAL, ruwe REAL, name TEXT, "
+                       "bp_rp REAL, bp_mag REAL, rp_mag REAL, hd INTEGER, hip INTEGER, sao INTEGER"
+                       ") WITHOUT ROWID") &&
+              exec(db, "CREATE VIRTUAL TABLE stars_spatial USING rtree(id, min_ra, max_ra, min_dec, max_dec)") &&
+              exec(db, "BEGIN");
+
+    sqlite3_stmt* insert = nullptr;
+    if (ok && sqlite3_prepare_v2(db, "INSERT INTO stars (sid, ra, dec, pmra, pmdec, parallax, mag, ruwe) "
+                                     "VALUES (?, ?, ?, 0, 0, 1, ?, 1)", -1, &insert, nullptr) != SQLITE_OK) {
+        printError(std::string("SQLite error: ") + sqlite3_errmsg(db));
+        ok = false;
+    }
+
+    int64_t sid = 1;
+    for (int dec = -89; ok && dec <= 89; dec += 2) {
+        for (int ra = 1; ok && ra < 360; ra += 2) {
+            sqlite3_bind_int64(insert, 1, sid++);
+            sqlite3_bind_double(insert, 2, ra);
+            sqlite3_bind_double(insert, 3, dec);
+            sqlite3_bind_double(insert, 4, 8.0 + (sid % 100) * 0.1);
+            ok = sqlite3_step(insert) == SQLITE_DONE;
+            sqlite3_reset(insert);
+        }
+    }
+    sqlite3_finalize(insert);
+
+    ok = ok &&
+         exec(db, "INSERT INTO stars_spatial SELECT sid, ra, ra, dec, dec FROM stars ORDER BY sid") &&
+         exec(db, "COMMIT") &&
+         exec(db, "ANALYZE");
+    sqlite3_close(db);
+    return ok;
+}
+
+// Brute force count over the same grid
+size_t expectedInCone(double ra, double dec, double radius) {
+    const double deg = M_PI / 180.0;
+    size_t count = 0;
+    for (int star_dec = -89; star_dec <= 89; star_dec += 2) {
+        for (int star_ra = 1; star_ra < 360; star_ra += 2) {
+            double cos_dist = std::sin(dec * deg) * std::sin(star_dec * deg) +
+                              std::cos(dec * deg) * std::cos(star_dec * deg) * std::cos((star_ra - ra) * deg);
+            if (std::acos(std::clamp(cos_dist, -1.0, 1.0)) / deg <= radius) {
+                ++count;
+            }
+        }
+    }
+    return count;
+}
+
+int main(int argc, char* argv[]) {
+    printHeader("IOC_GaiaLib: SQLite Cone Query Plan Test");
+
+    std::filesystem::path db_path = std::filesystem::temp_directory_path() / "ioc_gaialib_query_plan.db";
+    if (argc > 1) {
+        db_path = argv[1];
+    }
+    std::filesystem::remove(db_path);
+
+    printInfo("Building test database: " + db_path.string());
+    if (!buildDatabase(db_path.string())) {
+        std::filesystem::remove(db_path);
+        return 1;
+    }
+
+    struct Cone {
+        const char* label;
+        double ra, dec, radius;
+    };
+    const std::vector<Cone> cones = {
+        // Centres off the grid so that no star lies exactly on a cone edge
+        {"Normal cone (RA 120, Dec +30, r 5.5)", 120.0, 30.0, 5.5},
+        {"RA-wrapping cone (RA 0, Dec -10, r 4.5)", 0.0, -10.0, 4.5},
+        {"Polar cone (RA 44, Dec +88, r 5.5)", 44.0, 88.0, 5.5},
+    };
+
+    int failures = 0;
+    {
+        GaiaSqliteCatalog catalog(db_path.string());
+
+        for (const auto& cone : cones) {
+            std::cout << "\n" << BOLD << cone.label << RESET << "\n";
+            for (const auto& line : catalog.explainConeQuery(cone.ra, cone.dec, cone.radius)) {
+                std::cout << "    " << line << "\n";
+            }
+
+            if (catalog.coneUsesSpatialIndex(cone.ra, cone.dec, cone.radius)) {
+                printSuccess("Every stars_spatial scan is an R*Tree search");
+            } else {
+                printError("Cone query does not use the R*Tree");
+                ++failures;
+            }
+
+            // The plan is only useful if the query still returns the whole cone
+            size_t expected = expectedInCone(cone.ra, cone.dec, cone.radius);
+            size_t found = catalog.queryCone(cone.ra, cone.dec, cone.radius).size();
+            if (found == expected) {
+                printSuccess("Cone query returned all " + std::to_string(found) + " stars");
+            } else {
+                printError("Cone query returned " + std::to_string(found) + " stars, expected " +
+                           std::to_string(expected));
+                ++failures;
+            }
+        }
+    }
+
+    std::filesystem::remove(db_path);
+
+    std::cout << "\n";
+    if (failures > 0) {
+        printError(std::to_string(failures) + " check(s) failed");
+        return 1;
+    }
+    printSuccess("All query plan checks passed");
+    return 0;
+}
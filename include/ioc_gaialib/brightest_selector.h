@@ -0,0 +1,117 @@
+#pragma once
+
+#ifndef IOC_GAIALIB_BRIGHTEST_SELECTOR_H
+#define IOC_GAIALIB_BRIGHTEST_SELECTOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace ioc::gaia {
+
+/**
+ * @brief Streaming selection of the K brightest candidates
+ *
+ * A bounded max-heap keyed on (G magnitude, tie key): candidates are
+ * offered one at a time and only the K brightest are kept, so a scan
+ * never holds more than K items. Missing magnitudes (NaN) rank after every
+ * measured one. The order is total, so selectors filled by different
+ * threads can be merged and give the same result as a single scan.
+ * Any ascending key works in place of G; k-nearest searches rank by
+ * angular distance.
+ *
+ * @tparam T Payload kept with each candidate (typically a raw record)
+ */
+template <typename T>
+class BrightestSelector {
+public:
+    explicit BrightestSelector(size_t k) : k_(k) { heap_.reserve(std::min<size_t>(k, 1024)); }
+
+    size_t capacity() const { return k_; }
+    size_t size() const { return heap_.size(); }
+    bool full() const { return heap_.size() >= k_; }
+
+    /**
+     * @brief True when no candidate of magnitude g can still enter
+     *
+     * Lets scans over magnitude-ordered data stop at the first such record.
+     */
+    bool excludes(double g) const {
+        if (!full()) return false;
+        if (k_ == 0) return true;
+        const double faintest = heap_.front().g;
+        return !std::isnan(faintest) && (std::isnan(g) || g > faintest);
+    }
+
+    /**
+     * @brief Key of the faintest candidate kept once full, +infinity before
+     */
+    double threshold() const {
+        if (!full()) return std::numeric_limits<double>::infinity();
+        return k_ == 0 ? -std::numeric_limits<double>::infinity() : heap_.front().g;
+    }
+
+    /**
+     * @brief Offer a candidate; kept if it ranks among the K brightest so far
+     */
+    void offer(double g, uint64_t key, const T& item) {
+        if (k_ == 0) return;
+        Entry entry{g, key, item};
+        if (heap_.size() < k_) {
+            heap_.push_back(std::move(entry));
+            std::push_heap(heap_.begin(), heap_.end(), brighter);
+        } else if (brighter(entry, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), brighter);
+            heap_.back() = std::move(entry);
+            std::push_heap(heap_.begin(), heap_.end(), brighter);
+        }
+    }
+
+    /**
+     * @brief Offer every candidate kept by another selector
+     */
+    void merge(const BrightestSelector& other) {
+        for (const auto& entry : other.heap_) {
+            offer(entry.g, entry.key, entry.item);
+        }
+    }
+
+    /**
+     * @brief Kept items, brightest first; the selector is left empty
+     */
+    std::vector<T> take() {
+        std::sort_heap(heap_.begin(), heap_.end(), brighter);
+        std::vector<T> items;
+        items.reserve(heap_.size());
+        for (auto& entry : heap_) {
+            items.push_back(std::move(entry.item));
+        }
+        heap_.clear();
+        return items;
+    }
+
+private:
+    struct Entry {
+        double g;
+        uint64_t key;
+        T item;
+    };
+
+    static bool brighter(const Entry& a, const Entry& b) {
+        const bool a_missing = std::isnan(a.g);
+        const bool b_missing = std::isnan(b.g);
+        if (a_missing != b_missing) return b_missing;
+        if (!a_missing && a.g != b.g) return a.g < b.g;
+        return a.key < b.key;
+    }
+
+    size_t k_;
+    std::vector<Entry> heap_;  // Max-heap under brighter(): front is the faintest kept
+};
+
+} // namespace ioc::gaia
+
+#endif // IOC_GAIALIB_BRIGHTEST_SELECTOR_H
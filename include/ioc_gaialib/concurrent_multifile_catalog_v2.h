@@ -10,12 +10,24 @@
 #include <unordered_map>
 #include <chrono>
 #include <optional>
-#include <set>
+#include <future>
+#include <functional>
 #include "gaia_mag18_catalog_v2.h"
+#include "mapped_file.h"
 
 namespace ioc {
 namespace gaia {
 
+/**
+ * @brief Open options for ConcurrentMultiFileCatalogV2
+ */
+struct MultiFileCatalogOptions {
+    size_t max_cached_chunks = 50;   // Cache capacity in nominal chunks (used when max_cache_bytes == 0)
+    size_t max_cache_bytes = 0;      // Cache capacity in bytes (0: max_cached_chunks * nominal chunk size)
+    size_t cache_shards = 0;         // Number of cache shards (0: automatic, up to 16)
+    bool use_mmap = false;           // Map chunk files read-only instead of copying them to the heap
+};
+
 /**
  * @brief Thread-safe multi-file catalog optimized for concurrent access
  */
@@ -29,6 +41,16 @@ public:
     explicit ConcurrentMultiFileCatalogV2(const std::string& catalog_dir, 
                                           size_t max_cached_chunks = 50);
     
+    /**
+     * @brief Load catalog with explicit options
+     * 
+     * With use_mmap, cached chunks are read-only views into the page cache:
+     * no per-chunk allocation or copy, and processes opening the same
+     * catalog share physical pages.
+     */
+    ConcurrentMultiFileCatalogV2(const std::string& catalog_dir,
+                                 const MultiFileCatalogOptions& options);
+    
     /**
      * @brief Destructor
      */
@@ -46,11 +68,74 @@ public:
     std::vector<GaiaStar> queryCone(double ra, double dec, double radius, 
                                     size_t max_results = 0);
     
+    /**
+     * @brief Cone search with column limits tested before the position test
+     */
+    std::vector<GaiaStar> queryCone(double ra, double dec, double radius,
+                                    const StarFilter& filter, size_t max_results = 0);
+    
+    /**
+     * @brief Thread-safe cone search returning columns (no GaiaStar objects)
+     */
+    StarBatch queryConeColumns(double ra, double dec, double radius,
+                               size_t max_results = 0);
+    
+    /**
+     * @brief Columnar cone search with column limits
+     */
+    StarBatch queryConeColumns(double ra, double dec, double radius,
+                               const StarFilter& filter, size_t max_results = 0);
+    
+    /**
+     * @brief Cone search for many cones at once
+     * 
+     * Plans the batch before reading anything: the chunks (or pixel slices)
+     * of every cone are inverted into one work list per chunk, each chunk is
+     * loaded once and scanned against all cones that touch it, and chunks
+     * are processed in parallel. Results are identical to calling queryCone
+     * per cone with QueryParams::starFilter(), in the same order.
+     * 
+     * @param cones Query cones
+     * @return One result vector per cone
+     */
+    std::vector<std::vector<GaiaStar>> queryConeBatch(const std::vector<QueryParams>& cones);
+    
+    /**
+     * @brief Stars within params.width of a polyline of great-circle arcs
+     * 
+     * The pixel cover of the whole tube is computed first, so each chunk
+     * (or pixel slice) is read once however many path vertices it is near.
+     * Chunks are scanned in parallel, and magnitude, parallax and the
+     * corridor test (corridor::CorridorFilter, in batches) are applied to
+     * raw records before any GaiaStar is built, as are the other limits of
+     * params.filter. Each star appears at most
+     * once.
+     */
+    std::vector<GaiaStar> queryCorridor(const CorridorQueryParams& params);
+    
     /**
      * @brief Thread-safe search by source_id
+     *
+     * With a source_index.dat sidecar (see build_source_index) a lookup
+     * touches at most one chunk; without it every chunk is scanned.
      */
     std::optional<GaiaStar> queryBySourceId(uint64_t source_id);
     
+    /**
+     * @brief Check whether the source_id sidecar index was loaded
+     */
+    bool hasSourceIndex() const { return source_fences_ != nullptr; }
+    
+    /**
+     * @brief Check whether pixel slices are ordered by G magnitude
+     *
+     * Set by rebuild_healpix_index --magnitude-order. Queries with a
+     * magnitude limit then read only the bright prefix of each slice.
+     */
+    bool hasMagnitudeOrder() const {
+        return hasPixelSlices() && (header_.format_flags & MAG18_FLAG_MAGNITUDE_SORTED) != 0;
+    }
+    
     /**
      * @brief Get basic catalog info (thread-safe, no locking needed)
      */
@@ -69,9 +154,23 @@ public:
         size_t memory_used_mb;
         size_t active_readers;
         double hit_rate;
+        size_t evictions;
     };
     ConcurrencyStats getStats() const;
     
+    /**
+     * @brief Per-shard cache counters
+     */
+    struct CacheShardStats {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t chunks;
+        size_t bytes;
+        size_t capacity_bytes;
+    };
+    std::vector<CacheShardStats> getShardStats() const;
+    
     /**
      * @brief Preload chunks for better concurrent performance
      */
@@ -82,16 +181,104 @@ public:
      */
     void clearCache();
 
+    /**
+     * @brief N brightest stars in cone passing filter, brightest first
+     * 
+     * Chunks or slices are scanned in parallel, each thread keeping a
+     * bounded heap of raw records; only the N selected stars are converted.
+     * On magnitude-ordered slices (hasMagnitudeOrder()) a slice is read
+     * only until its stars become fainter than the faintest star kept.
+     * Stars without a G magnitude come last.
+     */
+    std::vector<GaiaStar> queryBrightest(double ra, double dec, double radius, size_t num_stars,
+                                         const StarFilter& filter = StarFilter());
+    
+    /**
+     * @brief The k stars passing filter closest to a position, nearest first
+     * 
+     * With a NESTED index the HEALPix pixels are opened best-first
+     * (healpix::walkByDistance) and the search stops once no unopened
+     * pixel can hold a star closer than the k-th found; slices are read
+     * with random-access hints. Older indexes widen a cone until it holds
+     * k stars. Ties are broken by source_id.
+     */
+    std::vector<GaiaStar> queryNearest(double ra, double dec, size_t k,
+                                       const StarFilter& filter = StarFilter());
+    
+    /**
+     * @brief Count stars in cone, optionally up to a G magnitude
+     * 
+     * On the pixel-sorted layout, slices of pixels entirely inside the cone
+     * are counted from the index; with a magnitude limit, magnitude-ordered
+     * slices are counted by a binary search over G. A limit at or above the
+     * catalog's magnitude limit counts as none. Only slices of pixels
+     * crossing the cone edge are scanned.
+     */
+    size_t countInCone(double ra, double dec, double radius,
+                       double max_magnitude = std::numeric_limits<double>::infinity());
+    
 private:
     struct ChunkData {
         uint64_t chunk_id;
-        std::vector<Mag18RecordV2> records;
-        std::chrono::steady_clock::time_point last_access;
-        mutable std::shared_mutex access_mutex;  // Allow multiple readers
+        RecordSpan records;  // Heap copy or read-only file mapping; immutable
+        size_t bytes;
+        std::atomic<bool> referenced{true};  // CLOCK reference bit
+        
+        ChunkData(uint64_t id, RecordSpan data) 
+            : chunk_id(id), records(std::move(data)),
+              bytes(records.size() * sizeof(Mag18RecordV2)) {}
+    };
+    
+    /**
+     * @brief One independently locked slice of the chunk cache
+     *
+     * Chunks are assigned by chunk_id modulo the shard count. Eviction is
+     * CLOCK over a ring of slots: hits only set the chunk's reference bit
+     * under the shared lock, and the hand clears bits until it finds an
+     * unreferenced chunk, so eviction is O(1) amortized.
+     */
+    struct alignas(64) CacheShard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<uint64_t, size_t> slots;          // chunk_id -> ring position
+        std::vector<std::shared_ptr<ChunkData>> ring;        // CLOCK ring (nullptr = free slot)
+        std::vector<size_t> free_slots;
+        size_t hand = 0;
+        size_t bytes = 0;
+        size_t capacity_bytes = 0;
+        // Loads in flight: concurrent requesters of the same chunk wait on one read
+        std::unordered_map<uint64_t, std::shared_future<std::shared_ptr<ChunkData>>> loading;
+        
+        std::atomic<size_t> hits{0};
+        std::atomic<size_t> misses{0};
+        std::atomic<size_t> evictions{0};
+    };
+    
+    /**
+     * @brief Precomputed bounding box and exact test for one cone
+     */
+    struct ConeBounds {
+        double ra, dec, radius;
+        double dec_min, dec_max;
+        double ra_min, ra_max;
+        bool crosses_zero;
+        StarFilter filter;
+        bool filtered = false;
+        
+        bool contains(const Mag18RecordV2& record) const;
         
-        ChunkData(uint64_t id, std::vector<Mag18RecordV2> data) 
-            : chunk_id(id), records(std::move(data)), 
-              last_access(std::chrono::steady_clock::now()) {}
+        // Column limits first, then the position
+        bool matches(const Mag18RecordV2& record) const {
+            return (!filtered || acceptsRecord(filter, record)) && contains(record);
+        }
+    };
+    
+    /**
+     * @brief Cones of a batch that scan one whole chunk, bucketed once per chunk
+     */
+    struct ChunkCones {
+        std::vector<uint32_t> cones;
+        double dec_min = 90.0, dec_max = -90.0;
+        std::unordered_map<uint32_t, std::vector<uint32_t>> cones_by_pixel;  // Empty: test every cone
     };
     
     // Core data
@@ -101,30 +288,61 @@ private:
     // NEW HEALPix index format: maps pixel -> list of chunk IDs
     std::vector<PixelChunkEntry> pixel_index_;
     std::vector<uint32_t> chunk_lists_;  // Flattened array of chunk IDs
+    std::vector<ChunkPixelInfo> pixel_slices_;  // Parallel to chunk_lists_ (pixel-sorted layout only)
     
     std::vector<ChunkInfo> chunk_index_;
     
-    // Thread-safe cache with read-write locks
-    mutable std::shared_mutex cache_mutex_;  // Protects cache structure
-    mutable std::unordered_map<uint64_t, std::shared_ptr<ChunkData>> chunk_cache_;
-    size_t max_cached_chunks_;
+    // Optional source_id sidecar (memory-mapped, read-only)
+    MappedFile source_index_file_;
+    const SourceIdFence* source_fences_ = nullptr;
+    const SourceIdEntry* source_entries_ = nullptr;
+    uint64_t num_source_entries_ = 0;
+    
+    // Sharded chunk cache
+    MultiFileCatalogOptions options_;
+    std::unique_ptr<CacheShard[]> shards_;
+    size_t num_shards_ = 1;
     
     // Statistics
-    mutable std::atomic<size_t> cache_hits_{0};
-    mutable std::atomic<size_t> cache_misses_{0};
     mutable std::atomic<size_t> active_readers_{0};
     
     // Internal methods
     bool loadMetadata();
-    std::shared_ptr<ChunkData> loadChunk(uint64_t chunk_id);
-    std::shared_ptr<ChunkData> getOrLoadChunk(uint64_t chunk_id);
-    std::set<uint32_t> getChunksForCone(double ra, double dec, double radius) const;
-    std::vector<uint32_t> getPixelsInCone(double ra, double dec, double radius) const;
+    bool loadSourceIndex();
+    std::optional<GaiaStar> lookupSourceIndex(uint64_t source_id);
+    std::shared_ptr<ChunkData> loadChunk(uint64_t chunk_id, MappedFile::Advice advice);
+    std::shared_ptr<ChunkData> getOrLoadChunk(uint64_t chunk_id,
+        MappedFile::Advice advice = MappedFile::Advice::Sequential);
+    void forEachInCone(double ra, double dec, double radius, const StarFilter& filter,
+                       const std::function<bool(const Mag18RecordV2&)>& on_hit);
+    std::vector<uint32_t> getChunksForCone(double ra, double dec, double radius) const;
+    std::vector<uint32_t> getChunksToScan(double ra, double dec, double radius) const;
+    std::vector<uint32_t> getChunksForPixels(const std::vector<healpix::PixelRange>& ranges) const;
+    std::vector<healpix::PixelRange> getPixelsInCone(double ra, double dec, double radius) const;
+    std::vector<healpix::PixelRange> getLegacyPixelsInCone(double ra, double dec, double radius) const;
+    bool hasNestedIndex() const { return (header_.format_flags & MAG18_FLAG_NESTED_INDEX) != 0; }
+    bool hasPixelSlices() const { return !pixel_slices_.empty(); }
+    std::vector<ChunkPixelInfo> getSlicesForCone(double ra, double dec, double radius) const;
+    std::vector<ChunkPixelInfo> getSlicesForPixels(const std::vector<healpix::PixelRange>& ranges) const;
+    RecordSpan magnitudePrefix(const RecordSpan& slice, double max_magnitude) const;
+    std::vector<Mag18RecordV2> collectRecords(const std::vector<healpix::PixelRange>& ranges,
+                                              double max_magnitude,
+                                              const std::function<void(const Mag18RecordV2*, size_t, uint8_t*)>& accept);
     uint32_t getHEALPixPixel(double ra, double dec) const;
-    uint32_t ang2pix_nest(double theta, double phi) const;
+    uint32_t legacy_ang2pix(double theta, double phi) const;
     GaiaStar recordToStar(const Mag18RecordV2& record) const;
-    double angularDistance(double ra1, double dec1, double ra2, double dec2) const;
-    void evictLRUChunks();
+    static double angularDistance(double ra1, double dec1, double ra2, double dec2);
+    static ConeBounds makeConeBounds(double ra, double dec, double radius,
+                                     const StarFilter& filter = StarFilter());
+    static ChunkCones makeChunkCones(std::vector<uint32_t> cones, const std::vector<ConeBounds>& bounds,
+                                     const std::vector<std::vector<healpix::PixelRange>>& cone_pixels);
+    void scanChunkForCones(const RecordSpan& records, const std::vector<ConeBounds>& bounds,
+                           const ChunkCones& chunk_cones,
+                           std::vector<std::pair<uint32_t, Mag18RecordV2>>& hits) const;
+    void initCache();
+    CacheShard& shardFor(uint64_t chunk_id) const { return shards_[chunk_id % num_shards_]; }
+    void insertIntoShard(CacheShard& shard, std::shared_ptr<ChunkData> chunk);
+    void evictOne(CacheShard& shard);
     std::string getChunkPath(uint64_t chunk_id) const;
 };
 
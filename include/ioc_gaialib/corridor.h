@@ -0,0 +1,165 @@
+#pragma once
+
+#ifndef IOC_GAIALIB_CORRIDOR_H
+#define IOC_GAIALIB_CORRIDOR_H
+
+#include "types.h"
+#include "healpix.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ioc::gaia::corridor {
+
+/**
+ * @brief Corridor (polyline tube) geometry shared by the query engines
+ *
+ * A corridor is the set of points within a half-width of a path made of
+ * great-circle arcs between consecutive waypoints. All angles are in
+ * degrees.
+ */
+
+/**
+ * @brief Search disc used to cover a corridor
+ */
+struct Disc {
+    double ra;
+    double dec;
+    double radius;
+};
+
+/**
+ * @brief Distance from a point to one great-circle segment [degrees]
+ *
+ * Cross-track distance when the closest point lies inside the segment,
+ * otherwise the distance to the nearest endpoint.
+ */
+double pointToSegmentDistance(double point_ra, double point_dec,
+                              double seg_start_ra, double seg_start_dec,
+                              double seg_end_ra, double seg_end_dec);
+
+/**
+ * @brief Minimum distance from a point to a polyline [degrees]
+ */
+double pointToPolylineDistance(double ra, double dec,
+                               const std::vector<CelestialPoint>& path);
+
+/**
+ * @brief Discs whose union contains the whole corridor
+ *
+ * Centers are sampled along each great-circle segment at most @p step
+ * apart (endpoints included) and every disc has radius width + step / 2,
+ * so any point within @p width of the path lies in at least one disc.
+ *
+ * @param path Waypoints (at least 1)
+ * @param width Corridor half-width
+ * @param step Maximum spacing between disc centers (> 0)
+ */
+std::vector<Disc> coverDiscs(const std::vector<CelestialPoint>& path,
+                             double width, double step);
+
+/**
+ * @brief Evaluate a Chebyshev series on [t_start, t_end] (Clenshaw)
+ *
+ * t is mapped to [-1, 1] and clamped; a zero-length interval returns the
+ * constant term.
+ */
+double evaluateChebyshev(double t, double t_start, double t_end,
+                         const std::vector<double>& coeffs);
+
+/**
+ * @brief Polyline following an orbit within a given tolerance
+ *
+ * Each polynomial covers the part of [t_start, t_end] inside its validity
+ * interval not already covered by an earlier-starting one. Intervals are
+ * bisected until the orbit (probed at 1/4, 1/2 and 3/4) stays within
+ * tolerance / 2 of the chord, then vertices that can be dropped without
+ * moving the chord more than tolerance / 2 from them, or stretching it
+ * past max_step, are removed. Gaps between polynomials are bridged by a
+ * straight segment.
+ *
+ * @param polynomials Orbit pieces (any order)
+ * @param t_start Start time
+ * @param t_end End time
+ * @param tolerance Maximum deviation of the path from the orbit [degrees]
+ * @param max_step Maximum time between vertices (0 = no limit)
+ * @return Waypoints with RA normalized to [0, 360)
+ */
+std::vector<CelestialPoint> sampleOrbit(const std::vector<ChebyshevPolynomial>& polynomials,
+                                        double t_start, double t_end,
+                                        double tolerance, double max_step = 0.0);
+
+/**
+ * @brief Precomputed corridor membership test
+ *
+ * Each segment keeps its endpoint unit vectors A and B, the great-circle
+ * normal N = A x B / |A x B| and the two in-plane tangents that bound the
+ * arc. A point P is inside the corridor when, for some segment,
+ *   - P lies in the arc's lune and (P . N)^2 <= sin^2(width), or
+ *   - |P - A|^2 or |P - B|^2 is within the squared chord of width,
+ * so the per-star test is a handful of dot products: no trigonometry
+ * beyond the RA/Dec to unit vector conversion.
+ *
+ * Segments are grouped in a binary tree of bounding caps over the path
+ * order; a batch of stars only visits the segments whose cap meets the
+ * batch's own bounding cap.
+ */
+class CorridorFilter {
+public:
+    /**
+     * @brief Stars per block in containsBatch (bounds the scratch arrays)
+     */
+    static constexpr size_t kBlockSize = 256;
+
+    /**
+     * @param path Waypoints (segments are the shorter great-circle arcs)
+     * @param width Corridor half-width [degrees]
+     */
+    CorridorFilter(const std::vector<CelestialPoint>& path, double width);
+
+    /**
+     * @brief Test a single position [degrees]
+     */
+    bool contains(double ra, double dec) const;
+
+    /**
+     * @brief Test n positions given as separate RA and Dec arrays [degrees]
+     * @param inside Output, 1 for positions inside the corridor, else 0
+     */
+    void containsBatch(const double* ra, const double* dec, size_t n, uint8_t* inside) const;
+
+    size_t numSegments() const { return num_segments_; }
+
+private:
+    struct Cap {
+        healpix::Vec3 center;
+        double radius;       // [radians]
+        uint32_t first;      // Segment range [first, last)
+        uint32_t last;
+        int32_t left;        // Child nodes (-1 for leaves)
+        int32_t right;
+    };
+
+    // Segment constants, one array per component for the SIMD loops
+    std::vector<double> ax_, ay_, az_;
+    std::vector<double> bx_, by_, bz_;
+    std::vector<double> nx_, ny_, nz_;    // Great-circle normal (0 for degenerate segments)
+    std::vector<double> tax_, tay_, taz_; // N x A: positive towards B
+    std::vector<double> tbx_, tby_, tbz_; // B x N: positive towards A
+    size_t num_segments_ = 0;
+
+    double sin2_width_;
+    double chord2_width_;
+    double width_rad_;
+    std::vector<Cap> caps_;  // caps_[0] is the root
+
+    int32_t buildCaps(uint32_t first, uint32_t last);
+    void markSegment(size_t s, const double* x, const double* y, const double* z,
+                     size_t n, uint8_t* inside) const;
+    void candidateSegments(const healpix::Vec3& center, double radius,
+                           std::vector<uint32_t>& segments) const;
+};
+
+} // namespace ioc::gaia::corridor
+
+#endif // IOC_GAIALIB_CORRIDOR_H
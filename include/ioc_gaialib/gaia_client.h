@@ -5,6 +5,7 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include <future>
 
 namespace ioc {
 namespace gaia {
@@ -18,7 +19,9 @@ class QueryBuilder;
  * @deprecated Use UnifiedGaiaCatalog with "online_esa" configuration instead.
  * 
  * Provides high-level methods for common queries (cone, box, ADQL) with
- * automatic rate limiting, error handling, and retry logic.
+ * automatic rate limiting, error handling, and retry logic. Requests go
+ * through the shared HttpTransport: connections are kept alive and
+ * multiplexed between queries, and the *Async methods return at once.
  * 
  * Example usage:
  * @code
@@ -65,6 +68,22 @@ public:
         double max_magnitude = 20.0
     );
     
+    /**
+     * Submit a cone search without waiting for it
+     * 
+     * The request is rate limited, sent and retried by the transport's
+     * worker thread; the CSV is parsed when the future is read.
+     * 
+     * @return Future of the queryCone result; get() throws GaiaException
+     *         on network or parse errors
+     */
+    std::future<std::vector<GaiaStar>> queryConeAsync(
+        double ra_center, 
+        double dec_center, 
+        double radius, 
+        double max_magnitude = 20.0
+    );
+    
     /**
      * Query stars in a rectangular region (box search)
      * 
@@ -103,6 +122,14 @@ public:
      */
     std::vector<GaiaStar> queryADQL(const std::string& adql);
     
+    /**
+     * Submit a custom ADQL query without waiting for it
+     * 
+     * @param adql ADQL query string
+     * @return Future of the queryADQL result
+     */
+    std::future<std::vector<GaiaStar>> queryADQLAsync(const std::string& adql);
+    
     /**
      * Query stars by Gaia source IDs
      * 
@@ -129,6 +156,8 @@ public:
      * Set rate limiting (queries per minute)
      * Default: 10 queries/minute (Gaia Archive limit)
      * 
+     * Token bucket shared by every thread using this client.
+     * 
      * @param queries_per_minute Maximum queries per minute (0 = unlimited)
      */
     void setRateLimit(int queries_per_minute);
@@ -149,6 +178,13 @@ public:
      */
     void setMaxRetries(int max_retries);
     
+    /**
+     * Override the TAP endpoint (e.g. a mirror or a local test server)
+     * 
+     * @param url Synchronous TAP query URL
+     */
+    void setTapUrl(const std::string& url);
+    
     /**
      * Get the TAP service URL being used
      * @return TAP endpoint URL
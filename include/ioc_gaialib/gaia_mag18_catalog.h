@@ -126,6 +126,11 @@ public:
      */
     Statistics getStatistics() const;
     
+    /**
+     * @brief Faintest G magnitude kept in the catalog
+     */
+    double getMagLimit() const { return header_.mag_limit; }
+    
     /**
      * @brief Query star by Gaia source_id
      * @param source_id Gaia DR3 source identifier
@@ -172,6 +177,9 @@ public:
      * @param radius Search radius (degrees)
      * @param n_brightest Number of brightest stars to return
      * @return Vector of N brightest stars, sorted by magnitude
+     * 
+     * Streams the scan through a bounded heap: only the N selected stars
+     * are converted.
      */
     std::vector<ioc::gaia::GaiaStar> queryBrightest(double ra, double dec, double radius,
                                                      size_t n_brightest) const;
@@ -2,14 +2,21 @@
 #define GAIA_MAG18_CATALOG_V2_H
 
 #include "types.h"
+#include "healpix.h"
+#include "mapped_file.h"
+#include "star_batch.h"
 #include <string>
 #include <vector>
 #include <memory>
 #include <zlib.h>
 #include <cstdint>
+#include <optional>
 #include <mutex>
 #include <shared_mutex>
 #include <atomic>
+#include <algorithm>
+#include <future>
+#include <unordered_map>
 
 namespace ioc {
 namespace gaia {
@@ -70,6 +77,70 @@ struct Mag18RecordV2 {
 // Static assertion to verify correct structure size
 static_assert(sizeof(Mag18RecordV2) == 84, "Mag18RecordV2 must be exactly 84 bytes");
 
+/**
+ * @brief Append a record's numeric columns to a StarBatch
+ */
+inline void appendRecord(StarBatch& batch, const Mag18RecordV2& record) {
+    batch.push_back(static_cast<int64_t>(record.source_id), record.ra, record.dec,
+                    record.parallax, record.pmra, record.pmdec, record.g_mag,
+                    record.bp_mag, record.rp_mag, record.bp_rp, record.ruwe);
+}
+
+/**
+ * @brief Test a record's columns against a StarFilter
+ */
+inline bool acceptsRecord(const StarFilter& filter, const Mag18RecordV2& record) {
+    return filter.accepts(record.g_mag, record.parallax, record.ruwe, record.bp_rp,
+                          record.pmra, record.pmdec);
+}
+
+/**
+ * @brief Immutable, ref-counted view over a contiguous run of records
+ *
+ * Chunk caches hand out RecordSpans instead of copies of their record
+ * vectors. The span shares ownership of the backing storage, so it stays
+ * valid after the chunk has been evicted from the cache that produced it.
+ */
+class RecordSpan {
+public:
+    RecordSpan() = default;
+    RecordSpan(std::shared_ptr<const void> owner, const Mag18RecordV2* data, size_t size)
+        : owner_(std::move(owner)), data_(data), size_(size) {}
+    
+    /**
+     * @brief Take ownership of a heap vector and view all of it
+     */
+    static RecordSpan fromVector(std::vector<Mag18RecordV2> records) {
+        auto storage = std::make_shared<const std::vector<Mag18RecordV2>>(std::move(records));
+        const Mag18RecordV2* data = storage->data();
+        size_t size = storage->size();
+        return RecordSpan(std::move(storage), data, size);
+    }
+    
+    const Mag18RecordV2* begin() const { return data_; }
+    const Mag18RecordV2* end() const { return data_ + size_; }
+    const Mag18RecordV2* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    
+    const Mag18RecordV2& operator[](size_t i) const { return data_[i]; }
+    const Mag18RecordV2& front() const { return data_[0]; }
+    const Mag18RecordV2& back() const { return data_[size_ - 1]; }
+    
+    /**
+     * @brief View a sub-range; shares ownership with this span
+     */
+    RecordSpan subspan(size_t offset, size_t count) const {
+        if (offset >= size_) return RecordSpan(owner_, data_ + size_, 0);
+        return RecordSpan(owner_, data_ + offset, std::min(count, size_ - offset));
+    }
+    
+private:
+    std::shared_ptr<const void> owner_;
+    const Mag18RecordV2* data_ = nullptr;
+    size_t size_ = 0;
+};
+
 /**
  * @brief HEALPix index entry - OLD format (deprecated, kept for compatibility)
  */
@@ -99,6 +170,20 @@ struct PixelChunkEntry {
 
 static_assert(sizeof(PixelChunkEntry) == 16, "PixelChunkEntry must be exactly 16 bytes");
 
+/**
+ * @brief Slice of one chunk holding the stars of one pixel (12 bytes)
+ * Stored parallel to the chunk list array when records are pixel-sorted
+ */
+#pragma pack(push, 4)
+struct ChunkPixelInfo {
+    uint32_t chunk_id;           // Chunk containing the slice
+    uint32_t first_star_offset;  // Offset of first star of this pixel in chunk
+    uint32_t num_stars;          // Number of stars of this pixel in chunk
+};
+#pragma pack(pop)
+
+static_assert(sizeof(ChunkPixelInfo) == 12, "ChunkPixelInfo must be exactly 12 bytes");
+
 /**
  * @brief Chunk compression info - one per chunk (40 bytes)
  */
@@ -151,6 +236,57 @@ struct Mag18CatalogHeaderV2 {
 // Static assertion for header size
 static_assert(sizeof(Mag18CatalogHeaderV2) == 268, "Mag18CatalogHeaderV2 must be exactly 268 bytes");
 
+/**
+ * @brief Mag18CatalogHeaderV2::format_flags bits
+ * The low byte is left to the catalog writer's compression options.
+ */
+enum Mag18FormatFlags : uint32_t {
+    MAG18_FLAG_NESTED_INDEX = 1u << 8,  ///< Pixel index keyed by reference NESTED pixels
+    MAG18_FLAG_PIXEL_SORTED = 1u << 9,  ///< Chunks ordered by pixel; ChunkPixelInfo array follows the chunk lists
+    MAG18_FLAG_MAGNITUDE_SORTED = 1u << 10  ///< With PIXEL_SORTED: each slice ordered by G (NaN first), then source_id
+};
+
+/**
+ * @brief source_id sidecar index (source_index.dat, next to metadata.dat)
+ *
+ * Layout: SourceIndexHeader, then one SourceIdFence per chunk, then (unless
+ * SOURCE_INDEX_FENCES_ONLY is set) num_entries SourceIdEntry records sorted
+ * by source_id. The fence-only form is written when every chunk is sorted
+ * by source_id and the chunk ranges are disjoint and increasing.
+ */
+#pragma pack(push, 4)
+struct SourceIndexHeader {
+    char magic[8];                  // "GAIASIDX"
+    uint32_t version;               // Version number (1)
+    uint32_t flags;                 // SourceIndexFlags
+    uint64_t total_stars;           // Must match Mag18CatalogHeaderV2::total_stars
+    uint64_t total_chunks;          // Must match Mag18CatalogHeaderV2::total_chunks
+    uint64_t fence_offset;          // Offset to SourceIdFence array
+    uint64_t entry_offset;          // Offset to SourceIdEntry array
+    uint64_t num_entries;           // Number of SourceIdEntry records
+    uint64_t reserved;              // Reserved for future use
+};
+
+struct SourceIdFence {
+    uint64_t min_source_id;         // Smallest source_id in the chunk
+    uint64_t max_source_id;         // Largest source_id in the chunk
+};
+
+struct SourceIdEntry {
+    uint64_t source_id;
+    uint32_t chunk_id;
+    uint32_t record_offset;         // Record index inside the chunk
+};
+#pragma pack(pop)
+
+static_assert(sizeof(SourceIndexHeader) == 64, "SourceIndexHeader must be exactly 64 bytes");
+static_assert(sizeof(SourceIdFence) == 16, "SourceIdFence must be exactly 16 bytes");
+static_assert(sizeof(SourceIdEntry) == 16, "SourceIdEntry must be exactly 16 bytes");
+
+enum SourceIndexFlags : uint32_t {
+    SOURCE_INDEX_FENCES_ONLY = 1u << 0  ///< Chunks sorted and disjoint; no entry array
+};
+
 /**
  * @brief Gaia Mag18 Catalog V2 Reader with spatial indexing
  * @deprecated Use UnifiedGaiaCatalog with "compressed_v2" configuration instead.
@@ -195,6 +331,28 @@ public:
     std::vector<GaiaStar> queryCone(double ra, double dec, double radius, 
                                      size_t max_results = 0);
     
+    /**
+     * @brief Cone search with column limits tested before the distance
+     * @param filter Limits applied to each record in the scan loop
+     */
+    std::vector<GaiaStar> queryCone(double ra, double dec, double radius,
+                                     const StarFilter& filter, size_t max_results = 0);
+    
+    /**
+     * @brief Cone search returning columns instead of GaiaStar objects
+     * @param ra Right ascension [degrees]
+     * @param dec Declination [degrees]
+     * @param radius Search radius [degrees]
+     * @param max_results Maximum results (0 = unlimited)
+     */
+    StarBatch queryConeColumns(double ra, double dec, double radius, size_t max_results = 0);
+    
+    /**
+     * @brief Columnar cone search with column limits
+     */
+    StarBatch queryConeColumns(double ra, double dec, double radius,
+                               const StarFilter& filter, size_t max_results = 0);
+    
     /**
      * @brief Cone search with magnitude filter (optimized)
      */
@@ -203,13 +361,38 @@ public:
                                                    size_t max_results = 0);
     
     /**
-     * @brief Get N brightest stars in cone (optimized)
+     * @brief Get N brightest stars in cone, brightest first
+     * 
+     * Each thread keeps a bounded heap of raw records while scanning, so
+     * only the N selected stars are ever converted to GaiaStar. Stars
+     * without a G magnitude come last.
      */
     std::vector<GaiaStar> queryBrightest(double ra, double dec, double radius,
                                           size_t num_stars);
     
     /**
-     * @brief Count stars in cone (fast, no star loading)
+     * @brief N brightest stars in cone among those passing filter
+     */
+    std::vector<GaiaStar> queryBrightest(double ra, double dec, double radius,
+                                          size_t num_stars, const StarFilter& filter);
+    
+    /**
+     * @brief The k stars closest to a position, nearest first
+     * 
+     * Best-first search over the HEALPix index (healpix::walkByDistance):
+     * pixels are opened in order of their minimum distance and the search
+     * stops once no unopened pixel can hold a star closer than the k-th
+     * found. Ties are broken by source_id.
+     */
+    std::vector<GaiaStar> queryNearest(double ra, double dec, size_t k,
+                                       const StarFilter& filter = StarFilter());
+    
+    /**
+     * @brief Count stars in cone
+     * 
+     * Pixels lying entirely inside the cone contribute their index counts
+     * without touching any chunk; only pixels crossing the cone edge are
+     * decompressed and tested star by star.
      */
     size_t countInCone(double ra, double dec, double radius);
     
@@ -223,6 +406,12 @@ public:
      */
     std::vector<uint32_t> getPixelsInCone(double ra, double dec, double radius) const;
     
+    /**
+     * @brief Get pixels intersecting the cone as sorted NESTED ranges
+     */
+    std::vector<healpix::PixelRange> getPixelRangesInCone(double ra, double dec,
+                                                          double radius) const;
+    
     /**
      * Get extended star information (V2 format)
      */
@@ -247,8 +436,7 @@ public:
     
 private:
     std::string catalog_path_;
-    FILE* file_;
-    mutable std::mutex file_mutex_;  // Protects file operations
+    MappedFile file_;  // Read-only mapping of the catalog; chunk reads take no lock
     Mag18CatalogHeaderV2 header_;
     
     // HEALPix spatial index (loaded in memory for fast queries) - READ ONLY after load
@@ -262,13 +450,15 @@ private:
     size_t num_threads_;
     
     // Chunk cache (LRU, keep last N decompressed chunks) - THREAD SAFE
+    // Entries hold immutable RecordSpans; hits hand out a ref-counted view
+    // instead of copying the decompressed chunk.
     struct ChunkCache {
         uint64_t chunk_id;
-        std::vector<Mag18RecordV2> records;
+        RecordSpan records;
         std::atomic<size_t> access_count;
         
         ChunkCache() : chunk_id(0), access_count(0) {}
-        ChunkCache(uint64_t id, std::vector<Mag18RecordV2> recs, size_t count)
+        ChunkCache(uint64_t id, RecordSpan recs, size_t count)
             : chunk_id(id), records(std::move(recs)), access_count(count) {}
         
         // Move constructor (atomic requires explicit move)
@@ -294,6 +484,19 @@ private:
     static constexpr size_t MAX_CACHED_CHUNKS = 10;
     mutable std::vector<ChunkCache> chunk_cache_;
     mutable std::shared_mutex cache_mutex_;  // Reader-writer lock for cache
+    // Inflates in flight: concurrent readers of the same cold chunk share one
+    std::unordered_map<uint64_t, std::shared_future<RecordSpan>> loading_chunks_;
+    
+    /**
+     * @brief Chunks touched by one batch of a query, held while it is scanned
+     *
+     * Pinning decouples the scan from the small shared cache: every chunk
+     * is inflated at most once per batch even if the cache evicts it.
+     */
+    struct PinnedChunks {
+        std::vector<uint64_t> ids;      // Sorted chunk ids
+        std::vector<RecordSpan> spans;  // Parallel to ids
+    };
     
     // Internal methods
     bool loadHeader();
@@ -301,7 +504,49 @@ private:
     bool loadChunkIndex();
     
     std::optional<Mag18RecordV2> readRecord(uint64_t index);
-    std::vector<Mag18RecordV2> readChunk(uint64_t chunk_id);
+    RecordSpan readChunk(uint64_t chunk_id);
+    RecordSpan inflateChunk(uint64_t chunk_id) const;
+    
+    /**
+     * @brief Resolve every chunk the entries touch; cold chunks are
+     *        inflated in parallel (OpenMP) when parallel processing is on
+     */
+    PinnedChunks pinChunks(const std::vector<HEALPixIndexEntry>& entries);
+    
+    /**
+     * @brief Scan entries in batches pinning at most MAX_CACHED_CHUNKS chunks
+     *
+     * Entries are grouped in record order; each batch's chunks are pinned,
+     * handed to fn together with the indices (into entries) of its pixels,
+     * and released before the next batch. A single pixel spanning more
+     * chunks than the limit forms a batch of its own.
+     *
+     * @param fn Callback (const std::vector<size_t>& batch, const PinnedChunks&);
+     *           return false to skip the remaining batches
+     */
+    template <typename Fn>
+    void forEachPinnedBatch(const std::vector<HEALPixIndexEntry>& entries, Fn&& fn);
+    
+    /**
+     * @brief Visit records [first, first + count) using pinned chunks only
+     * @return false if the callback stopped the scan
+     */
+    template <typename Fn>
+    bool forEachPinnedRecord(const PinnedChunks& pinned, uint64_t first, uint64_t count,
+                             Fn&& fn) const;
+    
+    /**
+     * @brief Visit records [first, first + count) chunk by chunk
+     * @param fn Callback taking a record; return false to stop early
+     * @return false if the callback stopped the scan
+     */
+    template <typename Fn>
+    bool forEachRecord(uint64_t first, uint64_t count, Fn&& fn);
+    
+    /**
+     * @brief Locate a record by source_id (chunk-level binary search)
+     */
+    std::optional<Mag18RecordV2> findRecord(uint64_t source_id);
     
     GaiaStar recordToStar(const Mag18RecordV2& record) const;
     
@@ -311,7 +556,11 @@ private:
     uint32_t ang2pix_nest(double theta, double phi) const;
     void pix2ang_nest(uint32_t pixel, double& theta, double& phi) const;
     void query_disc(double theta, double phi, double radius,
-                    std::vector<uint32_t>& pixels) const;
+                    std::vector<healpix::PixelRange>& ranges) const;
+    std::vector<HEALPixIndexEntry> getIndexEntriesInCone(double ra, double dec,
+                                                         double radius) const;
+    std::vector<HEALPixIndexEntry> getIndexEntries(
+        const std::vector<healpix::PixelRange>& ranges) const;
 };
 
 } // namespace gaia
@@ -5,13 +5,23 @@
 #include <vector>
 #include <optional>
 #include <memory>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
 
 struct sqlite3;
+struct sqlite3_stmt;
 
 namespace ioc::gaia {
 
 /**
  * @brief Catalog implementation using an SQLite database with R*Tree indexing
+ *
+ * Thread-safe: each query leases a read-only connection from an internal
+ * pool (a new one is opened when all are busy) and runs statements that
+ * connection has already compiled, so repeated queries only reset and
+ * re-bind them.
  */
 class GaiaSqliteCatalog {
 public:
@@ -35,6 +45,26 @@ public:
      */
     std::vector<GaiaStar> queryCone(double ra, double dec, double radius, double max_mag = 21.0);
 
+    /**
+     * @brief Query stars in a cone with column limits in the WHERE clause
+     *
+     * Magnitude, parallax, RUWE and proper-motion limits (and color, when
+     * the stars table has a bp_rp column) are evaluated by SQLite, so rows
+     * outside them are never converted. NULL is a missing value and, as in
+     * StarFilter, passes every limit. Color limits are ignored without a
+     * bp_rp column.
+     */
+    std::vector<GaiaStar> queryCone(double ra, double dec, double radius, const StarFilter& filter);
+
+    /**
+     * @brief N brightest stars in a cone passing filter, brightest first
+     *
+     * Candidates are read in magnitude order and the scan stops at the
+     * N-th star inside the cone. Stars without a magnitude come last.
+     */
+    std::vector<GaiaStar> queryBrightest(double ra, double dec, double radius, size_t num_stars,
+                                         const StarFilter& filter = StarFilter());
+
     /**
      * @brief Query a star by its Gaia Source ID
      */
@@ -47,22 +77,122 @@ public:
      */
     std::optional<GaiaStar> queryByDesignation(const std::string& catalog, const std::string& designation);
 
+    /**
+     * @brief Look up many stars by Gaia Source ID
+     *
+     * Ids are resolved in sorted batches of bound IN lists on one
+     * connection instead of one statement per id.
+     *
+     * @return One entry per input id, in input order (empty if not found)
+     */
+    std::vector<std::optional<GaiaStar>> queryBySourceIds(const std::vector<uint64_t>& source_ids);
+
+    /**
+     * @brief Look up many stars by SAO, HD, HIP number or common name
+     *
+     * Numbers may carry the catalog prefix ("HD 1234"). On an indexed
+     * column the lookup runs in batches of bound IN lists; without an index
+     * the stars table is scanned once for the whole list.
+     *
+     * @param catalog Catalog type ("SAO", "HD", "HIP", "NAME")
+     * @return One entry per designation, in input order (empty if not found)
+     */
+    std::vector<std::optional<GaiaStar>> queryByDesignations(const std::string& catalog,
+                                                             const std::vector<std::string>& designations);
+
     /**
      * @brief Get total number of stars in the database
+     *
+     * Counted on the first call and cached: the database is read-only.
      */
     size_t getTotalStars() const;
 
     /**
      * @brief Check if the database is opened successfully
      */
-    bool isOpen() const { return db_ != nullptr; }
+    bool isOpen() const { return open_; }
+
+    // -------------------------------------------------------------------------
+    // Diagnostics only: for checking database builds, not for query code.
+    // The plan text comes from SQLite and may change between its versions.
+    // -------------------------------------------------------------------------
+
+    /**
+     * @brief EXPLAIN QUERY PLAN of the cone query, one detail line per step
+     *
+     * Shows whether the stars_spatial R*Tree drives the search. Empty if
+     * the query cannot be prepared.
+     */
+    std::vector<std::string> explainConeQuery(double ra, double dec, double radius,
+                                              const StarFilter& filter = StarFilter(),
+                                              bool brightest_first = false) const;
+
+    /**
+     * @brief True when every scan of the cone query is an R*Tree index search
+     */
+    bool coneUsesSpatialIndex(double ra, double dec, double radius) const;
 
 private:
-    sqlite3* db_ = nullptr;
+    /**
+     * @brief One read-only connection and the statements compiled on it
+     */
+    struct Connection {
+        sqlite3* db = nullptr;
+        std::unordered_map<std::string, sqlite3_stmt*> statements;
+
+        ~Connection();
+
+        /**
+         * @brief Cached statement for sql, reset and with bindings cleared
+         */
+        sqlite3_stmt* prepare(const std::string& sql);
+    };
+
+    /**
+     * @brief Connection borrowed from the pool; returned when destroyed
+     */
+    class Lease {
+    public:
+        Lease(const GaiaSqliteCatalog* owner, std::unique_ptr<Connection> connection)
+            : owner_(owner), connection_(std::move(connection)) {}
+        ~Lease();
+        Lease(Lease&&) = default;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        explicit operator bool() const { return connection_ != nullptr; }
+        Connection* operator->() const { return connection_.get(); }
+
+    private:
+        const GaiaSqliteCatalog* owner_;
+        std::unique_ptr<Connection> connection_;
+    };
+
     std::string db_path_;
+    bool open_ = false;
+    std::vector<std::string> star_columns_;  // Column names of the stars table, in order
+    std::vector<std::string> indexed_columns_;  // Leading columns of the stars indexes
+
+    mutable std::mutex pool_mutex_;
+    mutable std::vector<std::unique_ptr<Connection>> idle_connections_;
+    mutable std::atomic<int64_t> total_stars_{-1};  // -1 until counted
 
-    void openDatabase();
-    void closeDatabase();
+    std::unique_ptr<Connection> openConnection() const;
+    Lease lease() const;
+    void release(std::unique_ptr<Connection> connection) const;
+    void loadSchema(Connection& connection);
+    std::string starColumn(size_t index) const;
+    bool hasStarColumn(const std::string& name) const;
+    std::string selectColumns() const;
+    std::vector<std::optional<GaiaStar>> lookupBatch(const std::string& column, size_t key_index,
+                                                     const std::vector<int64_t>& keys);
+    StarFilter buildConeQuery(double ra, double dec, double radius, const StarFilter& filter,
+                              bool brightest_first, std::string& sql,
+                              std::vector<double>& values) const;
+    void forEachInCone(double ra, double dec, double radius, const StarFilter& filter,
+                       bool brightest_first, const std::function<bool(const GaiaStar&)>& on_hit);
+    StarFilter appendFilterClauses(const StarFilter& filter, std::string& sql,
+                                   std::vector<double>& values) const;
 };
 
 } // namespace ioc::gaia
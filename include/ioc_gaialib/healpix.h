@@ -0,0 +1,158 @@
+#pragma once
+
+#ifndef IOC_GAIALIB_HEALPIX_H
+#define IOC_GAIALIB_HEALPIX_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace ioc::gaia::healpix {
+
+/**
+ * @brief HEALPix NESTED-scheme geometry shared by the local catalogs
+ *
+ * Follows the reference Healpix C++ implementation (Gorski et al. 2005).
+ * NSIDE must be a power of two no larger than 8192 so that pixel numbers
+ * fit in 32 bits.
+ */
+
+/**
+ * @brief Unit vector on the celestial sphere
+ */
+struct Vec3 {
+    double x;
+    double y;
+    double z;
+
+    double dot(const Vec3& o) const { return x * o.x + y * o.y + z * o.z; }
+};
+
+/**
+ * @brief Half-open range [begin, end) of NESTED pixel numbers
+ */
+struct PixelRange {
+    uint32_t begin;
+    uint32_t end;
+
+    uint32_t size() const { return end - begin; }
+    bool contains(uint32_t pixel) const { return pixel >= begin && pixel < end; }
+};
+
+/**
+ * @brief Check that NSIDE is a supported power of two
+ */
+bool isValidNside(uint32_t nside);
+
+/**
+ * @brief log2(NSIDE)
+ */
+int nsideToOrder(uint32_t nside);
+
+/**
+ * @brief Total number of pixels, 12 * NSIDE^2
+ */
+inline uint32_t npix(uint32_t nside) { return 12u * nside * nside; }
+
+/**
+ * @brief Unit vector for RA/Dec in degrees
+ */
+Vec3 radecToVec(double ra, double dec);
+
+/**
+ * @brief Angle between two unit vectors [radians]
+ */
+double angleBetween(const Vec3& a, const Vec3& b);
+
+/**
+ * @brief Pixel containing a direction
+ * @param theta Colatitude [radians, 0..pi]
+ * @param phi Longitude [radians, any value; wrapped into 0..2pi]
+ */
+uint32_t ang2pixNest(uint32_t nside, double theta, double phi);
+
+/**
+ * @brief Pixel containing RA/Dec in degrees
+ */
+uint32_t radec2pixNest(uint32_t nside, double ra, double dec);
+
+/**
+ * @brief Pixel center as colatitude/longitude [radians]
+ */
+void pix2angNest(uint32_t nside, uint32_t pixel, double& theta, double& phi);
+
+/**
+ * @brief Pixel center as a unit vector
+ */
+Vec3 pix2vecNest(uint32_t nside, uint32_t pixel);
+
+/**
+ * @brief Upper bound on the angular distance from any pixel center to any
+ *        point of that pixel [radians]
+ */
+double maxPixelRadius(uint32_t nside);
+
+/**
+ * @brief All NESTED pixels that intersect a disc, as sorted disjoint ranges
+ *
+ * Descends from the 12 base faces and prunes whole subtrees with their
+ * bounding circles; subtrees entirely inside the disc are emitted as one
+ * range without being expanded. The result is a superset of the exact
+ * coverage (pixels touching the disc boundary are always included).
+ *
+ * @param nside Target resolution
+ * @param center Disc center (unit vector)
+ * @param radius Disc radius [radians]
+ */
+std::vector<PixelRange> queryDisc(uint32_t nside, const Vec3& center, double radius);
+
+/**
+ * @brief Convenience overload taking RA/Dec/radius in degrees
+ */
+std::vector<PixelRange> queryDisc(uint32_t nside, double ra, double dec, double radius);
+
+/**
+ * @brief Disc coverage split by containment
+ *
+ * Same traversal as queryDisc, but pixels lying entirely inside the disc
+ * go to inner and pixels crossing its boundary to boundary. Both are
+ * sorted and disjoint and their union is the queryDisc result, so counts
+ * over inner pixels need no per-point test.
+ *
+ * @param radius Disc radius [radians]
+ */
+void queryDisc(uint32_t nside, const Vec3& center, double radius,
+               std::vector<PixelRange>& inner, std::vector<PixelRange>& boundary);
+
+/**
+ * @brief Visit pixels in order of increasing distance from a point
+ *
+ * Best-first search of the NESTED hierarchy: cells are kept in a priority
+ * queue keyed on a lower bound of the distance from center to any point
+ * inside them (centre distance minus the bounding radius), and pixels at
+ * the target resolution reach visit in that order. visit returns the
+ * distance beyond which nothing more is needed; the walk ends when the
+ * next lower bound exceeds it, so a k-nearest search only opens the
+ * pixels that can still hold a closer point.
+ *
+ * @param visit Called with (pixel, lower bound [radians]); returns the
+ *              remaining search radius [radians]
+ */
+void walkByDistance(uint32_t nside, const Vec3& center,
+                    const std::function<double(uint32_t, double)>& visit);
+
+/**
+ * @brief Expand ranges into individual pixel numbers
+ */
+std::vector<uint32_t> expandRanges(const std::vector<PixelRange>& ranges);
+
+/**
+ * @brief Sort ranges and coalesce overlapping or adjacent ones
+ *
+ * Used to union the coverage of several discs.
+ */
+void mergeRanges(std::vector<PixelRange>& ranges);
+
+} // namespace ioc::gaia::healpix
+
+#endif // IOC_GAIALIB_HEALPIX_H
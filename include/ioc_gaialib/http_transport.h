@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <chrono>
+
+namespace ioc {
+namespace gaia {
+
+/**
+ * Token bucket rate limiter, safe to share between threads
+ *
+ * Tokens refill continuously at queries_per_minute / 60 per second, up to
+ * burst tokens; each request takes one. Every thread (and every transfer)
+ * holding the same limiter draws from the same bucket.
+ */
+class RateLimiter {
+public:
+    /**
+     * @param queries_per_minute Sustained rate (0 = unlimited)
+     * @param burst Requests allowed back to back after an idle period
+     */
+    explicit RateLimiter(int queries_per_minute, int burst = 1);
+
+    /**
+     * Change the sustained rate; the tokens already in the bucket are kept
+     */
+    void setRate(int queries_per_minute);
+
+    /**
+     * Take a token if one is available
+     * @return Zero when a token was taken, otherwise the wait until one is
+     */
+    std::chrono::steady_clock::duration tryAcquire();
+
+    /**
+     * Block until a token is taken
+     */
+    void acquire();
+
+private:
+    std::mutex mutex_;
+    double tokens_per_second_;
+    double capacity_;
+    double tokens_;
+    std::chrono::steady_clock::time_point last_refill_;
+};
+
+/**
+ * One HTTP POST handed to HttpTransport
+ */
+struct HttpRequest {
+    std::string url;
+    std::string body;
+    std::vector<std::string> headers;            ///< Raw "Name: value" lines
+    long timeout_seconds = 60;
+    int max_retries = 3;                         ///< Retries after network errors, 429 and 5xx
+    std::chrono::milliseconds retry_delay{2000}; ///< Backoff step: attempt n waits n x retry_delay
+    std::shared_ptr<RateLimiter> rate_limiter;   ///< Optional; consulted before every attempt
+};
+
+/**
+ * Final answer to an HttpRequest
+ */
+struct HttpResponse {
+    long status = 0;
+    std::string body;
+};
+
+/**
+ * Asynchronous HTTP transport over one persistent curl multi handle
+ *
+ * A single worker thread drives every transfer: connections stay open
+ * between requests (keep-alive, TLS sessions reused), requests to the same
+ * host are multiplexed over HTTP/2 when the server offers it, and
+ * responses are accepted compressed. submit() never blocks; retries and
+ * rate-limit waits are timers in the worker loop, not sleeping callers.
+ *
+ * The future holds the response for any final HTTP status (including 4xx,
+ * or 429/5xx once retries are exhausted) and a GaiaException with
+ * NETWORK_ERROR when the transfer itself keeps failing.
+ */
+class HttpTransport {
+public:
+    /**
+     * @param max_host_connections Parallel connections per host
+     */
+    explicit HttpTransport(long max_host_connections = 4);
+    ~HttpTransport();
+
+    HttpTransport(const HttpTransport&) = delete;
+    HttpTransport& operator=(const HttpTransport&) = delete;
+
+    /**
+     * Process-wide transport shared by all clients
+     */
+    static HttpTransport& instance();
+
+    /**
+     * Queue a POST request
+     * @return Future completed by the worker thread
+     */
+    std::future<HttpResponse> submit(HttpRequest request);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl_;
+};
+
+} // namespace gaia
+} // namespace ioc
@@ -0,0 +1,70 @@
+#pragma once
+
+#ifndef IOC_GAIALIB_MAPPED_FILE_H
+#define IOC_GAIALIB_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ioc {
+namespace gaia {
+
+/**
+ * @brief Read-only memory mapping of a whole file (RAII)
+ *
+ * The mapping is released on destruction or close(). Pointers returned by
+ * data() stay valid for the lifetime of the mapping.
+ */
+class MappedFile {
+public:
+    /**
+     * @brief Expected access pattern, forwarded to posix_madvise
+     */
+    enum class Advice {
+        Normal,
+        Sequential,   // Read ahead aggressively, drop pages behind
+        Random,       // Disable read-ahead
+        WillNeed      // Start paging in now
+    };
+    
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /**
+     * @brief Map a file read-only
+     * @param path File to map
+     * @return true if the file was opened and mapped (an empty file maps
+     *         successfully with size() == 0)
+     */
+    bool open(const std::string& path);
+
+    /**
+     * @brief Unmap and close
+     */
+    void close();
+
+    /**
+     * @brief Hint the kernel about upcoming accesses to the whole mapping
+     */
+    void advise(Advice advice) const;
+
+    bool isOpen() const { return fd_ >= 0; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    int fd_ = -1;
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+} // namespace gaia
+} // namespace ioc
+
+#endif // IOC_GAIALIB_MAPPED_FILE_H
@@ -0,0 +1,86 @@
+#pragma once
+
+#ifndef IOC_GAIALIB_STAR_BATCH_H
+#define IOC_GAIALIB_STAR_BATCH_H
+
+#include "types.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ioc::gaia {
+
+/**
+ * @brief Columnar query result (structure of arrays)
+ *
+ * Holds the numeric columns most callers need, one contiguous array per
+ * column, without the cross-match strings of GaiaStar. Appending a star
+ * costs a few scalar stores instead of building five std::string members.
+ * Row i is (source_id[i], ra[i], dec[i], ...); all columns always have
+ * the same length.
+ */
+struct StarBatch {
+    std::vector<int64_t> source_id;
+    std::vector<double> ra;                ///< [degrees]
+    std::vector<double> dec;               ///< [degrees]
+    std::vector<double> parallax;          ///< [mas]
+    std::vector<double> pmra;              ///< [mas/yr]
+    std::vector<double> pmdec;             ///< [mas/yr]
+    std::vector<double> phot_g_mean_mag;   ///< [mag]
+    std::vector<double> phot_bp_mean_mag;  ///< [mag]
+    std::vector<double> phot_rp_mean_mag;  ///< [mag]
+    std::vector<double> bp_rp;             ///< [mag]
+    std::vector<double> ruwe;
+
+    size_t size() const { return source_id.size(); }
+    bool empty() const { return source_id.empty(); }
+
+    void reserve(size_t n);
+    void clear();
+    
+    /**
+     * @brief Keep only the first n rows
+     */
+    void truncate(size_t n);
+
+    /**
+     * @brief Keep the rows whose keep[i] is non-zero, preserving order
+     */
+    void retain(const std::vector<uint8_t>& keep);
+
+    /**
+     * @brief Append one row
+     */
+    void push_back(int64_t id, double ra_deg, double dec_deg, double plx,
+                   double pm_ra, double pm_dec, double g_mag, double bp_mag,
+                   double rp_mag, double color, double ruwe_value);
+
+    /**
+     * @brief Append the numeric columns of a GaiaStar
+     */
+    void push_back(const GaiaStar& star);
+
+    /**
+     * @brief Append all rows of another batch
+     */
+    void append(const StarBatch& other);
+
+    /**
+     * @brief Row i as a GaiaStar (designation strings left empty)
+     */
+    GaiaStar toGaiaStar(size_t i) const;
+
+    /**
+     * @brief All rows as GaiaStar, for callers of the vector API
+     */
+    std::vector<GaiaStar> toGaiaStars() const;
+
+    /**
+     * @brief Columns of a GaiaStar vector
+     */
+    static StarBatch fromGaiaStars(const std::vector<GaiaStar>& stars);
+};
+
+} // namespace ioc::gaia
+
+#endif // IOC_GAIALIB_STAR_BATCH_H
@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <functional>
+#include <limits>
 
 namespace ioc {
 namespace gaia {
@@ -96,6 +98,84 @@ struct JulianDate {
     double toYears() const { return (jd - 2451545.0) / 365.25 + 2000.0; }
 };
 
+/**
+ * Column limits applied to each record inside the catalog scan
+ *
+ * All limits are inclusive and default to "no limit" (+/- infinity, or
+ * zero for the minimum proper motion). Backends test them on raw records
+ * before the position test and before any GaiaStar is built. A missing
+ * value (NaN) is never rejected by a limit.
+ */
+struct StarFilter {
+    double min_magnitude;        ///< Minimum G magnitude (brightest)
+    double max_magnitude;        ///< Maximum G magnitude (faintest)
+    double min_parallax;         ///< Minimum parallax [mas]
+    double max_parallax;         ///< Maximum parallax [mas]
+    double max_ruwe;             ///< Maximum RUWE
+    double min_bp_rp;            ///< Minimum BP-RP color [mag]
+    double max_bp_rp;            ///< Maximum BP-RP color [mag]
+    double min_proper_motion;    ///< Minimum total proper motion [mas/yr]
+    double max_proper_motion;    ///< Maximum total proper motion [mas/yr]
+    
+    StarFilter()
+        : min_magnitude(-std::numeric_limits<double>::infinity()),
+          max_magnitude(std::numeric_limits<double>::infinity()),
+          min_parallax(-std::numeric_limits<double>::infinity()),
+          max_parallax(std::numeric_limits<double>::infinity()),
+          max_ruwe(std::numeric_limits<double>::infinity()),
+          min_bp_rp(-std::numeric_limits<double>::infinity()),
+          max_bp_rp(std::numeric_limits<double>::infinity()),
+          min_proper_motion(0.0),
+          max_proper_motion(std::numeric_limits<double>::infinity()) {}
+    
+    bool hasMagnitudeLimit() const {
+        return min_magnitude > -std::numeric_limits<double>::infinity() ||
+               max_magnitude < std::numeric_limits<double>::infinity();
+    }
+    bool hasParallaxLimit() const {
+        return min_parallax > -std::numeric_limits<double>::infinity() ||
+               max_parallax < std::numeric_limits<double>::infinity();
+    }
+    bool hasRuweLimit() const { return max_ruwe < std::numeric_limits<double>::infinity(); }
+    bool hasColorLimit() const {
+        return min_bp_rp > -std::numeric_limits<double>::infinity() ||
+               max_bp_rp < std::numeric_limits<double>::infinity();
+    }
+    bool hasProperMotionLimit() const {
+        return min_proper_motion > 0.0 || max_proper_motion < std::numeric_limits<double>::infinity();
+    }
+    
+    /**
+     * True if any limit is set
+     */
+    bool isActive() const {
+        return hasMagnitudeLimit() || hasParallaxLimit() || hasRuweLimit() ||
+               hasColorLimit() || hasProperMotionLimit();
+    }
+    
+    /**
+     * Test one star's columns against all limits
+     */
+    bool accepts(double g_mag, double parallax, double ruwe, double bp_rp,
+                 double pmra, double pmdec) const {
+        if (g_mag < min_magnitude || g_mag > max_magnitude) return false;
+        if (parallax < min_parallax || parallax > max_parallax) return false;
+        if (ruwe > max_ruwe) return false;
+        if (bp_rp < min_bp_rp || bp_rp > max_bp_rp) return false;
+        if (hasProperMotionLimit()) {
+            double pm2 = pmra * pmra + pmdec * pmdec;
+            if (pm2 < min_proper_motion * min_proper_motion ||
+                pm2 > max_proper_motion * max_proper_motion) return false;
+        }
+        return true;
+    }
+    
+    bool accepts(const GaiaStar& star) const {
+        return accepts(star.phot_g_mean_mag, star.parallax, star.ruwe, star.bp_rp,
+                       star.pmra, star.pmdec);
+    }
+};
+
 /**
  * Query parameters for Gaia catalog searches
  */
@@ -105,10 +185,16 @@ struct QueryParams {
     double radius;               ///< Search radius [degrees]
     double max_magnitude;        ///< Maximum G magnitude
     double min_parallax;         ///< Minimum parallax [mas], -1 = no limit
+    StarFilter filter;           ///< Further column limits (RUWE, color, proper motion, ...)
     
     QueryParams() 
         : ra_center(0.0), dec_center(0.0), radius(1.0), 
           max_magnitude(20.0), min_parallax(-1.0) {}
+    
+    /**
+     * filter tightened by max_magnitude and min_parallax
+     */
+    StarFilter starFilter() const;
 };
 
 /**
@@ -146,6 +232,7 @@ struct CorridorQueryParams {
     double max_magnitude;               ///< Maximum G magnitude
     double min_parallax;                ///< Minimum parallax [mas], -1 = no limit
     size_t max_results;                 ///< Maximum results (0 = no limit)
+    StarFilter filter;                  ///< Further column limits (RUWE, color, proper motion, ...)
     
     CorridorQueryParams() 
         : width(0.5), max_magnitude(20.0), min_parallax(-1.0), max_results(0) {}
@@ -179,6 +266,11 @@ struct CorridorQueryParams {
         return path.size() >= 2 && width > 0 && max_magnitude > 0;
     }
     
+    /**
+     * filter tightened by max_magnitude and min_parallax
+     */
+    StarFilter starFilter() const;
+    
     /**
      * Get total path length in degrees (approximate great circle)
      */
@@ -208,10 +300,11 @@ struct OrbitQueryParams {
     std::vector<ChebyshevPolynomial> polynomials; ///< List of polynomials covering the interval
     double width;                   ///< Search width (radius) around the orbit [degrees]
     double max_magnitude;           ///< Maximum G magnitude
-    double step_size;               ///< Step size for discretizing the orbit [same units as time] (0 = auto)
+    double step_size;               ///< Maximum step between path vertices [same units as time] (0 = no limit)
+    double path_tolerance;          ///< Maximum deviation of the path from the orbit, as a fraction of width
     
     OrbitQueryParams() 
-        : t_start(0), t_end(0), width(0.1), max_magnitude(20.0), step_size(0) {}
+        : t_start(0), t_end(0), width(0.1), max_magnitude(20.0), step_size(0), path_tolerance(0.1) {}
         
     bool isValid() const {
         return t_end > t_start && !polynomials.empty() && width > 0;
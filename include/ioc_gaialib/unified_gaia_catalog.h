@@ -12,6 +12,7 @@
 #include <filesystem>
 #include <map>
 #include "types.h"
+#include "star_batch.h"
 
 namespace ioc::gaia {
 
@@ -55,6 +56,8 @@ struct GaiaCatalogConfig {
     
     // Performance settings
     size_t max_cached_chunks = 50;        // Memory cache size (~4GB)
+    size_t max_cache_mb = 0;              // MULTIFILE_V2 cache budget in MB (0: use max_cached_chunks)
+    bool use_mmap = false;                // Map MULTIFILE_V2 chunks instead of copying them
     size_t max_concurrent_requests = 8;   // Max parallel requests
     bool enable_compression = true;       // Enable response compression
     
@@ -122,6 +125,7 @@ public:
      *   "catalog_type": "multifile_v2",
      *   "multifile_directory": "/path/to/multifile/catalog",
      *   "max_cached_chunks": 100,
+     *   "use_mmap": true,
      *   "log_level": "info"
      * }
      * 
@@ -168,6 +172,86 @@ public:
      */
     std::vector<GaiaStar> queryCone(const QueryParams& params) const;
     
+    /**
+     * @brief Cone search returning columns instead of GaiaStar objects
+     * 
+     * Same stars, order and filters as queryCone. The multi-file and
+     * compressed V2 catalogs fill the columns straight from their records;
+     * other backends convert their queryCone result.
+     * 
+     * @param params Query parameters
+     * @return Columnar result
+     */
+    StarBatch queryConeColumns(const QueryParams& params) const;
+    
+    /**
+     * @brief The num_stars brightest stars queryCone would return
+     * 
+     * Brightest first, stars without a G magnitude last. Local backends
+     * select on raw records with bounded heaps (stopping early on
+     * magnitude-ordered multi-file slices) and SQLite reads candidates in
+     * magnitude order, so only the selected stars are built; online
+     * results are reduced the same way after download.
+     * 
+     * @param params Query parameters
+     * @param num_stars Number of stars to return
+     * @return Up to num_stars stars
+     */
+    std::vector<GaiaStar> queryBrightest(const QueryParams& params, size_t num_stars) const;
+    
+    /**
+     * @brief The k catalog stars closest to a position, nearest first
+     * 
+     * The multi-file and compressed V2 catalogs run a best-first search
+     * over their HEALPix index with a bounded heap, opening only pixels
+     * that can still hold one of the k closest stars. Other backends widen
+     * a cone search until it holds k stars. Ties are broken by source_id.
+     * 
+     * @param ra Right Ascension [degrees]
+     * @param dec Declination [degrees]
+     * @param k Number of stars to return
+     * @param max_magnitude Faintest G magnitude considered
+     * @return Up to k stars
+     */
+    std::vector<GaiaStar> queryNearest(double ra, double dec, size_t k,
+                                       double max_magnitude = std::numeric_limits<double>::infinity()) const;
+    
+    /**
+     * @brief queryNearest for many positions
+     * 
+     * Targets are answered in HEALPix order, so neighbouring positions hit
+     * the same cached chunks, and in parallel on the indexed backends.
+     * 
+     * @return One result per target, in input order
+     */
+    std::vector<std::vector<GaiaStar>> queryNearestBatch(
+        const std::vector<EquatorialCoordinates>& targets, size_t k,
+        double max_magnitude = std::numeric_limits<double>::infinity()
+    ) const;
+    
+    /**
+     * @brief Number of stars queryCone would return
+     * 
+     * When the only limit is a G magnitude cut, the multi-file and
+     * compressed V2 catalogs count pixels inside the cone from their index
+     * and scan only the pixels on its edge (the compressed V2 index has no
+     * magnitude bins, so there a cut fainter than the catalog limit is
+     * required). Other cases count the columnar result.
+     * 
+     * @param params Query parameters
+     * @return Star count
+     */
+    size_t countInCone(const QueryParams& params) const;
+    
+    /**
+     * @brief Materialize a columnar result as GaiaStar objects
+     * @param batch Result of queryConeColumns
+     * @param with_names Fill SAO/HD/HIP/Tycho-2 designations and common
+     *                   names from the loaded star names (if any)
+     * @return One GaiaStar per row
+     */
+    std::vector<GaiaStar> toGaiaStars(const StarBatch& batch, bool with_names = true) const;
+    
     /**
      * @brief Asynchronous cone search
      * @param params Query parameters
@@ -181,6 +265,11 @@ public:
     
     /**
      * @brief Batch query multiple regions
+     * 
+     * With the multi-file catalog the batch is planned as a whole: every
+     * chunk needed by any cone is loaded once and scanned against all the
+     * cones touching it, in parallel.
+     * 
      * @param param_list List of query parameters
      * @return Vector of result vectors (one per query)
      */
@@ -230,6 +319,32 @@ public:
      */
     std::optional<GaiaStar> queryByName(const std::string& common_name) const;
     
+    /**
+     * @brief Query many stars by source ID
+     * 
+     * The SQLite backend resolves the list in batched statements; other
+     * backends look the ids up one by one.
+     * 
+     * @param source_ids Gaia source identifiers
+     * @return One entry per id, in input order (empty if not found)
+     */
+    std::vector<std::optional<GaiaStar>> queryBySourceIds(const std::vector<uint64_t>& source_ids) const;
+    
+    /**
+     * @brief Query many stars by catalog designation
+     * 
+     * Batched counterpart of queryBySAO, queryByHD, queryByHipparcos,
+     * queryByTycho2 and queryByName, for cross-identifying target lists.
+     * 
+     * @param catalog Catalog type ("SAO", "HD", "HIP", "TYC", "NAME")
+     * @param designations Identifiers in that catalog
+     * @return One entry per designation, in input order (empty if not found)
+     */
+    std::vector<std::optional<GaiaStar>> queryByDesignations(
+        const std::string& catalog,
+        const std::vector<std::string>& designations
+    ) const;
+    
     /**
      * @brief Query stars along a corridor/path
      * 
@@ -1,23 +1,43 @@
 #include "../include/ioc_gaialib/concurrent_multifile_catalog_v2.h"
+#include "../include/ioc_gaialib/corridor.h"
+#include "../include/ioc_gaialib/brightest_selector.h"
 #include <fstream>
 #include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <thread>
+#include <cstring>
 
 namespace ioc {
 namespace gaia {
 
+namespace {
+
+// Defaults except the chunk count, set by name so new fields stay safe
+MultiFileCatalogOptions chunkCountOptions(size_t max_cached_chunks) {
+    MultiFileCatalogOptions options;
+    options.max_cached_chunks = max_cached_chunks;
+    return options;
+}
+
+} // anonymous namespace
+
 ConcurrentMultiFileCatalogV2::ConcurrentMultiFileCatalogV2(const std::string& catalog_dir, 
                                                            size_t max_cached_chunks)
-    : catalog_dir_(catalog_dir), max_cached_chunks_(max_cached_chunks) {
+    : ConcurrentMultiFileCatalogV2(catalog_dir, chunkCountOptions(max_cached_chunks)) {}
+
+ConcurrentMultiFileCatalogV2::ConcurrentMultiFileCatalogV2(const std::string& catalog_dir,
+                                                           const MultiFileCatalogOptions& options)
+    : catalog_dir_(catalog_dir), options_(options) {
     
     if (!loadMetadata()) {
         throw std::runtime_error("Failed to load catalog metadata from: " + catalog_dir);
     }
     
-    // Reserve space to avoid reallocations during concurrent access
-    chunk_cache_.reserve(max_cached_chunks_ * 2);
+    // Optional: fall back to scanning chunks when the sidecar is absent
+    loadSourceIndex();
+    
+    initCache();
 }
 
 ConcurrentMultiFileCatalogV2::~ConcurrentMultiFileCatalogV2() = default;
@@ -37,7 +57,12 @@ bool ConcurrentMultiFileCatalogV2::loadMetadata() {
         std::cerr << "Failed to read catalog header" << std::endl;
         return false;
     }
-    
+
+    if (hasNestedIndex() && !healpix::isValidNside(header_.healpix_nside)) {
+        std::cerr << "Invalid HEALPix NSIDE: " << header_.healpix_nside << std::endl;
+        return false;
+    }
+
     // Read NEW format HEALPix index (PixelChunkEntry + chunk lists)
     pixel_index_.resize(header_.num_healpix_pixels);
     file.read(reinterpret_cast<char*>(pixel_index_.data()), 
@@ -64,59 +89,282 @@ bool ConcurrentMultiFileCatalogV2::loadMetadata() {
         return false;
     }
     
+    // Pixel-sorted layout: (chunk, offset, count) slice per chunk list entry
+    const uint32_t slice_flags = MAG18_FLAG_NESTED_INDEX | MAG18_FLAG_PIXEL_SORTED;
+    if ((header_.format_flags & slice_flags) == slice_flags) {
+        pixel_slices_.resize(total_chunk_entries);
+        file.read(reinterpret_cast<char*>(pixel_slices_.data()), 
+                  total_chunk_entries * sizeof(ChunkPixelInfo));
+        
+        if (!file) {
+            std::cerr << "Failed to read pixel slices" << std::endl;
+            return false;
+        }
+    }
+    
     return true;
 }
 
+bool ConcurrentMultiFileCatalogV2::loadSourceIndex() {
+    std::string index_path = catalog_dir_ + "/source_index.dat";
+    if (!source_index_file_.open(index_path)) {
+        return false;
+    }
+    
+    const uint8_t* base = source_index_file_.data();
+    const size_t size = source_index_file_.size();
+    
+    SourceIndexHeader index_header;
+    if (size < sizeof(index_header)) {
+        std::cerr << "Source index too small, ignoring: " << index_path << std::endl;
+        source_index_file_.close();
+        return false;
+    }
+    std::memcpy(&index_header, base, sizeof(index_header));
+    
+    const bool fences_only = (index_header.flags & SOURCE_INDEX_FENCES_ONLY) != 0;
+    const uint64_t fence_bytes = index_header.total_chunks * sizeof(SourceIdFence);
+    const uint64_t entry_bytes = fences_only ? 0 : index_header.num_entries * sizeof(SourceIdEntry);
+    
+    if (std::memcmp(index_header.magic, "GAIASIDX", 8) != 0 || index_header.version != 1) {
+        std::cerr << "Invalid source index format, ignoring: " << index_path << std::endl;
+        source_index_file_.close();
+        return false;
+    }
+    if (index_header.total_chunks != header_.total_chunks ||
+        index_header.total_stars != header_.total_stars) {
+        std::cerr << "Source index does not match metadata (stale?), ignoring: " 
+                  << index_path << std::endl;
+        source_index_file_.close();
+        return false;
+    }
+    if (index_header.fence_offset % alignof(SourceIdFence) != 0 ||
+        index_header.fence_offset + fence_bytes > size ||
+        (!fences_only && (index_header.entry_offset % alignof(SourceIdEntry) != 0 ||
+                          index_header.entry_offset + entry_bytes > size))) {
+        std::cerr << "Source index truncated, ignoring: " << index_path << std::endl;
+        source_index_file_.close();
+        return false;
+    }
+    
+    source_fences_ = reinterpret_cast<const SourceIdFence*>(base + index_header.fence_offset);
+    if (!fences_only) {
+        source_entries_ = reinterpret_cast<const SourceIdEntry*>(base + index_header.entry_offset);
+        num_source_entries_ = index_header.num_entries;
+    }
+    return true;
+}
+
+std::optional<GaiaStar> ConcurrentMultiFileCatalogV2::lookupSourceIndex(uint64_t source_id) {
+    if (source_entries_) {
+        // Full form: sorted (source_id, chunk, offset) array
+        const SourceIdEntry* end = source_entries_ + num_source_entries_;
+        const SourceIdEntry* it = std::lower_bound(source_entries_, end, source_id,
+            [](const SourceIdEntry& entry, uint64_t id) {
+                return entry.source_id < id;
+            });
+        if (it == end || it->source_id != source_id) {
+            return std::nullopt;
+        }
+        
+        auto chunk_data = getOrLoadChunk(it->chunk_id, MappedFile::Advice::Random);
+        if (!chunk_data) return std::nullopt;
+        
+        const auto& chunk_records = chunk_data->records;
+        if (it->record_offset < chunk_records.size() &&
+            chunk_records[it->record_offset].source_id == source_id) {
+            return recordToStar(chunk_records[it->record_offset]);
+        }
+        return std::nullopt;
+    }
+    
+    // Fence-only form: chunks are sorted and disjoint, so the candidate is
+    // the last chunk whose minimum does not exceed the id
+    const SourceIdFence* begin = source_fences_;
+    const SourceIdFence* end = source_fences_ + header_.total_chunks;
+    const SourceIdFence* it = std::upper_bound(begin, end, source_id,
+        [](uint64_t id, const SourceIdFence& fence) {
+            return id < fence.min_source_id;
+        });
+    if (it == begin) {
+        return std::nullopt;
+    }
+    --it;
+    if (source_id > it->max_source_id) {
+        return std::nullopt;
+    }
+    
+    auto chunk_data = getOrLoadChunk(static_cast<uint64_t>(it - begin), MappedFile::Advice::Random);
+    if (!chunk_data) return std::nullopt;
+    
+    const auto& chunk_records = chunk_data->records;
+    auto rec = std::lower_bound(chunk_records.begin(), chunk_records.end(), source_id,
+        [](const Mag18RecordV2& record, uint64_t id) {
+            return record.source_id < id;
+        });
+    if (rec != chunk_records.end() && rec->source_id == source_id) {
+        return recordToStar(*rec);
+    }
+    return std::nullopt;
+}
+
+void ConcurrentMultiFileCatalogV2::initCache() {
+    // Nominal chunk size converts the chunk-count capacity into bytes
+    const size_t stars_per_chunk = header_.stars_per_chunk > 0 ? header_.stars_per_chunk : 1000000;
+    const size_t nominal_chunk_bytes = stars_per_chunk * sizeof(Mag18RecordV2);
+    const size_t capacity_bytes = options_.max_cache_bytes > 0
+        ? options_.max_cache_bytes
+        : std::max<size_t>(1, options_.max_cached_chunks) * nominal_chunk_bytes;
+    
+    // Shards hold at least four nominal chunks each, so that the per-shard
+    // capacity split does not turn small caches into thrashing ones
+    num_shards_ = options_.cache_shards;
+    if (num_shards_ == 0) {
+        num_shards_ = std::clamp<size_t>(capacity_bytes / (4 * nominal_chunk_bytes), 1, 16);
+    }
+    
+    shards_ = std::make_unique<CacheShard[]>(num_shards_);
+    for (size_t i = 0; i < num_shards_; ++i) {
+        shards_[i].capacity_bytes = capacity_bytes / num_shards_;
+    }
+}
+
 std::shared_ptr<ConcurrentMultiFileCatalogV2::ChunkData> 
-ConcurrentMultiFileCatalogV2::getOrLoadChunk(uint64_t chunk_id) {
+ConcurrentMultiFileCatalogV2::getOrLoadChunk(uint64_t chunk_id, MappedFile::Advice advice) {
+    CacheShard& shard = shardFor(chunk_id);
     
-    // First check with read lock (fast path for cache hits)
+    // Fast path for cache hits: shared lock, reference bit only
     {
-        std::shared_lock<std::shared_mutex> lock(cache_mutex_);
-        auto it = chunk_cache_.find(chunk_id);
-        if (it != chunk_cache_.end()) {
-            it->second->last_access = std::chrono::steady_clock::now();
-            cache_hits_++;
-            return it->second;
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.slots.find(chunk_id);
+        if (it != shard.slots.end()) {
+            const auto& chunk = shard.ring[it->second];
+            // Skip the store when already set so hot chunks stay read-shared
+            if (!chunk->referenced.load(std::memory_order_relaxed)) {
+                chunk->referenced.store(true, std::memory_order_relaxed);
+            }
+            shard.hits.fetch_add(1, std::memory_order_relaxed);
+            return chunk;
         }
     }
     
-    // Cache miss - need to load chunk with write lock
-    std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+    // Cache miss: either join a load already in flight or claim the load.
+    // The write lock only covers map bookkeeping, never disk I/O.
+    std::promise<std::shared_ptr<ChunkData>> load_promise;
+    {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        
+        // Double-check after acquiring write lock
+        auto it = shard.slots.find(chunk_id);
+        if (it != shard.slots.end()) {
+            const auto& chunk = shard.ring[it->second];
+            chunk->referenced.store(true, std::memory_order_relaxed);
+            shard.hits.fetch_add(1, std::memory_order_relaxed);
+            return chunk;
+        }
+        
+        auto pending = shard.loading.find(chunk_id);
+        if (pending != shard.loading.end()) {
+            auto future = pending->second;
+            lock.unlock();
+            shard.hits.fetch_add(1, std::memory_order_relaxed);
+            return future.get();
+        }
+        
+        shard.loading.emplace(chunk_id, load_promise.get_future().share());
+        shard.misses.fetch_add(1, std::memory_order_relaxed);
+    }
     
-    // Double-check after acquiring write lock
-    auto it = chunk_cache_.find(chunk_id);
-    if (it != chunk_cache_.end()) {
-        it->second->last_access = std::chrono::steady_clock::now();
-        cache_hits_++;
-        return it->second;
+    // Actually load the chunk, with no cache lock held
+    std::shared_ptr<ChunkData> chunk_data;
+    try {
+        chunk_data = loadChunk(chunk_id, advice);
+    } catch (...) {
+        {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            shard.loading.erase(chunk_id);
+        }
+        load_promise.set_exception(std::current_exception());
+        throw;
     }
     
-    // Actually load the chunk
-    cache_misses_++;
-    auto chunk_data = loadChunk(chunk_id);
+    {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.loading.erase(chunk_id);
+        
+        // Failed loads are not cached; waiters receive nullptr as well
+        if (chunk_data) {
+            insertIntoShard(shard, chunk_data);
+        }
+    }
     
-    if (!chunk_data) {
-        return nullptr;
+    load_promise.set_value(chunk_data);
+    return chunk_data;
+}
+
+void ConcurrentMultiFileCatalogV2::insertIntoShard(CacheShard& shard, std::shared_ptr<ChunkData> chunk) {
+    // Make room first; a chunk larger than the whole shard is still admitted
+    while (!shard.slots.empty() && shard.bytes + chunk->bytes > shard.capacity_bytes) {
+        evictOne(shard);
     }
     
-    // Evict old chunks if cache is full
-    if (chunk_cache_.size() >= max_cached_chunks_) {
-        evictLRUChunks();
+    size_t slot;
+    if (!shard.free_slots.empty()) {
+        slot = shard.free_slots.back();
+        shard.free_slots.pop_back();
+    } else {
+        slot = shard.ring.size();
+        shard.ring.emplace_back();
     }
     
-    chunk_cache_[chunk_id] = chunk_data;
-    return chunk_data;
+    shard.bytes += chunk->bytes;
+    shard.slots[chunk->chunk_id] = slot;
+    shard.ring[slot] = std::move(chunk);
+}
+
+void ConcurrentMultiFileCatalogV2::evictOne(CacheShard& shard) {
+    // CLOCK: give referenced chunks a second chance, evict the first
+    // unreferenced one. Terminates within two sweeps of the ring.
+    for (;;) {
+        size_t pos = shard.hand;
+        shard.hand = (shard.hand + 1) % shard.ring.size();
+        
+        auto& entry = shard.ring[pos];
+        if (!entry) continue;
+        if (entry->referenced.exchange(false, std::memory_order_relaxed)) continue;
+        
+        shard.bytes -= entry->bytes;
+        shard.slots.erase(entry->chunk_id);
+        entry.reset();
+        shard.free_slots.push_back(pos);
+        shard.evictions.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
 }
 
 std::shared_ptr<ConcurrentMultiFileCatalogV2::ChunkData> 
-ConcurrentMultiFileCatalogV2::loadChunk(uint64_t chunk_id) {
+ConcurrentMultiFileCatalogV2::loadChunk(uint64_t chunk_id, MappedFile::Advice advice) {
     
     if (chunk_id >= header_.total_chunks) {
         return nullptr;
     }
     
     std::string chunk_path = getChunkPath(chunk_id);
+    
+    if (options_.use_mmap) {
+        // Records are uncompressed and 4-byte aligned: view them in place
+        auto mapping = std::make_shared<MappedFile>();
+        if (!mapping->open(chunk_path)) {
+            std::cerr << "Cannot map chunk file: " << chunk_path << std::endl;
+            return nullptr;
+        }
+        mapping->advise(advice);
+        
+        const auto* data = reinterpret_cast<const Mag18RecordV2*>(mapping->data());
+        size_t num_records = mapping->size() / sizeof(Mag18RecordV2);
+        return std::make_shared<ChunkData>(chunk_id, RecordSpan(std::move(mapping), data, num_records));
+    }
+    
     std::ifstream file(chunk_path, std::ios::binary);
     
     if (!file) {
@@ -139,119 +387,869 @@ ConcurrentMultiFileCatalogV2::loadChunk(uint64_t chunk_id) {
         return nullptr;
     }
     
-    return std::make_shared<ChunkData>(chunk_id, std::move(records));
+    return std::make_shared<ChunkData>(chunk_id, RecordSpan::fromVector(std::move(records)));
+}
+
+std::vector<uint32_t> ConcurrentMultiFileCatalogV2::getChunksForCone(double ra, double dec, double radius) const {
+    // Get all pixel ranges that intersect the search cone
+    return getChunksForPixels(getPixelsInCone(ra, dec, radius));
 }
 
-std::set<uint32_t> ConcurrentMultiFileCatalogV2::getChunksForCone(double ra, double dec, double radius) const {
-    std::set<uint32_t> chunks;
+std::vector<uint32_t> ConcurrentMultiFileCatalogV2::getChunksToScan(double ra, double dec, double radius) const {
+    // Use HEALPix index to find relevant chunks
+    auto relevant_chunks = getChunksForCone(ra, dec, radius);
     
-    // Get all pixels that intersect the search cone
-    auto pixels = getPixelsInCone(ra, dec, radius);
+    // If the index is not loaded, fall back to scanning all chunks
+    if (pixel_index_.empty() && header_.total_chunks > 0) {
+        relevant_chunks.resize(header_.total_chunks);
+        for (uint32_t i = 0; i < header_.total_chunks; ++i) {
+            relevant_chunks[i] = i;
+        }
+    }
+    return relevant_chunks;
+}
+
+std::vector<uint32_t> ConcurrentMultiFileCatalogV2::getChunksForPixels(const std::vector<healpix::PixelRange>& ranges) const {
+    std::vector<uint32_t> chunks;
     
-    // For each pixel, find the chunks that contain stars in that pixel
-    for (uint32_t pixel : pixels) {
-        // Binary search in pixel_index_
-        auto it = std::lower_bound(pixel_index_.begin(), pixel_index_.end(), pixel,
+    // pixel_index_ is sorted by pixel_id: one binary search per range, then
+    // walk the populated pixels inside it
+    for (const auto& range : ranges) {
+        auto it = std::lower_bound(pixel_index_.begin(), pixel_index_.end(), range.begin,
             [](const PixelChunkEntry& entry, uint32_t pix) {
                 return entry.pixel_id < pix;
             });
         
-        if (it != pixel_index_.end() && it->pixel_id == pixel) {
-            // Add all chunks for this pixel
+        for (; it != pixel_index_.end() && it->pixel_id < range.end; ++it) {
             uint64_t offset = it->chunk_list_offset;
             for (uint32_t i = 0; i < it->num_chunks; ++i) {
                 if (offset + i < chunk_lists_.size()) {
-                    chunks.insert(chunk_lists_[offset + i]);
+                    chunks.push_back(chunk_lists_[offset + i]);
                 }
             }
         }
     }
     
+    std::sort(chunks.begin(), chunks.end());
+    chunks.erase(std::unique(chunks.begin(), chunks.end()), chunks.end());
     return chunks;
 }
 
-std::vector<GaiaStar> ConcurrentMultiFileCatalogV2::queryCone(double ra, double dec, double radius, 
-                                                              size_t max_results) {
-    active_readers_++;
-    std::vector<GaiaStar> results;
+std::vector<ChunkPixelInfo> ConcurrentMultiFileCatalogV2::getSlicesForCone(double ra, double dec, double radius) const {
+    return getSlicesForPixels(getPixelsInCone(ra, dec, radius));
+}
+
+std::vector<ChunkPixelInfo> ConcurrentMultiFileCatalogV2::getSlicesForPixels(const std::vector<healpix::PixelRange>& ranges) const {
+    std::vector<ChunkPixelInfo> slices;
     
-    // Use HEALPix index to find relevant chunks
-    auto relevant_chunks = getChunksForCone(ra, dec, radius);
+    for (const auto& range : ranges) {
+        auto it = std::lower_bound(pixel_index_.begin(), pixel_index_.end(), range.begin,
+            [](const PixelChunkEntry& entry, uint32_t pix) {
+                return entry.pixel_id < pix;
+            });
+        
+        for (; it != pixel_index_.end() && it->pixel_id < range.end; ++it) {
+            uint64_t offset = it->chunk_list_offset;
+            for (uint32_t i = 0; i < it->num_chunks; ++i) {
+                if (offset + i < pixel_slices_.size()) {
+                    slices.push_back(pixel_slices_[offset + i]);
+                }
+            }
+        }
+    }
     
-    // If index is empty or not loaded, fall back to scanning all chunks
-    if (relevant_chunks.empty() && header_.total_chunks > 0) {
-        for (uint32_t i = 0; i < header_.total_chunks; ++i) {
-            relevant_chunks.insert(i);
+    // Group by chunk so each chunk is fetched once, and merge slices of
+    // neighbouring pixels that are contiguous on disk (unless slices are
+    // magnitude-ordered: the bright prefix is per pixel)
+    std::sort(slices.begin(), slices.end(),
+        [](const ChunkPixelInfo& a, const ChunkPixelInfo& b) {
+            return a.chunk_id != b.chunk_id ? a.chunk_id < b.chunk_id
+                                            : a.first_star_offset < b.first_star_offset;
+        });
+    if (hasMagnitudeOrder()) {
+        return slices;
+    }
+    
+    std::vector<ChunkPixelInfo> merged;
+    merged.reserve(slices.size());
+    for (const auto& slice : slices) {
+        if (!merged.empty() && merged.back().chunk_id == slice.chunk_id &&
+            merged.back().first_star_offset + merged.back().num_stars == slice.first_star_offset) {
+            merged.back().num_stars += slice.num_stars;
+        } else {
+            merged.push_back(slice);
         }
     }
     
+    return merged;
+}
+
+ConcurrentMultiFileCatalogV2::ConeBounds 
+ConcurrentMultiFileCatalogV2::makeConeBounds(double ra, double dec, double radius,
+                                             const StarFilter& filter) {
+    ConeBounds cone;
+    cone.ra = ra;
+    cone.dec = dec;
+    cone.radius = radius;
+    cone.filter = filter;
+    cone.filtered = filter.isActive();
+    
     // Calculate Dec bounds for quick filtering
-    const double dec_min = std::max(-90.0, dec - radius);
-    const double dec_max = std::min(90.0, dec + radius);
+    cone.dec_min = std::max(-90.0, dec - radius);
+    cone.dec_max = std::min(90.0, dec + radius);
     
-    // Calculate RA bounds (accounting for cos(dec) factor)
+    // Calculate RA bounds: the widest point of the cone is at
+    // asin(sin(radius) / cos(dec)) from its centre (radius / cos(dec) falls
+    // short for wide cones); a cone that contains a pole spans every RA
     const double cos_dec = std::cos(dec * M_PI / 180.0);
-    const double ra_margin = (cos_dec > 0.01) ? radius / cos_dec : 180.0;
-    double ra_min = ra - ra_margin;
-    double ra_max = ra + ra_margin;
+    const bool contains_pole = (dec + radius >= 90.0 || dec - radius <= -90.0);
+    const double sin_ratio = std::sin(radius * M_PI / 180.0) / cos_dec;
+    const double ra_margin = (cos_dec > 0.01 && !contains_pole && sin_ratio < 1.0)
+        ? std::asin(sin_ratio) * 180.0 / M_PI + 1e-9 : 180.0;
+    cone.ra_min = ra - ra_margin;
+    cone.ra_max = ra + ra_margin;
     
     // Handle RA wrap-around
-    bool crosses_zero = (ra_min < 0 || ra_max > 360);
-    if (ra_min < 0) ra_min += 360;
-    if (ra_max > 360) ra_max -= 360;
+    cone.crosses_zero = (cone.ra_min < 0 || cone.ra_max > 360);
+    if (cone.ra_min < 0) cone.ra_min += 360;
+    if (cone.ra_max > 360) cone.ra_max -= 360;
+    return cone;
+}
+
+bool ConcurrentMultiFileCatalogV2::ConeBounds::contains(const Mag18RecordV2& record) const {
+    // Quick bounding box check first (very fast)
+    if (record.dec < dec_min || record.dec > dec_max) return false;
+    
+    // RA check with wrap-around handling
+    bool ra_ok;
+    if (crosses_zero) {
+        ra_ok = (record.ra >= ra_min || record.ra <= ra_max);
+    } else {
+        ra_ok = (record.ra >= ra_min && record.ra <= ra_max);
+    }
+    if (!ra_ok) return false;
+    
+    // Precise angular distance check
+    return angularDistance(ra, dec, record.ra, record.dec) <= radius;
+}
+
+std::vector<GaiaStar> ConcurrentMultiFileCatalogV2::queryCone(double ra, double dec, double radius, 
+                                                              size_t max_results) {
+    return queryCone(ra, dec, radius, StarFilter(), max_results);
+}
+
+std::vector<GaiaStar> ConcurrentMultiFileCatalogV2::queryCone(double ra, double dec, double radius,
+                                                              const StarFilter& filter,
+                                                              size_t max_results) {
+    std::vector<GaiaStar> results;
+    forEachInCone(ra, dec, radius, filter, [&](const Mag18RecordV2& record) {
+        results.push_back(recordToStar(record));
+        return max_results == 0 || results.size() < max_results;
+    });
+    return results;
+}
+
+StarBatch ConcurrentMultiFileCatalogV2::queryConeColumns(double ra, double dec, double radius,
+                                                         size_t max_results) {
+    return queryConeColumns(ra, dec, radius, StarFilter(), max_results);
+}
+
+StarBatch ConcurrentMultiFileCatalogV2::queryConeColumns(double ra, double dec, double radius,
+                                                         const StarFilter& filter,
+                                                         size_t max_results) {
+    StarBatch results;
+    forEachInCone(ra, dec, radius, filter, [&](const Mag18RecordV2& record) {
+        appendRecord(results, record);
+        return max_results == 0 || results.size() < max_results;
+    });
+    return results;
+}
+
+void ConcurrentMultiFileCatalogV2::forEachInCone(double ra, double dec, double radius,
+                                                 const StarFilter& filter,
+                                                 const std::function<bool(const Mag18RecordV2&)>& on_hit) {
+    active_readers_++;
+    const ConeBounds cone = makeConeBounds(ra, dec, radius, filter);
+    
+    // Returns false once on_hit asks to stop
+    auto scan = [&](const RecordSpan& records) {
+        for (const auto& record : records) {
+            if (cone.matches(record) && !on_hit(record)) {
+                return false;
+            }
+        }
+        return true;
+    };
+    
+    if (hasPixelSlices()) {
+        // Pixel-sorted layout: read only the slices of intersecting pixels
+        std::shared_ptr<ChunkData> chunk_data;
+        for (const auto& slice : getSlicesForCone(ra, dec, radius)) {
+            if (!chunk_data || chunk_data->chunk_id != slice.chunk_id) {
+                chunk_data = getOrLoadChunk(slice.chunk_id);
+                if (!chunk_data) continue;
+            }
+            if (!scan(magnitudePrefix(chunk_data->records.subspan(slice.first_star_offset, slice.num_stars),
+                                      filter.max_magnitude))) {
+                break;
+            }
+        }
+        active_readers_--;
+        return;
+    }
     
     // Only scan relevant chunks (from HEALPix index)
-    for (uint32_t chunk_id : relevant_chunks) {
+    for (uint32_t chunk_id : getChunksToScan(ra, dec, radius)) {
         if (chunk_id >= header_.total_chunks) continue;
         
         // Get chunk data (thread-safe with caching)
         auto chunk_data = getOrLoadChunk(chunk_id);
         if (!chunk_data) continue;
         
-        // Read lock for accessing chunk records (allows multiple readers)
-        std::shared_lock<std::shared_mutex> chunk_lock(chunk_data->access_mutex);
-        const auto& chunk_records = chunk_data->records;
+        if (!scan(chunk_data->records)) {
+            break;
+        }
+    }
+    
+    active_readers_--;
+}
+
+size_t ConcurrentMultiFileCatalogV2::countInCone(double ra, double dec, double radius,
+                                                 double max_magnitude) {
+    // A limit at or beyond the catalog's own cut keeps every star
+    StarFilter filter;
+    if (header_.mag_limit <= 0.0 || max_magnitude < header_.mag_limit) {
+        filter.max_magnitude = max_magnitude;
+    }
+    
+    if (!hasPixelSlices() || !hasNestedIndex()) {
+        size_t count = 0;
+        forEachInCone(ra, dec, radius, filter, [&](const Mag18RecordV2&) {
+            count++;
+            return true;
+        });
+        return count;
+    }
+    
+    active_readers_++;
+    const ConeBounds cone = makeConeBounds(ra, dec, radius, filter);
+    const bool limited = filter.hasMagnitudeLimit();
+    
+    std::vector<healpix::PixelRange> inner, boundary;
+    healpix::queryDisc(header_.healpix_nside, healpix::radecToVec(ra, dec), radius * M_PI / 180.0,
+                       inner, boundary);
+    
+    size_t count = 0;
+    std::shared_ptr<ChunkData> chunk_data;
+    
+    // Inside pixels: the slice size, or its bright prefix under a limit
+    for (const auto& slice : getSlicesForPixels(inner)) {
+        if (!limited) {
+            count += slice.num_stars;
+            continue;
+        }
+        if (!chunk_data || chunk_data->chunk_id != slice.chunk_id) {
+            chunk_data = getOrLoadChunk(slice.chunk_id);
+            if (!chunk_data) continue;
+        }
+        const RecordSpan records = magnitudePrefix(
+            chunk_data->records.subspan(slice.first_star_offset, slice.num_stars), filter.max_magnitude);
+        if (hasMagnitudeOrder()) {
+            count += records.size();
+            continue;
+        }
+        for (const auto& record : records) {
+            if (acceptsRecord(filter, record)) count++;
+        }
+    }
+    
+    // Edge pixels: full position test
+    for (const auto& slice : getSlicesForPixels(boundary)) {
+        if (!chunk_data || chunk_data->chunk_id != slice.chunk_id) {
+            chunk_data = getOrLoadChunk(slice.chunk_id);
+            if (!chunk_data) continue;
+        }
+        const RecordSpan records = magnitudePrefix(
+            chunk_data->records.subspan(slice.first_star_offset, slice.num_stars), filter.max_magnitude);
+        for (const auto& record : records) {
+            if (cone.matches(record)) count++;
+        }
+    }
+    
+    active_readers_--;
+    return count;
+}
+
+std::vector<GaiaStar> ConcurrentMultiFileCatalogV2::queryBrightest(double ra, double dec, double radius,
+                                                                   size_t num_stars,
+                                                                   const StarFilter& filter) {
+    if (num_stars == 0) {
+        return {};
+    }
+    active_readers_++;
+    const ConeBounds cone = makeConeBounds(ra, dec, radius, filter);
+    const bool ordered = hasMagnitudeOrder();
+    
+    // Offers the cone members of one span; on magnitude-ordered slices the
+    // measured part is ascending in G, so the scan stops at the first
+    // record that can no longer enter, and the missing-G prefix is only
+    // read while the heap has room for it
+    auto scan = [&](BrightestSelector<Mag18RecordV2>& local, const RecordSpan& records) {
+        auto measured = records.begin();
+        if (ordered) {
+            measured = std::partition_point(records.begin(), records.end(),
+                [](const Mag18RecordV2& record) { return std::isnan(record.g_mag); });
+        }
+        for (auto it = measured; it != records.end(); ++it) {
+            if (local.excludes(it->g_mag)) {
+                if (ordered) break;
+                continue;
+            }
+            if (cone.matches(*it)) local.offer(it->g_mag, it->source_id, *it);
+        }
+        for (auto it = records.begin(); it != measured && !local.excludes(it->g_mag); ++it) {
+            if (cone.matches(*it)) local.offer(it->g_mag, it->source_id, *it);
+        }
+    };
+    
+    // One bounded heap per thread on the raw records, merged at the end
+    BrightestSelector<Mag18RecordV2> best(num_stars);
+    
+    if (hasPixelSlices()) {
+        const auto slices = getSlicesForCone(ra, dec, radius);
+        const long num_slices = static_cast<long>(slices.size());
         
-        // Process stars in this chunk
-        for (const auto& record : chunk_records) {
-            // Quick bounding box check first (very fast)
-            if (record.dec < dec_min || record.dec > dec_max) continue;
+        #pragma omp parallel if(num_slices >= 16)
+        {
+            BrightestSelector<Mag18RecordV2> local(num_stars);
+            std::shared_ptr<ChunkData> chunk_data;
             
-            // RA check with wrap-around handling
-            bool ra_ok;
-            if (crosses_zero) {
-                ra_ok = (record.ra >= ra_min || record.ra <= ra_max);
-            } else {
-                ra_ok = (record.ra >= ra_min && record.ra <= ra_max);
+            #pragma omp for schedule(dynamic, 16) nowait
+            for (long i = 0; i < num_slices; ++i) {
+                const ChunkPixelInfo& slice = slices[i];
+                if (!chunk_data || chunk_data->chunk_id != slice.chunk_id) {
+                    chunk_data = getOrLoadChunk(slice.chunk_id);
+                    if (!chunk_data) continue;
+                }
+                scan(local, magnitudePrefix(chunk_data->records.subspan(slice.first_star_offset, slice.num_stars),
+                                            filter.max_magnitude));
             }
-            if (!ra_ok) continue;
             
-            // Precise angular distance check
-            double dist = angularDistance(ra, dec, record.ra, record.dec);
-            if (dist <= radius) {
-                results.push_back(recordToStar(record));
-                
-                if (max_results > 0 && results.size() >= max_results) {
-                    active_readers_--;
-                    return results;
+            #pragma omp critical
+            best.merge(local);
+        }
+    } else {
+        const auto chunks = getChunksToScan(ra, dec, radius);
+        const long num_chunks = static_cast<long>(chunks.size());
+        
+        #pragma omp parallel if(num_chunks > 1)
+        {
+            BrightestSelector<Mag18RecordV2> local(num_stars);
+            
+            #pragma omp for schedule(dynamic, 1) nowait
+            for (long i = 0; i < num_chunks; ++i) {
+                if (chunks[i] >= header_.total_chunks) continue;
+                auto chunk_data = getOrLoadChunk(chunks[i]);
+                if (chunk_data) scan(local, chunk_data->records);
+            }
+            
+            #pragma omp critical
+            best.merge(local);
+        }
+    }
+    
+    std::vector<GaiaStar> results;
+    for (const auto& record : best.take()) {
+        results.push_back(recordToStar(record));
+    }
+    active_readers_--;
+    return results;
+}
+
+std::vector<GaiaStar> ConcurrentMultiFileCatalogV2::queryNearest(double ra, double dec, size_t k,
+                                                                 const StarFilter& filter) {
+    if (k == 0) {
+        return {};
+    }
+    active_readers_++;
+    const bool filtered = filter.isActive();
+    BrightestSelector<Mag18RecordV2> nearest(k);  // Ranked by distance
+    
+    auto offer = [&](const RecordSpan& records) {
+        for (const auto& record : records) {
+            // The distance is at least the declination difference
+            if (std::abs(record.dec - dec) > nearest.threshold()) continue;
+            if (filtered && !acceptsRecord(filter, record)) continue;
+            nearest.offer(angularDistance(ra, dec, record.ra, record.dec), record.source_id, record);
+        }
+    };
+    
+    if (hasNestedIndex() && !pixel_index_.empty()) {
+        // Best-first over pixels; whole chunks (no slice directory) are
+        // scanned once, the first time one of their pixels comes up
+        std::vector<bool> scanned(hasPixelSlices() ? 0 : header_.total_chunks, false);
+        healpix::walkByDistance(header_.healpix_nside, healpix::radecToVec(ra, dec),
+            [&](uint32_t pixel, double) {
+                auto it = std::lower_bound(pixel_index_.begin(), pixel_index_.end(), pixel,
+                    [](const PixelChunkEntry& entry, uint32_t pix) {
+                        return entry.pixel_id < pix;
+                    });
+                if (it == pixel_index_.end() || it->pixel_id != pixel) {
+                    return nearest.threshold() * M_PI / 180.0;
+                }
+                for (uint32_t i = 0; i < it->num_chunks; ++i) {
+                    const uint64_t offset = it->chunk_list_offset + i;
+                    if (hasPixelSlices()) {
+                        if (offset >= pixel_slices_.size()) continue;
+                        const ChunkPixelInfo& slice = pixel_slices_[offset];
+                        auto chunk_data = getOrLoadChunk(slice.chunk_id, MappedFile::Advice::Random);
+                        if (!chunk_data) continue;
+                        offer(magnitudePrefix(chunk_data->records.subspan(slice.first_star_offset, slice.num_stars),
+                                              filter.max_magnitude));
+                    } else {
+                        if (offset >= chunk_lists_.size()) continue;
+                        const uint32_t chunk_id = chunk_lists_[offset];
+                        if (chunk_id >= scanned.size() || scanned[chunk_id]) continue;
+                        scanned[chunk_id] = true;
+                        auto chunk_data = getOrLoadChunk(chunk_id);
+                        if (chunk_data) offer(chunk_data->records);
+                    }
+                }
+                return nearest.threshold() * M_PI / 180.0;
+            });
+    } else {
+        // Sampled (non-NESTED) index: widen a cone until it holds k stars;
+        // the k closest within the radius are then the k closest overall
+        for (double radius = 0.25; ; radius *= 2.0) {
+            BrightestSelector<Mag18RecordV2> found(k);
+            forEachInCone(ra, dec, radius, filter, [&](const Mag18RecordV2& record) {
+                found.offer(angularDistance(ra, dec, record.ra, record.dec), record.source_id, record);
+                return true;
+            });
+            if (found.full() || radius >= 180.0) {
+                nearest = std::move(found);
+                break;
+            }
+        }
+    }
+    
+    std::vector<GaiaStar> results;
+    for (const auto& record : nearest.take()) {
+        results.push_back(recordToStar(record));
+    }
+    active_readers_--;
+    return results;
+}
+
+std::vector<std::vector<GaiaStar>> 
+ConcurrentMultiFileCatalogV2::queryConeBatch(const std::vector<QueryParams>& cones) {
+    active_readers_++;
+    const size_t num_cones = cones.size();
+    const size_t num_chunks = header_.total_chunks;
+    const bool sliced = hasPixelSlices();
+    std::vector<std::vector<GaiaStar>> results(num_cones);
+    
+    // Work unit: one cone against one chunk, or against one slice of it
+    struct ConeWork {
+        uint32_t cone;
+        uint32_t first_star_offset;
+        uint32_t num_stars;
+    };
+    
+    // 1. Plan every cone independently (pixel cover + chunk/slice lookup).
+    //    Whole-chunk scans also keep the cone's pixel cover for bucketing
+    const bool bucket_cones = !sliced && healpix::isValidNside(header_.healpix_nside);
+    std::vector<ConeBounds> bounds(num_cones);
+    std::vector<std::vector<healpix::PixelRange>> cone_pixels(bucket_cones ? num_cones : 0);
+    std::vector<std::vector<std::pair<uint32_t, ConeWork>>> planned(num_cones);
+    
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (long long i = 0; i < static_cast<long long>(num_cones); ++i) {
+        const auto& params = cones[i];
+        const uint32_t cone = static_cast<uint32_t>(i);
+        bounds[i] = makeConeBounds(params.ra_center, params.dec_center, params.radius,
+                                   params.starFilter());
+        if (bucket_cones) {
+            cone_pixels[i] = healpix::queryDisc(header_.healpix_nside, params.ra_center,
+                                                params.dec_center, params.radius);
+        }
+        
+        auto& work = planned[i];
+        if (sliced) {
+            for (const auto& slice : getSlicesForCone(params.ra_center, params.dec_center, params.radius)) {
+                work.push_back({slice.chunk_id, {cone, slice.first_star_offset, slice.num_stars}});
+            }
+        } else if (pixel_index_.empty()) {
+            for (uint32_t chunk_id = 0; chunk_id < num_chunks; ++chunk_id) {
+                work.push_back({chunk_id, {cone, 0, 0}});
+            }
+        } else {
+            for (uint32_t chunk_id : getChunksForCone(params.ra_center, params.dec_center, params.radius)) {
+                if (chunk_id < num_chunks) {
+                    work.push_back({chunk_id, {cone, 0, 0}});
+                }
+            }
+        }
+    }
+    
+    // 2. Invert into per-chunk work lists (counting sort by chunk; cones stay
+    //    in ascending order within a chunk)
+    std::vector<size_t> chunk_offsets(num_chunks + 1, 0);
+    for (const auto& work : planned) {
+        for (const auto& item : work) {
+            chunk_offsets[item.first + 1]++;
+        }
+    }
+    for (size_t c = 0; c < num_chunks; ++c) {
+        chunk_offsets[c + 1] += chunk_offsets[c];
+    }
+    std::vector<ConeWork> chunk_work(chunk_offsets[num_chunks]);
+    {
+        std::vector<size_t> cursor(chunk_offsets.begin(), chunk_offsets.end() - 1);
+        for (auto& work : planned) {
+            for (const auto& item : work) {
+                chunk_work[cursor[item.first]++] = item.second;
+            }
+            work = std::vector<std::pair<uint32_t, ConeWork>>();
+        }
+    }
+    
+    // 3. Split the chunks into tasks of bounded size so one crowded chunk
+    //    does not serialize the batch: runs of slice work items, or record
+    //    blocks of a whole chunk (each block scanned once for all its cones)
+    struct ScanTask {
+        uint32_t chunk_id;
+        size_t work_begin, work_end;        // Range in chunk_work
+        uint32_t record_begin, record_end;  // Record block (whole-chunk scans)
+        size_t cone_set;                    // Index in chunk_cones (whole-chunk scans)
+    };
+    constexpr uint32_t kStarsPerTask = 1u << 16;
+    const uint32_t stars_per_chunk = header_.stars_per_chunk > 0 ? header_.stars_per_chunk : 1000000;
+    
+    std::vector<ScanTask> tasks;
+    std::vector<uint32_t> scanned_chunks;  // Whole-chunk scans, one cone set each
+    for (uint32_t c = 0; c < num_chunks; ++c) {
+        const size_t begin = chunk_offsets[c];
+        const size_t end = chunk_offsets[c + 1];
+        if (begin == end) continue;
+        
+        if (sliced) {
+            size_t task_begin = begin;
+            uint64_t task_stars = 0;
+            for (size_t w = begin; w < end; ++w) {
+                task_stars += chunk_work[w].num_stars;
+                if (task_stars >= kStarsPerTask || w + 1 == end) {
+                    tasks.push_back({c, task_begin, w + 1, 0, 0, 0});
+                    task_begin = w + 1;
+                    task_stars = 0;
+                }
+            }
+        } else {
+            // The last chunk may be shorter: blocks are clamped after loading
+            for (uint32_t first = 0; first < stars_per_chunk; first += kStarsPerTask) {
+                uint32_t last = (stars_per_chunk - first > kStarsPerTask) ? first + kStarsPerTask : UINT32_MAX;
+                tasks.push_back({c, begin, end, first, last, scanned_chunks.size()});
+            }
+            scanned_chunks.push_back(c);
+        }
+    }
+    
+    // Bucket each scanned chunk's cones once, shared by all its record blocks
+    std::vector<ChunkCones> chunk_cones(scanned_chunks.size());
+    
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long long i = 0; i < static_cast<long long>(scanned_chunks.size()); ++i) {
+        const uint32_t c = scanned_chunks[i];
+        std::vector<uint32_t> cones_in_chunk;
+        cones_in_chunk.reserve(chunk_offsets[c + 1] - chunk_offsets[c]);
+        for (size_t w = chunk_offsets[c]; w < chunk_offsets[c + 1]; ++w) {
+            cones_in_chunk.push_back(chunk_work[w].cone);
+        }
+        chunk_cones[i] = makeChunkCones(std::move(cones_in_chunk), bounds, cone_pixels);
+    }
+    cone_pixels = std::vector<std::vector<healpix::PixelRange>>();
+    
+    // 4. Scan: hits keep a copy of the 84-byte record and are converted once
+    //    when gathered
+    std::vector<std::vector<std::pair<uint32_t, Mag18RecordV2>>> task_hits(tasks.size());
+    
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long long t = 0; t < static_cast<long long>(tasks.size()); ++t) {
+        const ScanTask& task = tasks[t];
+        auto chunk_data = getOrLoadChunk(task.chunk_id);
+        if (!chunk_data) continue;
+        
+        auto& hits = task_hits[t];
+        if (sliced) {
+            // Slices are already narrowed to each cone's pixels
+            for (size_t w = task.work_begin; w < task.work_end; ++w) {
+                const ConeWork& work = chunk_work[w];
+                const ConeBounds& cone = bounds[work.cone];
+                const RecordSpan slice = magnitudePrefix(
+                    chunk_data->records.subspan(work.first_star_offset, work.num_stars), cone.filter.max_magnitude);
+                for (const auto& record : slice) {
+                    if (cone.matches(record)) {
+                        hits.emplace_back(work.cone, record);
+                    }
+                }
+            }
+        } else {
+            if (task.record_begin >= chunk_data->records.size()) continue;
+            scanChunkForCones(chunk_data->records.subspan(task.record_begin, task.record_end - task.record_begin),
+                              bounds, chunk_cones[task.cone_set], hits);
+        }
+    }
+    
+    // 5. Gather in task order, which matches the per-cone queryCone order
+    for (auto& hits : task_hits) {
+        for (const auto& hit : hits) {
+            results[hit.first].push_back(recordToStar(hit.second));
+        }
+        hits = std::vector<std::pair<uint32_t, Mag18RecordV2>>();
+    }
+    
+    active_readers_--;
+    return results;
+}
+
+ConcurrentMultiFileCatalogV2::ChunkCones ConcurrentMultiFileCatalogV2::makeChunkCones(
+        std::vector<uint32_t> cones,
+        const std::vector<ConeBounds>& bounds,
+        const std::vector<std::vector<healpix::PixelRange>>& cone_pixels) {
+    ChunkCones chunk_cones;
+    chunk_cones.cones = std::move(cones);
+    
+    // A few cones: each record is tested against each of them
+    constexpr size_t kDirectScanCones = 8;
+    if (chunk_cones.cones.size() <= kDirectScanCones || cone_pixels.empty()) {
+        return chunk_cones;
+    }
+    
+    // Many cones: bucket them by the NESTED pixels they cover, so each
+    // record is tested only against the cones of its own pixel
+    for (uint32_t cone : chunk_cones.cones) {
+        chunk_cones.dec_min = std::min(chunk_cones.dec_min, bounds[cone].dec_min);
+        chunk_cones.dec_max = std::max(chunk_cones.dec_max, bounds[cone].dec_max);
+        for (const auto& range : cone_pixels[cone]) {
+            for (uint32_t pixel = range.begin; pixel < range.end; ++pixel) {
+                chunk_cones.cones_by_pixel[pixel].push_back(cone);
+            }
+        }
+    }
+    return chunk_cones;
+}
+
+void ConcurrentMultiFileCatalogV2::scanChunkForCones(
+        const RecordSpan& records,
+        const std::vector<ConeBounds>& bounds,
+        const ChunkCones& chunk_cones,
+        std::vector<std::pair<uint32_t, Mag18RecordV2>>& hits) const {
+    if (chunk_cones.cones_by_pixel.empty()) {
+        for (const auto& record : records) {
+            for (uint32_t cone : chunk_cones.cones) {
+                if (bounds[cone].matches(record)) {
+                    hits.emplace_back(cone, record);
                 }
             }
         }
+        return;
+    }
+    
+    const uint32_t nside = header_.healpix_nside;
+    for (const auto& record : records) {
+        if (record.dec < chunk_cones.dec_min || record.dec > chunk_cones.dec_max) continue;
+        
+        auto it = chunk_cones.cones_by_pixel.find(healpix::radec2pixNest(nside, record.ra, record.dec));
+        if (it == chunk_cones.cones_by_pixel.end()) continue;
+        
+        for (uint32_t cone : it->second) {
+            if (bounds[cone].matches(record)) {
+                hits.emplace_back(cone, record);
+            }
+        }
+    }
+}
+
+std::vector<GaiaStar> ConcurrentMultiFileCatalogV2::queryCorridor(const CorridorQueryParams& params) {
+    std::vector<GaiaStar> results;
+    if (!params.isValid()) {
+        return results;
+    }
+    active_readers_++;
+    
+    // Cover the tube with discs about one index pixel apart (or one width,
+    // for wide corridors) and union their pixel coverage
+    const double pixel_deg = healpix::isValidNside(header_.healpix_nside)
+        ? healpix::maxPixelRadius(header_.healpix_nside) * 180.0 / M_PI : 1.0;
+    const double step = std::max(params.width, pixel_deg);
+    const auto discs = corridor::coverDiscs(params.path, params.width, step);
+    
+    std::vector<healpix::PixelRange> ranges;
+    double dec_min = 90.0, dec_max = -90.0;
+    for (const auto& disc : discs) {
+        auto disc_ranges = getPixelsInCone(disc.ra, disc.dec, disc.radius);
+        ranges.insert(ranges.end(), disc_ranges.begin(), disc_ranges.end());
+        dec_min = std::min(dec_min, disc.dec - disc.radius);
+        dec_max = std::max(dec_max, disc.dec + disc.radius);
+    }
+    healpix::mergeRanges(ranges);
+    
+    // Cheap column tests first, then the corridor kernel on the survivors
+    const corridor::CorridorFilter filter(params.path, params.width);
+    const StarFilter columns = params.starFilter();
+    const bool filtered = columns.isActive();
+    auto records = collectRecords(ranges, columns.max_magnitude,
+                                  [&](const Mag18RecordV2* batch, size_t n, uint8_t* accept) {
+        std::vector<double> ra, dec;
+        std::vector<uint32_t> index;
+        ra.reserve(n);
+        dec.reserve(n);
+        index.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            const auto& record = batch[i];
+            accept[i] = 0;
+            if (filtered && !acceptsRecord(columns, record)) continue;
+            if (record.dec < dec_min || record.dec > dec_max) continue;
+            ra.push_back(record.ra);
+            dec.push_back(record.dec);
+            index.push_back(static_cast<uint32_t>(i));
+        }
+        std::vector<uint8_t> inside(index.size());
+        filter.containsBatch(ra.data(), dec.data(), index.size(), inside.data());
+        for (size_t k = 0; k < index.size(); ++k) {
+            accept[index[k]] = inside[k];
+        }
+    });
+    
+    size_t count = records.size();
+    if (params.max_results > 0) {
+        count = std::min(count, params.max_results);
+    }
+    results.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        results.push_back(recordToStar(records[i]));
     }
     
     active_readers_--;
     return results;
 }
 
+RecordSpan ConcurrentMultiFileCatalogV2::magnitudePrefix(const RecordSpan& slice,
+                                                         double max_magnitude) const {
+    if (!hasMagnitudeOrder() || !(max_magnitude < std::numeric_limits<double>::infinity())) {
+        return slice;
+    }
+    // Missing magnitudes sort first and pass any limit, like in StarFilter
+    auto cut = std::partition_point(slice.begin(), slice.end(), [&](const Mag18RecordV2& record) {
+        return std::isnan(record.g_mag) || record.g_mag <= max_magnitude;
+    });
+    return slice.subspan(0, static_cast<size_t>(cut - slice.begin()));
+}
+
+std::vector<Mag18RecordV2> ConcurrentMultiFileCatalogV2::collectRecords(
+        const std::vector<healpix::PixelRange>& ranges,
+        double max_magnitude,
+        const std::function<void(const Mag18RecordV2*, size_t, uint8_t*)>& accept) {
+    // One task per run of slices or per record block of a chunk; each
+    // chunk is fetched once per task and every record is visited once
+    struct ScanTask {
+        uint32_t chunk_id;
+        uint32_t record_begin, record_end;
+        size_t slice_begin, slice_end;  // Range in slices (pixel-sorted layout)
+    };
+    constexpr uint32_t kStarsPerTask = 1u << 16;
+    
+    std::vector<ScanTask> tasks;
+    std::vector<ChunkPixelInfo> slices;
+    if (hasPixelSlices()) {
+        slices = getSlicesForPixels(ranges);
+        size_t task_begin = 0;
+        uint64_t task_stars = 0;
+        for (size_t i = 0; i < slices.size(); ++i) {
+            task_stars += slices[i].num_stars;
+            if (task_stars >= kStarsPerTask || i + 1 == slices.size() ||
+                slices[i + 1].chunk_id != slices[i].chunk_id) {
+                tasks.push_back({slices[i].chunk_id, 0, 0, task_begin, i + 1});
+                task_begin = i + 1;
+                task_stars = 0;
+            }
+        }
+    } else {
+        std::vector<uint32_t> chunks;
+        if (pixel_index_.empty()) {
+            for (uint32_t chunk_id = 0; chunk_id < header_.total_chunks; ++chunk_id) {
+                chunks.push_back(chunk_id);
+            }
+        } else {
+            chunks = getChunksForPixels(ranges);
+        }
+        const uint32_t stars_per_chunk = header_.stars_per_chunk > 0 ? header_.stars_per_chunk : 1000000;
+        for (uint32_t chunk_id : chunks) {
+            if (chunk_id >= header_.total_chunks) continue;
+            for (uint32_t first = 0; first < stars_per_chunk; first += kStarsPerTask) {
+                uint32_t last = (stars_per_chunk - first > kStarsPerTask) ? first + kStarsPerTask : UINT32_MAX;
+                tasks.push_back({chunk_id, first, last, 0, 0});
+            }
+        }
+    }
+    
+    std::vector<std::vector<Mag18RecordV2>> task_hits(tasks.size());
+    
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long long t = 0; t < static_cast<long long>(tasks.size()); ++t) {
+        const ScanTask& task = tasks[t];
+        auto chunk_data = getOrLoadChunk(task.chunk_id);
+        if (!chunk_data) continue;
+        
+        auto& hits = task_hits[t];
+        std::vector<uint8_t> mask;
+        auto scan = [&](const RecordSpan& records) {
+            mask.resize(records.size());
+            accept(records.data(), records.size(), mask.data());
+            for (size_t i = 0; i < records.size(); ++i) {
+                if (mask[i]) {
+                    hits.push_back(records.data()[i]);
+                }
+            }
+        };
+        if (task.slice_end > task.slice_begin) {
+            for (size_t i = task.slice_begin; i < task.slice_end; ++i) {
+                scan(magnitudePrefix(chunk_data->records.subspan(slices[i].first_star_offset,
+                                                                 slices[i].num_stars),
+                                     max_magnitude));
+            }
+        } else if (task.record_begin < chunk_data->records.size()) {
+            scan(chunk_data->records.subspan(task.record_begin, task.record_end - task.record_begin));
+        }
+    }
+    
+    size_t total = 0;
+    for (const auto& hits : task_hits) {
+        total += hits.size();
+    }
+    std::vector<Mag18RecordV2> records;
+    records.reserve(total);
+    for (auto& hits : task_hits) {
+        records.insert(records.end(), hits.begin(), hits.end());
+        hits = std::vector<Mag18RecordV2>();
+    }
+    return records;
+}
+
 std::optional<GaiaStar> ConcurrentMultiFileCatalogV2::queryBySourceId(uint64_t source_id) {
     active_readers_++;
     
-    // Search all chunks (source_id is not indexed, so linear scan required)
+    if (hasSourceIndex()) {
+        auto result = lookupSourceIndex(source_id);
+        active_readers_--;
+        return result;
+    }
+    
+    // No sidecar index: linear scan over all chunks
     for (uint64_t chunk_id = 0; chunk_id < header_.total_chunks; ++chunk_id) {
         auto chunk_data = getOrLoadChunk(chunk_id);
         if (!chunk_data) continue;
         
-        std::shared_lock<std::shared_mutex> chunk_lock(chunk_data->access_mutex);
         const auto& chunk_records = chunk_data->records;
         
         // Binary search if records are sorted by source_id within chunk
@@ -268,38 +1266,22 @@ std::optional<GaiaStar> ConcurrentMultiFileCatalogV2::queryBySourceId(uint64_t s
     return std::nullopt;
 }
 
-void ConcurrentMultiFileCatalogV2::evictLRUChunks() {
-    // Remove 25% of cached chunks (LRU)
-    size_t to_remove = max_cached_chunks_ / 4;
-    if (to_remove == 0) to_remove = 1;
-    
-    std::vector<std::pair<std::chrono::steady_clock::time_point, uint64_t>> access_times;
-    access_times.reserve(chunk_cache_.size());
-    
-    for (const auto& [chunk_id, chunk_data] : chunk_cache_) {
-        access_times.emplace_back(chunk_data->last_access, chunk_id);
+uint32_t ConcurrentMultiFileCatalogV2::getHEALPixPixel(double ra, double dec) const {
+    if (hasNestedIndex()) {
+        return healpix::radec2pixNest(header_.healpix_nside, ra, dec);
     }
     
-    // Sort by access time (oldest first)
-    std::sort(access_times.begin(), access_times.end());
-    
-    // Remove oldest chunks
-    for (size_t i = 0; i < std::min(to_remove, access_times.size()); i++) {
-        chunk_cache_.erase(access_times[i].second);
-    }
-}
-
-// HEALPix implementation - must match the algorithm used in rebuild_healpix_index.cpp
-uint32_t ConcurrentMultiFileCatalogV2::getHEALPixPixel(double ra, double dec) const {
     double theta = (90.0 - dec) * M_PI / 180.0;  // Colatitude
     double phi = ra * M_PI / 180.0;               // Longitude
     // Normalize phi to [0, 2π)
     if (phi < 0) phi += 2 * M_PI;
     if (phi >= 2 * M_PI) phi -= 2 * M_PI;
-    return ang2pix_nest(theta, phi);
+    return legacy_ang2pix(theta, phi);
 }
 
-uint32_t ConcurrentMultiFileCatalogV2::ang2pix_nest(double theta, double phi) const {
+// Pixel function of metadata written before MAG18_FLAG_NESTED_INDEX; it is
+// not a true tessellation, so cones over such indices can only be sampled
+uint32_t ConcurrentMultiFileCatalogV2::legacy_ang2pix(double theta, double phi) const {
     const uint32_t nside = header_.healpix_nside;
     const double z = cos(theta);
     const double za = fabs(z);
@@ -341,7 +1323,16 @@ uint32_t ConcurrentMultiFileCatalogV2::ang2pix_nest(double theta, double phi) co
     }
 }
 
-std::vector<uint32_t> ConcurrentMultiFileCatalogV2::getPixelsInCone(double ra, double dec, double radius) const {
+std::vector<healpix::PixelRange> ConcurrentMultiFileCatalogV2::getPixelsInCone(double ra, double dec, double radius) const {
+    if (!hasNestedIndex()) {
+        return getLegacyPixelsInCone(ra, dec, radius);
+    }
+    
+    // Exact coverage: every pixel that intersects the cone, as sorted ranges
+    return healpix::queryDisc(header_.healpix_nside, ra, dec, radius);
+}
+
+std::vector<healpix::PixelRange> ConcurrentMultiFileCatalogV2::getLegacyPixelsInCone(double ra, double dec, double radius) const {
     std::vector<uint32_t> pixels;
     
     // Use smaller step for small radii
@@ -376,10 +1367,15 @@ std::vector<uint32_t> ConcurrentMultiFileCatalogV2::getPixelsInCone(double ra, d
     std::sort(pixels.begin(), pixels.end());
     pixels.erase(std::unique(pixels.begin(), pixels.end()), pixels.end());
     
-    return pixels;
+    std::vector<healpix::PixelRange> ranges;
+    ranges.reserve(pixels.size());
+    for (uint32_t pixel : pixels) {
+        ranges.push_back({pixel, pixel + 1});
+    }
+    return ranges;
 }
 
-double ConcurrentMultiFileCatalogV2::angularDistance(double ra1, double dec1, double ra2, double dec2) const {
+double ConcurrentMultiFileCatalogV2::angularDistance(double ra1, double dec1, double ra2, double dec2) {
     const double deg2rad = M_PI / 180.0;
     const double dra = (ra2 - ra1) * deg2rad;
     const double ddec = (dec2 - dec1) * deg2rad;
@@ -401,38 +1397,67 @@ GaiaStar ConcurrentMultiFileCatalogV2::recordToStar(const Mag18RecordV2& record)
     star.bp_rp = record.bp_rp;
     star.phot_bp_mean_mag = record.bp_mag;
     star.phot_rp_mean_mag = record.rp_mag;
+    star.ruwe = record.ruwe;
     return star;
 }
 
 ConcurrentMultiFileCatalogV2::ConcurrencyStats ConcurrentMultiFileCatalogV2::getStats() const {
-    std::shared_lock<std::shared_mutex> lock(cache_mutex_);
-    
-    size_t memory_used = 0;
-    for (const auto& [chunk_id, chunk_data] : chunk_cache_) {
-        memory_used += chunk_data->records.size() * sizeof(Mag18RecordV2);
+    size_t hits = 0, misses = 0, evictions = 0, chunks = 0, memory_used = 0;
+    for (const auto& shard : getShardStats()) {
+        hits += shard.hits;
+        misses += shard.misses;
+        evictions += shard.evictions;
+        chunks += shard.chunks;
+        memory_used += shard.bytes;
     }
     
-    size_t total_queries = cache_hits_.load() + cache_misses_.load();
-    double hit_rate = total_queries > 0 ? (cache_hits_.load() * 100.0) / total_queries : 0.0;
+    size_t total_queries = hits + misses;
+    double hit_rate = total_queries > 0 ? (hits * 100.0) / total_queries : 0.0;
     
     return {
-        cache_hits_.load(),
-        cache_misses_.load(),
-        chunk_cache_.size(),
+        hits,
+        misses,
+        chunks,
         memory_used / (1024 * 1024),  // Convert to MB
         active_readers_.load(),
-        hit_rate
+        hit_rate,
+        evictions
     };
 }
 
+std::vector<ConcurrentMultiFileCatalogV2::CacheShardStats> ConcurrentMultiFileCatalogV2::getShardStats() const {
+    std::vector<CacheShardStats> stats;
+    stats.reserve(num_shards_);
+    for (size_t i = 0; i < num_shards_; ++i) {
+        const CacheShard& shard = shards_[i];
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        stats.push_back({
+            shard.hits.load(std::memory_order_relaxed),
+            shard.misses.load(std::memory_order_relaxed),
+            shard.evictions.load(std::memory_order_relaxed),
+            shard.slots.size(),
+            shard.bytes,
+            shard.capacity_bytes
+        });
+    }
+    return stats;
+}
+
 void ConcurrentMultiFileCatalogV2::clearCache() {
-    std::unique_lock<std::shared_mutex> lock(cache_mutex_);
-    chunk_cache_.clear();
+    for (size_t i = 0; i < num_shards_; ++i) {
+        CacheShard& shard = shards_[i];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.slots.clear();
+        shard.ring.clear();
+        shard.free_slots.clear();
+        shard.hand = 0;
+        shard.bytes = 0;
+    }
 }
 
 void ConcurrentMultiFileCatalogV2::preloadChunks(const std::vector<uint64_t>& chunk_ids) {
     for (uint64_t chunk_id : chunk_ids) {
-        getOrLoadChunk(chunk_id);
+        getOrLoadChunk(chunk_id, MappedFile::Advice::WillNeed);
     }
 }
 
@@ -0,0 +1,495 @@
+#include "ioc_gaialib/corridor.h"
+#include "ioc_gaialib/healpix.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ioc::gaia::corridor {
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr double DEG_TO_RAD = PI / 180.0;
+
+healpix::Vec3 normalize(const healpix::Vec3& v) {
+    const double norm = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    if (norm < 1e-300) {
+        return {0.0, 0.0, 0.0};
+    }
+    return {v.x / norm, v.y / norm, v.z / norm};
+}
+
+healpix::Vec3 cross(const healpix::Vec3& a, const healpix::Vec3& b) {
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+CelestialPoint vecToRadec(const healpix::Vec3& v) {
+    double ra = std::atan2(v.y, v.x) / DEG_TO_RAD;
+    if (ra < 0.0) ra += 360.0;
+    double dec = std::asin(std::max(-1.0, std::min(1.0, v.z))) / DEG_TO_RAD;
+    return CelestialPoint(ra, dec);
+}
+
+struct OrbitSample {
+    double t;
+    CelestialPoint point;
+};
+
+CelestialPoint evaluateOrbit(const ChebyshevPolynomial& poly, double t) {
+    double ra = evaluateChebyshev(t, poly.t_start, poly.t_end, poly.coeffs_ra);
+    double dec = evaluateChebyshev(t, poly.t_start, poly.t_end, poly.coeffs_dec);
+    ra = std::fmod(ra, 360.0);
+    if (ra < 0.0) ra += 360.0;
+    return CelestialPoint(ra, dec);
+}
+
+double chordDeviation(const CelestialPoint& p, const CelestialPoint& a, const CelestialPoint& b) {
+    return pointToSegmentDistance(p.ra, p.dec, a.ra, a.dec, b.ra, b.dec);
+}
+
+// Append samples strictly inside (a, b) until every chord is within tolerance
+void refineOrbit(const ChebyshevPolynomial& poly, const OrbitSample& a, const OrbitSample& b,
+                 double tolerance, int depth, std::vector<OrbitSample>& out) {
+    constexpr int kMaxDepth = 30;
+    const double tm = 0.5 * (a.t + b.t);
+    const OrbitSample mid{tm, evaluateOrbit(poly, tm)};
+    if (depth < kMaxDepth) {
+        const CelestialPoint q1 = evaluateOrbit(poly, 0.5 * (a.t + tm));
+        const CelestialPoint q3 = evaluateOrbit(poly, 0.5 * (tm + b.t));
+        const double deviation = std::max({chordDeviation(q1, a.point, b.point),
+                                           chordDeviation(mid.point, a.point, b.point),
+                                           chordDeviation(q3, a.point, b.point)});
+        if (deviation > tolerance) {
+            refineOrbit(poly, a, mid, tolerance, depth + 1, out);
+            out.push_back(mid);
+            refineOrbit(poly, mid, b, tolerance, depth + 1, out);
+        }
+    }
+}
+
+} // namespace
+
+// Uses the cross-track distance formula
+double pointToSegmentDistance(double point_ra, double point_dec,
+                              double seg_start_ra, double seg_start_dec,
+                              double seg_end_ra, double seg_end_dec) {
+    // Convert to radians
+    double p_ra = point_ra * DEG_TO_RAD;
+    double p_dec = point_dec * DEG_TO_RAD;
+    double s_ra = seg_start_ra * DEG_TO_RAD;
+    double s_dec = seg_start_dec * DEG_TO_RAD;
+    double e_ra = seg_end_ra * DEG_TO_RAD;
+    double e_dec = seg_end_dec * DEG_TO_RAD;
+    
+    // Angular distance from start to point
+    double d_sp = std::acos(
+        std::sin(s_dec) * std::sin(p_dec) +
+        std::cos(s_dec) * std::cos(p_dec) * std::cos(p_ra - s_ra)
+    );
+    
+    // Angular distance from start to end
+    double d_se = std::acos(
+        std::sin(s_dec) * std::sin(e_dec) +
+        std::cos(s_dec) * std::cos(e_dec) * std::cos(e_ra - s_ra)
+    );
+    
+    // If segment has zero length, return distance to start point
+    if (d_se < 1e-10) {
+        return d_sp / DEG_TO_RAD;
+    }
+    
+    // Bearing from start to end
+    double theta_se = std::atan2(
+        std::sin(e_ra - s_ra) * std::cos(e_dec),
+        std::cos(s_dec) * std::sin(e_dec) - std::sin(s_dec) * std::cos(e_dec) * std::cos(e_ra - s_ra)
+    );
+    
+    // Bearing from start to point
+    double theta_sp = std::atan2(
+        std::sin(p_ra - s_ra) * std::cos(p_dec),
+        std::cos(s_dec) * std::sin(p_dec) - std::sin(s_dec) * std::cos(p_dec) * std::cos(p_ra - s_ra)
+    );
+    
+    // Cross-track distance (perpendicular distance to great circle)
+    double dxt = std::asin(std::sin(d_sp) * std::sin(theta_sp - theta_se));
+    
+    // Along-track distance (how far along the segment)
+    double dat = std::acos(std::cos(d_sp) / std::cos(dxt));
+    
+    // Check if the closest point is within the segment. dat is unsigned:
+    // test for "behind the start" first, or a point far behind the start
+    // would be measured against the end
+    if (dat < 0 || std::cos(theta_sp - theta_se) < 0) {
+        // Closest point is before the start - return distance to start
+        return d_sp / DEG_TO_RAD;
+    } else if (dat > d_se) {
+        // Closest point is past the end - return distance to end
+        double d_pe = std::acos(
+            std::sin(e_dec) * std::sin(p_dec) +
+            std::cos(e_dec) * std::cos(p_dec) * std::cos(p_ra - e_ra)
+        );
+        return d_pe / DEG_TO_RAD;
+    }
+    
+    // Return cross-track distance
+    return std::abs(dxt) / DEG_TO_RAD;
+}
+
+double pointToPolylineDistance(double ra, double dec,
+                               const std::vector<CelestialPoint>& path) {
+    double min_dist = std::numeric_limits<double>::max();
+    
+    for (size_t i = 0; i + 1 < path.size(); ++i) {
+        double dist = pointToSegmentDistance(
+            ra, dec,
+            path[i].ra, path[i].dec,
+            path[i+1].ra, path[i+1].dec
+        );
+        min_dist = std::min(min_dist, dist);
+    }
+    
+    return min_dist;
+}
+
+double evaluateChebyshev(double t, double t_start, double t_end,
+                         const std::vector<double>& coeffs) {
+    if (coeffs.empty()) return 0.0;
+    
+    // Handle singularity if t_start == t_end
+    if (std::abs(t_end - t_start) < 1e-9) return coeffs[0];
+    
+    // Normalize time to [-1, 1], clamping floating point overshoot at the ends
+    double u = 2.0 * (t - t_start) / (t_end - t_start) - 1.0;
+    u = std::max(-1.0, std::min(1.0, u));
+    
+    // Clenshaw recurrence: b_k = c_k + 2u b_{k+1} - b_{k+2}
+    double b1 = 0.0, b2 = 0.0;
+    for (size_t k = coeffs.size() - 1; k >= 1; --k) {
+        const double b0 = coeffs[k] + 2.0 * u * b1 - b2;
+        b2 = b1;
+        b1 = b0;
+    }
+    return coeffs[0] + u * b1 - b2;
+}
+
+std::vector<CelestialPoint> sampleOrbit(const std::vector<ChebyshevPolynomial>& polynomials,
+                                        double t_start, double t_end,
+                                        double tolerance, double max_step) {
+    std::vector<const ChebyshevPolynomial*> sorted;
+    sorted.reserve(polynomials.size());
+    for (const auto& poly : polynomials) {
+        sorted.push_back(&poly);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+        [](const ChebyshevPolynomial* a, const ChebyshevPolynomial* b) {
+            return a->t_start < b->t_start;
+        });
+    
+    // Dense samples: every chord within tolerance / 2 of the orbit. The
+    // sorted pieces are walked once, so no per-sample polynomial lookup
+    const double half_tolerance = 0.5 * tolerance;
+    std::vector<OrbitSample> samples;
+    double covered = t_start;
+    bool first_piece = true;
+    for (const ChebyshevPolynomial* poly : sorted) {
+        const double begin = first_piece ? std::max(t_start, poly->t_start)
+                                         : std::max(covered, poly->t_start);
+        const double end = std::min(t_end, poly->t_end);
+        if (end < begin || (!first_piece && end <= begin)) continue;
+        if (end == begin) {
+            samples.push_back({begin, evaluateOrbit(*poly, begin)});
+            first_piece = false;
+            continue;
+        }
+        
+        // Start from at least one interval per coefficient so probing at
+        // quarter points cannot miss a wiggle of the series
+        const size_t degree = std::max(poly->coeffs_ra.size(), poly->coeffs_dec.size());
+        int intervals = static_cast<int>(std::max<size_t>(4, degree));
+        if (max_step > 0.0) {
+            intervals = std::max(intervals, static_cast<int>(std::ceil((end - begin) / max_step)));
+        }
+        OrbitSample prev{begin, evaluateOrbit(*poly, begin)};
+        samples.push_back(prev);
+        for (int i = 1; i <= intervals; ++i) {
+            const double t = (i == intervals) ? end
+                : begin + (end - begin) * static_cast<double>(i) / intervals;
+            const OrbitSample next{t, evaluateOrbit(*poly, t)};
+            if (next.t > prev.t) {
+                refineOrbit(*poly, prev, next, half_tolerance, 0, samples);
+                samples.push_back(next);
+            }
+            prev = next;
+        }
+        covered = end;
+        first_piece = false;
+    }
+    
+    // Greedy simplification: extend each chord while the skipped samples
+    // stay within tolerance / 2 of it and it spans at most max_step (window
+    // bounded to keep this linear)
+    constexpr size_t kMaxWindow = 256;
+    const double max_span = max_step > 0.0 ? max_step * (1.0 + 1e-9) : std::numeric_limits<double>::infinity();
+    std::vector<CelestialPoint> path;
+    if (samples.empty()) {
+        return path;
+    }
+    path.push_back(samples[0].point);
+    size_t anchor = 0;
+    while (anchor + 1 < samples.size()) {
+        size_t best = anchor + 1;
+        for (size_t j = anchor + 2; j < samples.size() && j - anchor <= kMaxWindow; ++j) {
+            if (samples[j].t - samples[anchor].t > max_span) break;
+            bool fits = true;
+            for (size_t k = anchor + 1; k < j && fits; ++k) {
+                fits = chordDeviation(samples[k].point, samples[anchor].point, samples[j].point) <= half_tolerance;
+            }
+            if (!fits) break;
+            best = j;
+        }
+        path.push_back(samples[best].point);
+        anchor = best;
+    }
+    
+    // Drop exact duplicates (zero-length pieces)
+    path.erase(std::unique(path.begin(), path.end(),
+        [](const CelestialPoint& a, const CelestialPoint& b) {
+            return a.ra == b.ra && a.dec == b.dec;
+        }), path.end());
+    return path;
+}
+
+std::vector<Disc> coverDiscs(const std::vector<CelestialPoint>& path,
+                             double width, double step) {
+    std::vector<Disc> discs;
+    if (path.empty() || !(step > 0.0)) {
+        return discs;
+    }
+    
+    const double radius = width + 0.5 * step;
+    discs.push_back({path[0].ra, path[0].dec, radius});
+    
+    for (size_t i = 0; i + 1 < path.size(); ++i) {
+        const healpix::Vec3 a = healpix::radecToVec(path[i].ra, path[i].dec);
+        const healpix::Vec3 b = healpix::radecToVec(path[i+1].ra, path[i+1].dec);
+        const double omega = healpix::angleBetween(a, b);
+        const int steps = std::max(1, static_cast<int>(std::ceil(omega / DEG_TO_RAD / step)));
+        
+        // Spherical interpolation between the endpoints (the segment is the
+        // shorter great-circle arc, as in pointToSegmentDistance)
+        const double sin_omega = std::sin(omega);
+        for (int k = 1; k <= steps; ++k) {
+            if (k == steps || sin_omega < 1e-12) {
+                discs.push_back({path[i+1].ra, path[i+1].dec, radius});
+                break;
+            }
+            const double t = static_cast<double>(k) / steps;
+            const double wa = std::sin((1.0 - t) * omega) / sin_omega;
+            const double wb = std::sin(t * omega) / sin_omega;
+            const CelestialPoint p = vecToRadec({wa * a.x + wb * b.x,
+                                                 wa * a.y + wb * b.y,
+                                                 wa * a.z + wb * b.z});
+            discs.push_back({p.ra, p.dec, radius});
+        }
+    }
+    return discs;
+}
+
+CorridorFilter::CorridorFilter(const std::vector<CelestialPoint>& path, double width)
+    : width_rad_(std::max(0.0, width) * DEG_TO_RAD) {
+    // Cross-track distances never exceed 90 degrees
+    const double sin_width = width_rad_ >= 0.5 * PI ? 1.0 : std::sin(width_rad_);
+    sin2_width_ = sin_width * sin_width;
+    chord2_width_ = 2.0 - 2.0 * std::cos(std::min(width_rad_, PI));
+    
+    // A single waypoint is a degenerate segment (a disc around it)
+    num_segments_ = path.size() >= 2 ? path.size() - 1 : path.size();
+    for (auto* v : {&ax_, &ay_, &az_, &bx_, &by_, &bz_, &nx_, &ny_, &nz_,
+                    &tax_, &tay_, &taz_, &tbx_, &tby_, &tbz_}) {
+        v->resize(num_segments_);
+    }
+    
+    for (size_t s = 0; s < num_segments_; ++s) {
+        const CelestialPoint& p0 = path[s];
+        const CelestialPoint& p1 = path.size() >= 2 ? path[s + 1] : path[s];
+        const healpix::Vec3 a = healpix::radecToVec(p0.ra, p0.dec);
+        const healpix::Vec3 b = healpix::radecToVec(p1.ra, p1.dec);
+        
+        ax_[s] = a.x; ay_[s] = a.y; az_[s] = a.z;
+        bx_[s] = b.x; by_[s] = b.y; bz_[s] = b.z;
+        
+        // Zero normal and tangents leave only the endpoint tests, as for a
+        // zero-length segment in pointToSegmentDistance
+        const healpix::Vec3 axb = cross(a, b);
+        const double axb_norm = std::sqrt(axb.x * axb.x + axb.y * axb.y + axb.z * axb.z);
+        healpix::Vec3 n{0.0, 0.0, 0.0}, ta{0.0, 0.0, 0.0}, tb{0.0, 0.0, 0.0};
+        if (axb_norm > 1e-12) {
+            n = {axb.x / axb_norm, axb.y / axb_norm, axb.z / axb_norm};
+            ta = cross(n, a);
+            tb = cross(b, n);
+        }
+        nx_[s] = n.x; ny_[s] = n.y; nz_[s] = n.z;
+        tax_[s] = ta.x; tay_[s] = ta.y; taz_[s] = ta.z;
+        tbx_[s] = tb.x; tby_[s] = tb.y; tbz_[s] = tb.z;
+    }
+    
+    if (num_segments_ > 0) {
+        caps_.reserve(2 * num_segments_);
+        buildCaps(0, static_cast<uint32_t>(num_segments_));
+    }
+}
+
+int32_t CorridorFilter::buildCaps(uint32_t first, uint32_t last) {
+    const int32_t index = static_cast<int32_t>(caps_.size());
+    caps_.push_back({});
+    
+    Cap cap;
+    cap.first = first;
+    cap.last = last;
+    cap.left = cap.right = -1;
+    
+    if (last - first == 1) {
+        // Leaf: cap around the arc, widened by the corridor
+        const healpix::Vec3 a{ax_[first], ay_[first], az_[first]};
+        const healpix::Vec3 b{bx_[first], by_[first], bz_[first]};
+        cap.center = normalize({a.x + b.x, a.y + b.y, a.z + b.z});
+        if (cap.center.x == 0.0 && cap.center.y == 0.0 && cap.center.z == 0.0) {
+            cap.center = a;
+            cap.radius = PI;  // Antipodal endpoints: no useful bound
+        } else {
+            cap.radius = 0.5 * healpix::angleBetween(a, b) + width_rad_;
+        }
+    } else {
+        const uint32_t mid = first + (last - first) / 2;
+        cap.left = buildCaps(first, mid);
+        cap.right = buildCaps(mid, last);
+        const Cap& l = caps_[cap.left];
+        const Cap& r = caps_[cap.right];
+        cap.center = normalize({l.center.x + r.center.x, l.center.y + r.center.y, l.center.z + r.center.z});
+        if (cap.center.x == 0.0 && cap.center.y == 0.0 && cap.center.z == 0.0) {
+            cap.center = l.center;
+            cap.radius = PI;
+        } else {
+            cap.radius = std::min(PI, std::max(healpix::angleBetween(cap.center, l.center) + l.radius,
+                                               healpix::angleBetween(cap.center, r.center) + r.radius));
+        }
+    }
+    
+    caps_[index] = cap;
+    return index;
+}
+
+void CorridorFilter::candidateSegments(const healpix::Vec3& center, double radius,
+                                       std::vector<uint32_t>& segments) const {
+    segments.clear();
+    if (caps_.empty()) {
+        return;
+    }
+    
+    int32_t stack[64];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const Cap& cap = caps_[stack[--depth]];
+        if (cap.radius < PI && radius < PI &&
+            healpix::angleBetween(cap.center, center) > cap.radius + radius) {
+            continue;
+        }
+        if (cap.left < 0) {
+            segments.push_back(cap.first);
+        } else {
+            // Right first so segments come out in path order
+            stack[depth++] = cap.right;
+            stack[depth++] = cap.left;
+        }
+    }
+}
+
+void CorridorFilter::markSegment(size_t s, const double* x, const double* y, const double* z,
+                                 size_t n, uint8_t* inside) const {
+    const double ax = ax_[s], ay = ay_[s], az = az_[s];
+    const double bx = bx_[s], by = by_[s], bz = bz_[s];
+    const double nx = nx_[s], ny = ny_[s], nz = nz_[s];
+    const double tax = tax_[s], tay = tay_[s], taz = taz_[s];
+    const double tbx = tbx_[s], tby = tby_[s], tbz = tbz_[s];
+    const bool has_arc = (nx != 0.0 || ny != 0.0 || nz != 0.0);
+    const double sin2_width = sin2_width_;
+    const double chord2_width = chord2_width_;
+    
+    #pragma omp simd
+    for (size_t i = 0; i < n; ++i) {
+        const double px = x[i], py = y[i], pz = z[i];
+        
+        // Endpoint discs (squared chord)
+        const double dax = px - ax, day = py - ay, daz = pz - az;
+        const double dbx = px - bx, dby = py - by, dbz = pz - bz;
+        const bool near_a = dax * dax + day * day + daz * daz <= chord2_width;
+        const bool near_b = dbx * dbx + dby * dby + dbz * dbz <= chord2_width;
+        
+        // Cross-track band, restricted to the arc's lune
+        const double pn = px * nx + py * ny + pz * nz;
+        const bool in_lune = has_arc &&
+                             (px * tax + py * tay + pz * taz) >= 0.0 &&
+                             (px * tbx + py * tby + pz * tbz) >= 0.0;
+        const bool near_arc = in_lune && pn * pn <= sin2_width;
+        
+        inside[i] |= static_cast<uint8_t>(near_a | near_b | near_arc);
+    }
+}
+
+bool CorridorFilter::contains(double ra, double dec) const {
+    uint8_t inside = 0;
+    containsBatch(&ra, &dec, 1, &inside);
+    return inside != 0;
+}
+
+void CorridorFilter::containsBatch(const double* ra, const double* dec, size_t n, uint8_t* inside) const {
+    alignas(64) double x[kBlockSize];
+    alignas(64) double y[kBlockSize];
+    alignas(64) double z[kBlockSize];
+    std::vector<uint32_t> segments;
+    segments.reserve(num_segments_);
+    
+    for (size_t start = 0; start < n; start += kBlockSize) {
+        const size_t count = std::min(kBlockSize, n - start);
+        const double* block_ra = ra + start;
+        const double* block_dec = dec + start;
+        uint8_t* block_inside = inside + start;
+        
+        // Unit vectors for the block
+        double sx = 0.0, sy = 0.0, sz = 0.0;
+        #pragma omp simd reduction(+:sx, sy, sz)
+        for (size_t i = 0; i < count; ++i) {
+            const double r = block_ra[i] * DEG_TO_RAD;
+            const double d = block_dec[i] * DEG_TO_RAD;
+            const double cd = std::cos(d);
+            x[i] = cd * std::cos(r);
+            y[i] = cd * std::sin(r);
+            z[i] = std::sin(d);
+            block_inside[i] = 0;
+            sx += x[i];
+            sy += y[i];
+            sz += z[i];
+        }
+        
+        // Bounding cap of the block: centroid direction and widest member
+        const healpix::Vec3 center = normalize({sx, sy, sz});
+        double radius = PI;
+        if (center.x != 0.0 || center.y != 0.0 || center.z != 0.0) {
+            double min_dot = 1.0;
+            #pragma omp simd reduction(min:min_dot)
+            for (size_t i = 0; i < count; ++i) {
+                const double dot = x[i] * center.x + y[i] * center.y + z[i] * center.z;
+                min_dot = std::min(min_dot, dot);
+            }
+            radius = std::acos(std::max(-1.0, std::min(1.0, min_dot))) + 1e-9;
+        }
+        
+        candidateSegments(center, radius, segments);
+        for (uint32_t s : segments) {
+            markSegment(s, x, y, z, count, block_inside);
+        }
+    }
+}
+
+} // namespace ioc::gaia::corridor
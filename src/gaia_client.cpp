@@ -1,51 +1,14 @@
 #include "ioc_gaialib/gaia_client.h"
+#include "ioc_gaialib/http_transport.h"
 #include <sstream>
 #include <iomanip>
 #include <chrono>
-#include <thread>
 #include <cmath>
 #include <algorithm>
-#include <curl/curl.h>
 
 namespace ioc {
 namespace gaia {
 
-// =============================================================================
-// Rate Limiter - Simple token bucket implementation
-// =============================================================================
-
-class RateLimiter {
-public:
-    explicit RateLimiter(int queries_per_minute)
-        : queries_per_minute_(queries_per_minute),
-          last_query_time_(std::chrono::steady_clock::now()) {}
-    
-    void waitIfNeeded() {
-        if (queries_per_minute_ <= 0) return;  // No limit
-        
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-            now - last_query_time_).count();
-        
-        int min_interval_ms = 60000 / queries_per_minute_;
-        
-        if (elapsed < min_interval_ms) {
-            std::this_thread::sleep_for(
-                std::chrono::milliseconds(min_interval_ms - elapsed));
-        }
-        
-        last_query_time_ = std::chrono::steady_clock::now();
-    }
-    
-    void setRate(int queries_per_minute) {
-        queries_per_minute_ = queries_per_minute;
-    }
-
-private:
-    int queries_per_minute_;
-    std::chrono::steady_clock::time_point last_query_time_;
-};
-
 // =============================================================================
 // Query Builder - Generate ADQL queries
 // =============================================================================
@@ -123,60 +86,6 @@ private:
     GaiaRelease release_;
 };
 
-// =============================================================================
-// CURL Helper Functions
-// =============================================================================
-
-namespace {
-
-size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-    ((std::string*)userp)->append((char*)contents, size * nmemb);
-    return size * nmemb;
-}
-
-std::string curlPost(const std::string& url, const std::string& data) {
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        throw GaiaException(ErrorCode::NETWORK_ERROR, "Failed to initialize CURL");
-    }
-    
-    std::string response;
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
-    
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 60L);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    
-    CURLcode res = curl_easy_perform(curl);
-    
-    if (res != CURLE_OK) {
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
-        throw GaiaException(ErrorCode::NETWORK_ERROR, 
-                          std::string("CURL error: ") + curl_easy_strerror(res));
-    }
-    
-    long http_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-    
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-    
-    if (http_code != 200) {
-        throw GaiaException(ErrorCode::NETWORK_ERROR, 
-                          "HTTP error " + std::to_string(http_code));
-    }
-    
-    return response;
-}
-
-} // anonymous namespace
-
 // =============================================================================
 // CSV Parser for VOTable/CSV responses
 // =============================================================================
@@ -249,7 +158,7 @@ private:
 class GaiaClient::Impl {
 public:
     GaiaRelease release_;
-    std::unique_ptr<RateLimiter> rate_limiter_;
+    std::shared_ptr<RateLimiter> rate_limiter_;  // Shared by every thread using this client
     std::unique_ptr<QueryBuilder> query_builder_;
     int timeout_seconds_;
     int max_retries_;
@@ -257,7 +166,7 @@ public:
     
     explicit Impl(GaiaRelease release)
         : release_(release),
-          rate_limiter_(std::make_unique<RateLimiter>(10)),  // 10 queries/min default
+          rate_limiter_(std::make_shared<RateLimiter>(10)),  // 10 queries/min default
           query_builder_(std::make_unique<QueryBuilder>(release)),
           timeout_seconds_(60),
           max_retries_(3) {
@@ -266,33 +175,29 @@ public:
         tap_url_ = "https://gea.esac.esa.int/tap-server/tap/sync";
     }
     
-    std::vector<GaiaStar> executeQuery(const std::string& adql, int retry_count = 0) {
-        try {
-            // Rate limiting
-            rate_limiter_->waitIfNeeded();
-            
-            // Prepare POST data
-            std::ostringstream post_data;
-            post_data << "REQUEST=doQuery&LANG=ADQL&FORMAT=csv&QUERY=";
-            
-            // URL-encode the query (simplified)
-            std::string encoded_query = urlEncode(adql);
-            post_data << encoded_query;
-            
-            // Execute HTTP POST
-            std::string response = curlPost(tap_url_, post_data.str());
-            
-            // Parse CSV response
-            return CSVParser::parseCSV(response);
-            
-        } catch (const GaiaException& e) {
-            // Retry on network errors
-            if (e.code() == ErrorCode::NETWORK_ERROR && retry_count < max_retries_) {
-                std::this_thread::sleep_for(std::chrono::seconds(2 * (retry_count + 1)));
-                return executeQuery(adql, retry_count + 1);
+    std::future<std::vector<GaiaStar>> submitQuery(const std::string& adql) {
+        HttpRequest request;
+        request.url = tap_url_;
+        request.body = "REQUEST=doQuery&LANG=ADQL&FORMAT=csv&QUERY=" + urlEncode(adql);
+        request.headers = {"Content-Type: application/x-www-form-urlencoded"};
+        request.timeout_seconds = timeout_seconds_;
+        request.max_retries = max_retries_;
+        request.rate_limiter = rate_limiter_;
+        
+        // Rate limiting and retries run in the transport; parsing runs on get()
+        auto response = HttpTransport::instance().submit(std::move(request));
+        return std::async(std::launch::deferred, [response = std::move(response)]() mutable {
+            HttpResponse result = response.get();
+            if (result.status != 200) {
+                throw GaiaException(ErrorCode::NETWORK_ERROR,
+                                    "HTTP error " + std::to_string(result.status));
             }
-            throw;
-        }
+            return CSVParser::parseCSV(result.body);
+        });
+    }
+    
+    std::vector<GaiaStar> executeQuery(const std::string& adql) {
+        return submitQuery(adql).get();
     }
     
     static std::string urlEncode(const std::string& str) {
@@ -320,12 +225,6 @@ public:
 
 GaiaClient::GaiaClient(GaiaRelease release)
     : pImpl_(std::make_unique<Impl>(release)) {
-    // Initialize CURL globally
-    static bool curl_initialized = false;
-    if (!curl_initialized) {
-        curl_global_init(CURL_GLOBAL_DEFAULT);
-        curl_initialized = true;
-    }
 }
 
 GaiaClient::~GaiaClient() = default;
@@ -345,6 +244,18 @@ std::vector<GaiaStar> GaiaClient::queryCone(
     return pImpl_->executeQuery(adql);
 }
 
+std::future<std::vector<GaiaStar>> GaiaClient::queryConeAsync(
+    double ra_center, 
+    double dec_center, 
+    double radius, 
+    double max_magnitude) {
+    
+    std::string adql = pImpl_->query_builder_->buildConeQuery(
+        ra_center, dec_center, radius, max_magnitude);
+    
+    return pImpl_->submitQuery(adql);
+}
+
 std::vector<GaiaStar> GaiaClient::queryBox(
     double ra_min,
     double ra_max,
@@ -362,6 +273,10 @@ std::vector<GaiaStar> GaiaClient::queryADQL(const std::string& adql) {
     return pImpl_->executeQuery(adql);
 }
 
+std::future<std::vector<GaiaStar>> GaiaClient::queryADQLAsync(const std::string& adql) {
+    return pImpl_->submitQuery(adql);
+}
+
 std::vector<GaiaStar> GaiaClient::queryBySourceIds(
     const std::vector<int64_t>& source_ids) {
     
@@ -403,6 +318,10 @@ void GaiaClient::setMaxRetries(int max_retries) {
     pImpl_->max_retries_ = max_retries;
 }
 
+void GaiaClient::setTapUrl(const std::string& url) {
+    pImpl_->tap_url_ = url;
+}
+
 std::string GaiaClient::getTapUrl() const {
     return pImpl_->tap_url_;
 }
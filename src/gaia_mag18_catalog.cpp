@@ -1,4 +1,5 @@
 #include "ioc_gaialib/gaia_mag18_catalog.h"
+#include "ioc_gaialib/brightest_selector.h"
 #include <cmath>
 #include <algorithm>
 #include <filesystem>
@@ -248,23 +249,37 @@ std::vector<ioc::gaia::GaiaStar> GaiaMag18Catalog::queryConeWithMagnitude(
 std::vector<ioc::gaia::GaiaStar> GaiaMag18Catalog::queryBrightest(double ra, double dec,
                                                                    double radius,
                                                                    size_t n_brightest) const {
-    // Get all stars in cone
-    auto all_stars = queryCone(ra, dec, radius, 0);
-    
-    // Sort by magnitude
-    std::partial_sort(all_stars.begin(),
-                     all_stars.begin() + std::min(n_brightest, all_stars.size()),
-                     all_stars.end(),
-                     [](const ioc::gaia::GaiaStar& a, const ioc::gaia::GaiaStar& b) {
-                         return a.phot_g_mean_mag < b.phot_g_mean_mag;
-                     });
-    
-    // Return only N brightest
-    if (all_stars.size() > n_brightest) {
-        all_stars.resize(n_brightest);
+    std::vector<ioc::gaia::GaiaStar> results;
+    
+    if (!loaded_ || n_brightest == 0) {
+        return results;
     }
     
-    return all_stars;
+    // Keep only the N brightest raw records while scanning
+    ioc::gaia::BrightestSelector<Mag18Record> best(n_brightest);
+    
+    for (uint64_t i = 0; i < header_.total_stars; ++i) {
+        auto record = readRecord(i);
+        if (!record) {
+            continue;
+        }
+        
+        // Check magnitude first (cheaper than the distance)
+        if (best.excludes(record->g_mag)) {
+            continue;
+        }
+        
+        double dist = angularDistance(ra, dec, record->ra, record->dec);
+        if (dist <= radius) {
+            best.offer(record->g_mag, record->source_id, *record);
+        }
+    }
+    
+    for (const auto& record : best.take()) {
+        results.push_back(recordToStar(record));
+    }
+    
+    return results;
 }
 
 size_t GaiaMag18Catalog::countInCone(double ra, double dec, double radius) const {
@@ -1,4 +1,6 @@
 #include "ioc_gaialib/gaia_mag18_catalog_v2.h"
+#include "ioc_gaialib/healpix.h"
+#include "ioc_gaialib/brightest_selector.h"
 #include <cmath>
 #include <algorithm>
 #include <cstring>
@@ -9,16 +11,13 @@
 namespace ioc {
 namespace gaia {
 
-// HEALPix constants
+// Angle constants
 static constexpr double PI = 3.14159265358979323846;
-static constexpr double TWOPI = 2.0 * PI;
-static constexpr double HALFPI = 0.5 * PI;
 static constexpr double DEG2RAD = PI / 180.0;
 static constexpr double RAD2DEG = 180.0 / PI;
 
 Mag18CatalogV2::Mag18CatalogV2() 
-    : file_(nullptr), 
-      enable_parallel_(true),
+    : enable_parallel_(true),
       num_threads_(omp_get_max_threads()) {
     chunk_cache_.reserve(MAX_CACHED_CHUNKS);
     if (num_threads_ == 0) num_threads_ = 4;  // Fallback
@@ -49,27 +48,13 @@ void Mag18CatalogV2::setParallelProcessing(bool enable, size_t num_threads) {
 bool Mag18CatalogV2::open(const std::string& catalog_path) {
     catalog_path_ = catalog_path;
     
-    file_ = fopen(catalog_path.c_str(), "rb");
-    if (!file_) {
+    if (!file_.open(catalog_path)) {
         std::cerr << "Failed to open catalog: " << catalog_path << std::endl;
         return false;
     }
     
-    if (!loadHeader()) {
-        fclose(file_);
-        file_ = nullptr;
-        return false;
-    }
-    
-    if (!loadHEALPixIndex()) {
-        fclose(file_);
-        file_ = nullptr;
-        return false;
-    }
-    
-    if (!loadChunkIndex()) {
-        fclose(file_);
-        file_ = nullptr;
+    if (!loadHeader() || !loadHEALPixIndex() || !loadChunkIndex()) {
+        file_.close();
         return false;
     }
     
@@ -83,20 +68,19 @@ bool Mag18CatalogV2::open(const std::string& catalog_path) {
 }
 
 void Mag18CatalogV2::close() {
-    if (file_) {
-        fclose(file_);
-        file_ = nullptr;
-    }
+    file_.close();
     healpix_index_.clear();
     chunk_index_.clear();
+    std::unique_lock<std::shared_mutex> lock(cache_mutex_);
     chunk_cache_.clear();
 }
 
 bool Mag18CatalogV2::loadHeader() {
-    if (fread(&header_, sizeof(Mag18CatalogHeaderV2), 1, file_) != 1) {
+    if (file_.size() < sizeof(Mag18CatalogHeaderV2)) {
         std::cerr << "Failed to read catalog header\n";
         return false;
     }
+    std::memcpy(&header_, file_.data(), sizeof(Mag18CatalogHeaderV2));
     
     if (strncmp(header_.magic, "GAIA18V2", 8) != 0) {
         std::cerr << "Invalid catalog magic. Expected GAIA18V2\n";
@@ -108,6 +92,16 @@ bool Mag18CatalogV2::loadHeader() {
         return false;
     }
     
+    if (!healpix::isValidNside(header_.healpix_nside)) {
+        std::cerr << "Unsupported HEALPix NSIDE: " << header_.healpix_nside << "\n";
+        return false;
+    }
+    
+    if (header_.stars_per_chunk == 0) {
+        std::cerr << "Invalid stars per chunk: 0\n";
+        return false;
+    }
+    
     return true;
 }
 
@@ -117,19 +111,16 @@ bool Mag18CatalogV2::loadHEALPixIndex() {
         return false;
     }
     
-    healpix_index_.resize(header_.num_healpix_pixels);
-    
-    if (fseek(file_, header_.healpix_index_offset, SEEK_SET) != 0) {
-        std::cerr << "Failed to seek to HEALPix index\n";
-        return false;
-    }
-    
-    if (fread(healpix_index_.data(), sizeof(HEALPixIndexEntry), 
-              header_.num_healpix_pixels, file_) != header_.num_healpix_pixels) {
+    const uint64_t bytes = uint64_t(header_.num_healpix_pixels) * sizeof(HEALPixIndexEntry);
+    if (header_.healpix_index_offset > file_.size() ||
+        bytes > file_.size() - header_.healpix_index_offset) {
         std::cerr << "Failed to read HEALPix index\n";
         return false;
     }
     
+    healpix_index_.resize(header_.num_healpix_pixels);
+    std::memcpy(healpix_index_.data(), file_.data() + header_.healpix_index_offset, bytes);
+    
     return true;
 }
 
@@ -139,65 +130,22 @@ bool Mag18CatalogV2::loadChunkIndex() {
         return false;
     }
     
-    chunk_index_.resize(header_.total_chunks);
-    
-    if (fseek(file_, header_.chunk_index_offset, SEEK_SET) != 0) {
-        std::cerr << "Failed to seek to chunk index\n";
-        return false;
-    }
-    
-    if (fread(chunk_index_.data(), sizeof(ChunkInfo), 
-              header_.total_chunks, file_) != header_.total_chunks) {
+    const uint64_t bytes = header_.total_chunks * sizeof(ChunkInfo);
+    if (header_.chunk_index_offset > file_.size() ||
+        bytes > file_.size() - header_.chunk_index_offset) {
         std::cerr << "Failed to read chunk index\n";
         return false;
     }
     
+    chunk_index_.resize(header_.total_chunks);
+    std::memcpy(chunk_index_.data(), file_.data() + header_.chunk_index_offset, bytes);
+    
     return true;
 }
 
 uint32_t Mag18CatalogV2::ang2pix_nest(double theta, double phi) const {
-    // Simplified HEALPix ang2pix_nest for NSIDE=64
-    // theta: colatitude [0, pi], phi: longitude [0, 2*pi]
-    
-    const uint32_t nside = header_.healpix_nside;
-    const uint32_t nl2 = 2 * nside;
-    const uint32_t nl4 = 4 * nside;
-    const double z = cos(theta);
-    const double za = fabs(z);
-    
-    // Equatorial region
-    if (za <= 2.0/3.0) {
-        const double temp1 = nside * (0.5 + phi / TWOPI);
-        const double temp2 = nside * z * 0.75;
-        const uint32_t jp = static_cast<uint32_t>(temp1 - temp2);
-        const uint32_t jm = static_cast<uint32_t>(temp1 + temp2);
-        const uint32_t ir = nside + 1 + jp - jm;
-        const uint32_t kshift = 1 - (ir & 1);
-        const uint32_t ip = (jp + jm - nside + kshift + 1) / 2;
-        
-        const uint32_t face_num = ((jp < nside) ? 0 : 
-                                   (jm < nside) ? 2 : 
-                                   (jp >= nl2) ? 4 : 
-                                   (jm >= nl2) ? 6 : 8) + (ir - nside);
-        
-        return face_num * nside * nside + (ip * nside + (ir - nside + 1));
-    }
-    
-    // Polar caps
-    const uint32_t ntt = static_cast<uint32_t>(phi * 4.0 / TWOPI);
-    const double tp = phi - ntt * TWOPI / 4.0;
-    const double tmp = sqrt(3.0 * (1.0 - za));
-    const uint32_t jp = static_cast<uint32_t>(nside * tp / HALFPI * tmp);
-    const uint32_t jm = static_cast<uint32_t>(nside * (1.0 - tp / HALFPI) * tmp);
-    const uint32_t ir = jp + jm + 1;
-    const uint32_t ip = ntt + 1;
-    
-    if (z > 0) {
-        return 2 * ir * (ir - 1) + ip - 1;
-    } else {
-        const uint32_t npix = 12 * nside * nside;
-        return npix - 2 * ir * (ir + 1) + ip - 1;
-    }
+    // theta: colatitude [0, pi], phi: longitude (wrapped into [0, 2*pi))
+    return healpix::ang2pixNest(header_.healpix_nside, theta, phi);
 }
 
 uint32_t Mag18CatalogV2::getHEALPixPixel(double ra, double dec) const {
@@ -209,76 +157,59 @@ uint32_t Mag18CatalogV2::getHEALPixPixel(double ra, double dec) const {
 }
 
 void Mag18CatalogV2::query_disc(double theta, double phi, double radius,
-                                 std::vector<uint32_t>& pixels) const {
-    // Simplified disc query - returns pixels that intersect with cone
-    // For production, use proper HEALPix query_disc from chealpix
-    
-    pixels.clear();
-    const uint32_t nside = header_.healpix_nside;
-    const uint32_t npix = 12 * nside * nside;
-    
-    // Brute force check all pixels (for NSIDE=64, this is 49,152 pixels)
-    // In production, use proper hierarchical algorithm
-    for (uint32_t pix = 0; pix < npix; ++pix) {
-        double pix_theta, pix_phi;
-        pix2ang_nest(pix, pix_theta, pix_phi);
-        
-        // Angular distance between disc center and pixel center
-        double cos_dist = sin(theta) * sin(pix_theta) * cos(phi - pix_phi) +
-                         cos(theta) * cos(pix_theta);
-        double dist = acos(std::max(-1.0, std::min(1.0, cos_dist)));
-        
-        // Pixel angular size ~ sqrt(4*pi / npix)
-        double pixel_size = sqrt(4.0 * PI / npix) * 1.5; // 1.5x for safety margin
-        
-        if (dist <= radius * DEG2RAD + pixel_size) {
-            pixels.push_back(pix);
-        }
-    }
+                                 std::vector<healpix::PixelRange>& ranges) const {
+    // Hierarchical NESTED disc query; radius in radians
+    const double sin_theta = sin(theta);
+    const healpix::Vec3 center{sin_theta * cos(phi), sin_theta * sin(phi), cos(theta)};
+    ranges = healpix::queryDisc(header_.healpix_nside, center, radius);
 }
 
 void Mag18CatalogV2::pix2ang_nest(uint32_t pixel, double& theta, double& phi) const {
-    // Simplified HEALPix pix2ang_nest for NSIDE=64
-    const uint32_t nside = header_.healpix_nside;
-    const uint32_t npface = nside * nside;
-    const uint32_t ncap = 2 * nside * (nside - 1);
-    
-    if (pixel < ncap) {
-        // North polar cap
-        const uint32_t iring = static_cast<uint32_t>(0.5 * (1 + sqrt(1 + 2 * pixel)));
-        const uint32_t iphi = pixel - 2 * iring * (iring - 1);
-        theta = acos(1.0 - iring * iring / (3.0 * npface));
-        phi = (iphi + 0.5) * PI / (2.0 * iring);
-    } else if (pixel < 12 * npface - ncap) {
-        // Equatorial region
-        const uint32_t ip = pixel - ncap;
-        const uint32_t iring = ip / (4 * nside) + nside;
-        const uint32_t iphi = ip % (4 * nside);
-        theta = acos((2 * nside - iring) * 2.0 / (3.0 * nside));
-        phi = (iphi + 0.5) * PI / (2.0 * nside);
-    } else {
-        // South polar cap
-        const uint32_t ip = 12 * npface - pixel;
-        const uint32_t iring = static_cast<uint32_t>(0.5 * (1 + sqrt(2 * ip - 1)));
-        const uint32_t iphi = 2 * iring * (iring + 1) - ip - 1;
-        theta = acos(-1.0 + iring * iring / (3.0 * npface));
-        phi = (iphi + 0.5) * PI / (2.0 * iring);
-    }
+    healpix::pix2angNest(header_.healpix_nside, pixel, theta, phi);
 }
 
-std::vector<uint32_t> Mag18CatalogV2::getPixelsInCone(double ra, double dec, 
-                                                        double radius) const {
+std::vector<healpix::PixelRange> Mag18CatalogV2::getPixelRangesInCone(double ra, double dec,
+                                                                       double radius) const {
     double theta = (90.0 - dec) * DEG2RAD;
     double phi = ra * DEG2RAD;
     
-    std::vector<uint32_t> pixels;
-    query_disc(theta, phi, radius * DEG2RAD, pixels);  // BUG FIX: Convert radius to radians
+    std::vector<healpix::PixelRange> ranges;
+    query_disc(theta, phi, radius * DEG2RAD, ranges);
+    
+    return ranges;
+}
+
+std::vector<uint32_t> Mag18CatalogV2::getPixelsInCone(double ra, double dec, 
+                                                        double radius) const {
+    return healpix::expandRanges(getPixelRangesInCone(ra, dec, radius));
+}
+
+std::vector<HEALPixIndexEntry> Mag18CatalogV2::getIndexEntriesInCone(double ra, double dec,
+                                                                     double radius) const {
+    return getIndexEntries(getPixelRangesInCone(ra, dec, radius));
+}
+
+std::vector<HEALPixIndexEntry> Mag18CatalogV2::getIndexEntries(
+    const std::vector<healpix::PixelRange>& ranges) const {
+    std::vector<HEALPixIndexEntry> entries;
+    
+    // The index is sorted by pixel, so each range maps to one contiguous run
+    for (const auto& range : ranges) {
+        auto it = std::lower_bound(healpix_index_.begin(), healpix_index_.end(), range.begin,
+            [](const HEALPixIndexEntry& entry, uint32_t pix) {
+                return entry.pixel_id < pix;
+            });
+        for (; it != healpix_index_.end() && it->pixel_id < range.end; ++it) {
+            entries.push_back(*it);
+        }
+    }
     
-    return pixels;
+    return entries;
 }
 
-std::vector<Mag18RecordV2> Mag18CatalogV2::readChunk(uint64_t chunk_id) {
-    // Check cache first (shared read lock)
+RecordSpan Mag18CatalogV2::readChunk(uint64_t chunk_id) {
+    // Check cache first (shared read lock). A hit only bumps the refcount
+    // of the cached span - the decompressed records are never copied.
     {
         std::shared_lock<std::shared_mutex> lock(cache_mutex_);
         for (auto& cached : chunk_cache_) {
@@ -289,55 +220,186 @@ std::vector<Mag18RecordV2> Mag18CatalogV2::readChunk(uint64_t chunk_id) {
         }
     }
     
-    // Not in cache, load from file
     if (chunk_id >= header_.total_chunks) {
         return {};
     }
     
-    const ChunkInfo& chunk = chunk_index_[chunk_id];
-    
-    // Read compressed data (exclusive file lock)
-    std::vector<uint8_t> compressed(chunk.compressed_size);
+    // Join an inflate already in flight, or claim this one
+    std::promise<RecordSpan> load_promise;
     {
-        std::lock_guard<std::mutex> file_lock(file_mutex_);
-        if (fseek(file_, chunk.file_offset, SEEK_SET) != 0) {
-            return {};
+        std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+        for (auto& cached : chunk_cache_) {
+            if (cached.chunk_id == chunk_id) {
+                cached.access_count.fetch_add(1, std::memory_order_relaxed);
+                return cached.records;
+            }
+        }
+        auto pending = loading_chunks_.find(chunk_id);
+        if (pending != loading_chunks_.end()) {
+            auto future = pending->second;
+            lock.unlock();
+            return future.get();
         }
-        if (fread(compressed.data(), 1, chunk.compressed_size, file_) != chunk.compressed_size) {
-            return {};
+        loading_chunks_.emplace(chunk_id, load_promise.get_future().share());
+    }
+    
+    // Read and inflate without holding any lock
+    RecordSpan span;
+    try {
+        span = inflateChunk(chunk_id);
+    } catch (...) {
+        {
+            std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+            loading_chunks_.erase(chunk_id);
         }
+        load_promise.set_exception(std::current_exception());
+        throw;
     }
     
-    // Decompress
-    std::vector<uint8_t> uncompressed(chunk.uncompressed_size);
+    // Add to cache (exclusive write lock); failed reads are not cached
+    {
+        std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+        loading_chunks_.erase(chunk_id);
+        if (!span.empty()) {
+            if (chunk_cache_.size() >= MAX_CACHED_CHUNKS) {
+                // Evict least recently used
+                auto lru = std::min_element(chunk_cache_.begin(), chunk_cache_.end(),
+                    [](const ChunkCache& a, const ChunkCache& b) {
+                        return a.access_count.load() < b.access_count.load();
+                    });
+                // Move assign (explicit for atomic members)
+                lru->chunk_id = chunk_id;
+                lru->records = span;
+                lru->access_count.store(1);
+            } else {
+                chunk_cache_.emplace_back(chunk_id, span, 1);
+            }
+        }
+    }
+    
+    load_promise.set_value(span);
+    return span;
+}
+
+RecordSpan Mag18CatalogV2::inflateChunk(uint64_t chunk_id) const {
+    const ChunkInfo& chunk = chunk_index_[chunk_id];
+    
+    // Compressed bytes are read in place from the mapping
+    if (chunk.file_offset > file_.size() ||
+        chunk.compressed_size > file_.size() - chunk.file_offset) {
+        std::cerr << "Chunk " << chunk_id << " lies outside the catalog file\n";
+        return {};
+    }
+    const uint8_t* compressed = file_.data() + chunk.file_offset;
+    
+    // Decompress straight into the record buffer
+    const size_t capacity = (chunk.uncompressed_size + sizeof(Mag18RecordV2) - 1) / sizeof(Mag18RecordV2);
+    if (chunk.num_stars > capacity) {
+        return {};
+    }
+    std::vector<Mag18RecordV2> records(capacity);
     uLongf dest_len = chunk.uncompressed_size;
-    if (uncompress(uncompressed.data(), &dest_len, compressed.data(), chunk.compressed_size) != Z_OK) {
+    if (uncompress(reinterpret_cast<Bytef*>(records.data()), &dest_len,
+                   compressed, chunk.compressed_size) != Z_OK) {
         return {};
     }
+    records.resize(chunk.num_stars);
+    
+    return RecordSpan::fromVector(std::move(records));
+}
+
+auto Mag18CatalogV2::pinChunks(const std::vector<HEALPixIndexEntry>& entries) -> PinnedChunks {
+    PinnedChunks pinned;
+    for (const auto& entry : entries) {
+        if (entry.num_stars == 0) continue;
+        const uint64_t first = entry.first_star_idx / header_.stars_per_chunk;
+        const uint64_t last = (entry.first_star_idx + entry.num_stars - 1) / header_.stars_per_chunk;
+        for (uint64_t chunk_id = first; chunk_id <= last && chunk_id < header_.total_chunks; ++chunk_id) {
+            pinned.ids.push_back(chunk_id);
+        }
+    }
+    std::sort(pinned.ids.begin(), pinned.ids.end());
+    pinned.ids.erase(std::unique(pinned.ids.begin(), pinned.ids.end()), pinned.ids.end());
+    pinned.spans.resize(pinned.ids.size());
     
-    // Parse records
-    std::vector<Mag18RecordV2> records(chunk.num_stars);
-    memcpy(records.data(), uncompressed.data(), chunk.num_stars * sizeof(Mag18RecordV2));
+    // Cold chunks inflate concurrently: zlib runs outside every lock
+    const long num_chunks = static_cast<long>(pinned.ids.size());
+    #pragma omp parallel for schedule(dynamic) if(enable_parallel_.load() && num_chunks > 1)
+    for (long i = 0; i < num_chunks; ++i) {
+        pinned.spans[i] = readChunk(pinned.ids[i]);
+    }
     
-    // Add to cache (exclusive write lock)
-    {
-        std::unique_lock<std::shared_mutex> lock(cache_mutex_);
-        if (chunk_cache_.size() >= MAX_CACHED_CHUNKS) {
-            // Evict least recently used
-            auto lru = std::min_element(chunk_cache_.begin(), chunk_cache_.end(),
-                [](const ChunkCache& a, const ChunkCache& b) {
-                    return a.access_count.load() < b.access_count.load();
-                });
-            // Move assign (explicit for atomic members)
-            lru->chunk_id = chunk_id;
-            lru->records = std::move(records);
-            lru->access_count.store(1);
-        } else {
-            chunk_cache_.emplace_back(chunk_id, std::move(records), 1);
+    return pinned;
+}
+
+template <typename Fn>
+void Mag18CatalogV2::forEachPinnedBatch(const std::vector<HEALPixIndexEntry>& entries, Fn&& fn) {
+    // Pixels own disjoint record ranges, so in record order their chunk
+    // ranges only ever share the boundary chunk with the previous pixel
+    std::vector<size_t> order(entries.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return entries[a].first_star_idx < entries[b].first_star_idx;
+    });
+    
+    size_t next = 0;
+    while (next < order.size()) {
+        std::vector<size_t> batch;
+        std::vector<HEALPixIndexEntry> batch_entries;
+        size_t distinct_chunks = 0;
+        bool any_chunk = false;
+        uint64_t last_chunk = 0;
+        
+        for (; next < order.size(); ++next) {
+            const HEALPixIndexEntry& entry = entries[order[next]];
+            if (entry.num_stars > 0) {
+                const uint64_t first = entry.first_star_idx / header_.stars_per_chunk;
+                const uint64_t last = (entry.first_star_idx + entry.num_stars - 1) / header_.stars_per_chunk;
+                const uint64_t new_first = any_chunk ? std::max(first, last_chunk + 1) : first;
+                const size_t added = last >= new_first ? static_cast<size_t>(last - new_first + 1) : 0;
+                if (!batch.empty() && distinct_chunks + added > MAX_CACHED_CHUNKS) {
+                    break;
+                }
+                distinct_chunks += added;
+                last_chunk = any_chunk ? std::max(last_chunk, last) : last;
+                any_chunk = true;
+                batch_entries.push_back(entry);
+            }
+            batch.push_back(order[next]);
+        }
+        
+        PinnedChunks pinned = pinChunks(batch_entries);
+        if (!fn(static_cast<const std::vector<size_t>&>(batch), static_cast<const PinnedChunks&>(pinned))) {
+            return;
+        }
+    }
+}
+
+template <typename Fn>
+bool Mag18CatalogV2::forEachPinnedRecord(const PinnedChunks& pinned, uint64_t first, uint64_t count,
+                                         Fn&& fn) const {
+    const uint64_t last = std::min<uint64_t>(first + count, header_.total_stars);
+    uint64_t index = first;
+    
+    while (index < last) {
+        const uint64_t chunk_id = index / header_.stars_per_chunk;
+        const uint64_t offset = index % header_.stars_per_chunk;
+        const uint64_t in_chunk = std::min<uint64_t>(last - index, header_.stars_per_chunk - offset);
+        
+        auto it = std::lower_bound(pinned.ids.begin(), pinned.ids.end(), chunk_id);
+        if (it != pinned.ids.end() && *it == chunk_id) {
+            const RecordSpan& chunk = pinned.spans[it - pinned.ids.begin()];
+            for (const auto& record : chunk.subspan(offset, in_chunk)) {
+                if (!fn(record)) {
+                    return false;
+                }
+            }
         }
+        
+        index += in_chunk;
     }
     
-    return records;
+    return true;
 }
 
 std::optional<Mag18RecordV2> Mag18CatalogV2::readRecord(uint64_t index) {
@@ -349,128 +411,159 @@ std::optional<Mag18RecordV2> Mag18CatalogV2::readRecord(uint64_t index) {
     uint64_t chunk_id = index / header_.stars_per_chunk;
     uint64_t offset_in_chunk = index % header_.stars_per_chunk;
     
-    auto records = readChunk(chunk_id);
-    if (records.empty() || offset_in_chunk >= records.size()) {
+    RecordSpan records = readChunk(chunk_id);
+    if (offset_in_chunk >= records.size()) {
         return std::nullopt;
     }
     
     return records[offset_in_chunk];
 }
 
-std::optional<GaiaStar> Mag18CatalogV2::queryBySourceId(uint64_t source_id) {
-    // Binary search (catalog must be sorted by source_id)
+template <typename Fn>
+bool Mag18CatalogV2::forEachRecord(uint64_t first, uint64_t count, Fn&& fn) {
+    const uint64_t last = std::min<uint64_t>(first + count, header_.total_stars);
+    uint64_t index = first;
+    
+    while (index < last) {
+        const uint64_t chunk_id = index / header_.stars_per_chunk;
+        const uint64_t offset = index % header_.stars_per_chunk;
+        const uint64_t in_chunk = std::min<uint64_t>(last - index, header_.stars_per_chunk - offset);
+        
+        // One cache lookup per chunk run instead of one per record
+        RecordSpan records = readChunk(chunk_id).subspan(offset, in_chunk);
+        for (const auto& record : records) {
+            if (!fn(record)) {
+                return false;
+            }
+        }
+        
+        index += in_chunk;
+    }
+    
+    return true;
+}
+
+std::optional<Mag18RecordV2> Mag18CatalogV2::findRecord(uint64_t source_id) {
+    // Catalog is sorted by source_id: bisect on chunks using their first and
+    // last records, then bisect inside the one chunk that can hold the id.
     uint64_t left = 0;
-    uint64_t right = header_.total_stars - 1;
+    uint64_t right = header_.total_chunks;
     
-    while (left <= right) {
+    while (left < right) {
         uint64_t mid = left + (right - left) / 2;
-        auto record = readRecord(mid);
-        
-        if (!record) {
+        RecordSpan records = readChunk(mid);
+        if (records.empty()) {
             return std::nullopt;
         }
         
-        if (record->source_id == source_id) {
-            return recordToStar(*record);
-        } else if (record->source_id < source_id) {
+        if (source_id < records.front().source_id) {
+            right = mid;
+        } else if (source_id > records.back().source_id) {
             left = mid + 1;
         } else {
-            if (mid == 0) break;
-            right = mid - 1;
+            auto it = std::lower_bound(records.begin(), records.end(), source_id,
+                [](const Mag18RecordV2& record, uint64_t id) {
+                    return record.source_id < id;
+                });
+            if (it != records.end() && it->source_id == source_id) {
+                return *it;
+            }
+            return std::nullopt;
         }
     }
     
     return std::nullopt;
 }
 
+std::optional<GaiaStar> Mag18CatalogV2::queryBySourceId(uint64_t source_id) {
+    auto record = findRecord(source_id);
+    if (!record) {
+        return std::nullopt;
+    }
+    return recordToStar(*record);
+}
+
 std::vector<GaiaStar> Mag18CatalogV2::queryCone(double ra, double dec, double radius,
                                                   size_t max_results) {
-    // Get HEALPix pixels intersecting cone
-    auto pixels = getPixelsInCone(ra, dec, radius);
+    return queryCone(ra, dec, radius, StarFilter(), max_results);
+}
+
+std::vector<GaiaStar> Mag18CatalogV2::queryCone(double ra, double dec, double radius,
+                                                  const StarFilter& filter, size_t max_results) {
+    // Get index entries of HEALPix pixels intersecting cone
+    auto entries = getIndexEntriesInCone(ra, dec, radius);
+    const bool filtered = filter.isActive();
     
     // If parallel processing is disabled or few pixels, use sequential
-    if (!enable_parallel_.load() || pixels.size() < 4) {
+    if (!enable_parallel_.load() || entries.size() < 4) {
         std::vector<GaiaStar> results;
-        for (uint32_t pixel : pixels) {
-            // Find pixel in index
-            auto it = std::lower_bound(healpix_index_.begin(), healpix_index_.end(), pixel,
-                [](const HEALPixIndexEntry& entry, uint32_t pix) {
-                    return entry.pixel_id < pix;
-                });
-            
-            if (it == healpix_index_.end() || it->pixel_id != pixel) {
-                continue;
-            }
-            
+        for (const auto& entry : entries) {
             // Scan all stars in pixel
-            for (uint32_t i = 0; i < it->num_stars; ++i) {
-                auto record = readRecord(it->first_star_idx + i);
-                if (!record) continue;
-                
-                double dist = angularDistance(ra, dec, record->ra, record->dec);
-                if (dist <= radius) {
-                    results.push_back(recordToStar(*record));
+            bool complete = forEachRecord(entry.first_star_idx, entry.num_stars,
+                [&](const Mag18RecordV2& record) {
+                    if (filtered && !acceptsRecord(filter, record)) return true;
                     
-                    if (max_results > 0 && results.size() >= max_results) {
-                        return results;
+                    double dist = angularDistance(ra, dec, record.ra, record.dec);
+                    if (dist <= radius) {
+                        results.push_back(recordToStar(record));
+                        if (max_results > 0 && results.size() >= max_results) {
+                            return false;
+                        }
                     }
-                }
+                    return true;
+                });
+            
+            if (!complete) {
+                return results;
             }
         }
         return results;
     }
     
-    // PARALLEL PROCESSING with OpenMP
+    // PARALLEL PROCESSING with OpenMP: inflate each batch of touched chunks
+    // concurrently, then scan its pixels in parallel over the pinned records
     std::vector<GaiaStar> results;
-    std::mutex results_mutex;
     std::atomic<bool> limit_reached(false);
     
-    #pragma omp parallel if(enable_parallel_.load())
-    {
-        std::vector<GaiaStar> thread_results;
-        
-        #pragma omp for schedule(dynamic)
-        for (size_t p = 0; p < pixels.size(); ++p) {
-            if (limit_reached.load()) continue;
-            
-            uint32_t pixel = pixels[p];
-            
-            // Find pixel in index
-            auto it = std::lower_bound(healpix_index_.begin(), healpix_index_.end(), pixel,
-                [](const HEALPixIndexEntry& entry, uint32_t pix) {
-                    return entry.pixel_id < pix;
-                });
-            
-            if (it == healpix_index_.end() || it->pixel_id != pixel) {
-                continue;
-            }
+    forEachPinnedBatch(entries, [&](const std::vector<size_t>& batch, const PinnedChunks& pinned) {
+        #pragma omp parallel if(enable_parallel_.load())
+        {
+            std::vector<GaiaStar> thread_results;
             
-            // Scan all stars in pixel
-            for (uint32_t i = 0; i < it->num_stars; ++i) {
-                if (limit_reached.load()) break;
+            #pragma omp for schedule(dynamic)
+            for (size_t b = 0; b < batch.size(); ++b) {
+                if (limit_reached.load()) continue;
                 
-                auto record = readRecord(it->first_star_idx + i);
-                if (!record) continue;
+                const HEALPixIndexEntry& entry = entries[batch[b]];
                 
-                double dist = angularDistance(ra, dec, record->ra, record->dec);
-                if (dist <= radius) {
-                    thread_results.push_back(recordToStar(*record));
-                }
+                // Scan all stars in pixel
+                forEachPinnedRecord(pinned, entry.first_star_idx, entry.num_stars,
+                    [&](const Mag18RecordV2& record) {
+                        if (limit_reached.load()) return false;
+                        if (filtered && !acceptsRecord(filter, record)) return true;
+                        
+                        double dist = angularDistance(ra, dec, record.ra, record.dec);
+                        if (dist <= radius) {
+                            thread_results.push_back(recordToStar(record));
+                        }
+                        return true;
+                    });
             }
-        }
-        
-        // Merge thread results (critical section)
-        if (!thread_results.empty()) {
-            #pragma omp critical
-            {
-                results.insert(results.end(), thread_results.begin(), thread_results.end());
-                
-                if (max_results > 0 && results.size() >= max_results) {
-                    limit_reached.store(true);
+            
+            // Merge thread results (critical section)
+            if (!thread_results.empty()) {
+                #pragma omp critical
+                {
+                    results.insert(results.end(), thread_results.begin(), thread_results.end());
+                    
+                    if (max_results > 0 && results.size() >= max_results) {
+                        limit_reached.store(true);
+                    }
                 }
             }
         }
-    }
+        return !limit_reached.load();
+    });
     
     // Truncate if needed
     if (max_results > 0 && results.size() > max_results) {
@@ -480,169 +573,205 @@ std::vector<GaiaStar> Mag18CatalogV2::queryCone(double ra, double dec, double ra
     return results;
 }
 
-std::vector<GaiaStar> Mag18CatalogV2::queryConeWithMagnitude(double ra, double dec, double radius,
-                                                               double mag_min, double mag_max,
-                                                               size_t max_results) {
-    auto pixels = getPixelsInCone(ra, dec, radius);
-    
-    // Sequential for small queries
-    if (!enable_parallel_.load() || pixels.size() < 4) {
-        std::vector<GaiaStar> results;
-        
-        for (uint32_t pixel : pixels) {
-            auto it = std::lower_bound(healpix_index_.begin(), healpix_index_.end(), pixel,
-                [](const HEALPixIndexEntry& entry, uint32_t pix) {
-                    return entry.pixel_id < pix;
-                });
-            
-            if (it == healpix_index_.end() || it->pixel_id != pixel) continue;
-            
-            for (uint32_t i = 0; i < it->num_stars; ++i) {
-                auto record = readRecord(it->first_star_idx + i);
-                if (!record) continue;
-                
-                if (record->g_mag < mag_min || record->g_mag > mag_max) continue;
-                
-                double dist = angularDistance(ra, dec, record->ra, record->dec);
-                if (dist <= radius) {
-                    results.push_back(recordToStar(*record));
-                    
-                    if (max_results > 0 && results.size() >= max_results) {
-                        return results;
+StarBatch Mag18CatalogV2::queryConeColumns(double ra, double dec, double radius,
+                                          size_t max_results) {
+    return queryConeColumns(ra, dec, radius, StarFilter(), max_results);
+}
+
+StarBatch Mag18CatalogV2::queryConeColumns(double ra, double dec, double radius,
+                                          const StarFilter& filter, size_t max_results) {
+    auto entries = getIndexEntriesInCone(ra, dec, radius);
+    const bool filtered = filter.isActive();
+    StarBatch results;
+    
+    if (!enable_parallel_.load() || entries.size() < 4) {
+        for (const auto& entry : entries) {
+            bool complete = forEachRecord(entry.first_star_idx, entry.num_stars,
+                [&](const Mag18RecordV2& record) {
+                    if (filtered && !acceptsRecord(filter, record)) return true;
+                    if (angularDistance(ra, dec, record.ra, record.dec) <= radius) {
+                        appendRecord(results, record);
+                        if (max_results > 0 && results.size() >= max_results) {
+                            return false;
+                        }
                     }
-                }
+                    return true;
+                });
+            if (!complete) {
+                break;
             }
         }
         return results;
     }
     
-    // PARALLEL PROCESSING with OpenMP
-    std::vector<GaiaStar> results;
-    std::atomic<bool> limit_reached(false);
+    // One batch per pixel, scanned in parallel and concatenated in pixel order
+    std::vector<StarBatch> pixel_results(entries.size());
     
-    #pragma omp parallel if(enable_parallel_.load())
-    {
-        std::vector<GaiaStar> thread_results;
-        
-        #pragma omp for schedule(dynamic)
-        for (size_t p = 0; p < pixels.size(); ++p) {
-            if (limit_reached.load()) continue;
-            
-            uint32_t pixel = pixels[p];
-            
-            auto it = std::lower_bound(healpix_index_.begin(), healpix_index_.end(), pixel,
-                [](const HEALPixIndexEntry& entry, uint32_t pix) {
-                    return entry.pixel_id < pix;
+    forEachPinnedBatch(entries, [&](const std::vector<size_t>& batch, const PinnedChunks& pinned) {
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t b = 0; b < batch.size(); ++b) {
+            const size_t p = batch[b];
+            const HEALPixIndexEntry& entry = entries[p];
+            forEachPinnedRecord(pinned, entry.first_star_idx, entry.num_stars,
+                [&](const Mag18RecordV2& record) {
+                    if (filtered && !acceptsRecord(filter, record)) return true;
+                    if (angularDistance(ra, dec, record.ra, record.dec) <= radius) {
+                        appendRecord(pixel_results[p], record);
+                    }
+                    return true;
                 });
-            
-            if (it == healpix_index_.end() || it->pixel_id != pixel) continue;
-            
-            for (uint32_t i = 0; i < it->num_stars; ++i) {
-                if (limit_reached.load()) break;
-                
-                auto record = readRecord(it->first_star_idx + i);
-                if (!record) continue;
-                
-                if (record->g_mag < mag_min || record->g_mag > mag_max) continue;
-                
-                double dist = angularDistance(ra, dec, record->ra, record->dec);
-                if (dist <= radius) {
-                    thread_results.push_back(recordToStar(*record));
-                }
-            }
-        }
-        
-        // Merge results (critical section)
-        if (!thread_results.empty()) {
-            #pragma omp critical
-            {
-                results.insert(results.end(), thread_results.begin(), thread_results.end());
-                
-                if (max_results > 0 && results.size() >= max_results) {
-                    limit_reached.store(true);
-                }
-            }
         }
-    }
+        return true;
+    });
     
-    if (max_results > 0 && results.size() > max_results) {
-        results.resize(max_results);
+    for (const auto& batch : pixel_results) {
+        results.append(batch);
+    }
+    if (max_results > 0) {
+        results.truncate(max_results);
     }
-    
     return results;
 }
 
+std::vector<GaiaStar> Mag18CatalogV2::queryConeWithMagnitude(double ra, double dec, double radius,
+                                                               double mag_min, double mag_max,
+                                                               size_t max_results) {
+    StarFilter filter;
+    filter.min_magnitude = mag_min;
+    filter.max_magnitude = mag_max;
+    return queryCone(ra, dec, radius, filter, max_results);
+}
+
 std::vector<GaiaStar> Mag18CatalogV2::queryBrightest(double ra, double dec, double radius,
                                                        size_t num_stars) {
-    auto all_stars = queryCone(ra, dec, radius, 0);
-    
-    // Partial sort to get N brightest
-    if (all_stars.size() > num_stars) {
-        std::partial_sort(all_stars.begin(), all_stars.begin() + num_stars, all_stars.end(),
-            [](const GaiaStar& a, const GaiaStar& b) {
-                return a.phot_g_mean_mag < b.phot_g_mean_mag;
-            });
-        all_stars.resize(num_stars);
-    } else {
-        std::sort(all_stars.begin(), all_stars.end(),
-            [](const GaiaStar& a, const GaiaStar& b) {
-                return a.phot_g_mean_mag < b.phot_g_mean_mag;
-            });
-    }
-    
-    return all_stars;
+    return queryBrightest(ra, dec, radius, num_stars, StarFilter());
 }
 
-size_t Mag18CatalogV2::countInCone(double ra, double dec, double radius) {
-    size_t count = 0;
-    auto pixels = getPixelsInCone(ra, dec, radius);
+std::vector<GaiaStar> Mag18CatalogV2::queryBrightest(double ra, double dec, double radius,
+                                                       size_t num_stars, const StarFilter& filter) {
+    if (num_stars == 0) {
+        return {};
+    }
+    auto entries = getIndexEntriesInCone(ra, dec, radius);
+    const bool filtered = filter.isActive();
     
-    for (uint32_t pixel : pixels) {
-        auto it = std::lower_bound(healpix_index_.begin(), healpix_index_.end(), pixel,
-            [](const HEALPixIndexEntry& entry, uint32_t pix) {
-                return entry.pixel_id < pix;
-            });
-        
-        if (it == healpix_index_.end() || it->pixel_id != pixel) continue;
+    // One bounded heap per thread on the raw records, merged after each batch
+    BrightestSelector<Mag18RecordV2> best(num_stars);
+    
+    forEachPinnedBatch(entries, [&](const std::vector<size_t>& batch, const PinnedChunks& pinned) {
+        const long num_entries = static_cast<long>(batch.size());
         
-        for (uint32_t i = 0; i < it->num_stars; ++i) {
-            auto record = readRecord(it->first_star_idx + i);
-            if (!record) continue;
+        #pragma omp parallel if(enable_parallel_.load() && num_entries >= 4)
+        {
+            BrightestSelector<Mag18RecordV2> local(num_stars);
             
-            double dist = angularDistance(ra, dec, record->ra, record->dec);
-            if (dist <= radius) {
-                count++;
+            #pragma omp for schedule(dynamic) nowait
+            for (long b = 0; b < num_entries; ++b) {
+                const HEALPixIndexEntry& entry = entries[batch[b]];
+                forEachPinnedRecord(pinned, entry.first_star_idx, entry.num_stars,
+                    [&](const Mag18RecordV2& record) {
+                        if (local.excludes(record.g_mag)) return true;
+                        if (filtered && !acceptsRecord(filter, record)) return true;
+                        if (angularDistance(ra, dec, record.ra, record.dec) <= radius) {
+                            local.offer(record.g_mag, record.source_id, record);
+                        }
+                        return true;
+                    });
             }
+            
+            #pragma omp critical
+            best.merge(local);
         }
+        return true;
+    });
+    
+    std::vector<GaiaStar> results;
+    for (const auto& record : best.take()) {
+        results.push_back(recordToStar(record));
+    }
+    return results;
+}
+
+std::vector<GaiaStar> Mag18CatalogV2::queryNearest(double ra, double dec, size_t k,
+                                                     const StarFilter& filter) {
+    if (k == 0) {
+        return {};
     }
+    const bool filtered = filter.isActive();
+    BrightestSelector<Mag18RecordV2> nearest(k);  // Ranked by distance
     
-    return count;
+    // Pixels arrive closest first; each one is read through the chunk cache
+    healpix::walkByDistance(header_.healpix_nside, healpix::radecToVec(ra, dec),
+        [&](uint32_t pixel, double) {
+            auto it = std::lower_bound(healpix_index_.begin(), healpix_index_.end(), pixel,
+                [](const HEALPixIndexEntry& entry, uint32_t pix) {
+                    return entry.pixel_id < pix;
+                });
+            if (it != healpix_index_.end() && it->pixel_id == pixel) {
+                const std::vector<HEALPixIndexEntry> entry(1, *it);
+                PinnedChunks pinned = pinChunks(entry);
+                forEachPinnedRecord(pinned, it->first_star_idx, it->num_stars,
+                    [&](const Mag18RecordV2& record) {
+                        // The distance is at least the declination difference
+                        if (std::abs(record.dec - dec) > nearest.threshold()) return true;
+                        if (filtered && !acceptsRecord(filter, record)) return true;
+                        nearest.offer(angularDistance(ra, dec, record.ra, record.dec),
+                                      record.source_id, record);
+                        return true;
+                    });
+            }
+            return nearest.threshold() * DEG2RAD;
+        });
+    
+    std::vector<GaiaStar> results;
+    for (const auto& record : nearest.take()) {
+        results.push_back(recordToStar(record));
+    }
+    return results;
 }
 
-std::optional<Mag18RecordV2> Mag18CatalogV2::getExtendedRecord(uint64_t source_id) {
-    // Binary search
-    uint64_t left = 0;
-    uint64_t right = header_.total_stars - 1;
+size_t Mag18CatalogV2::countInCone(double ra, double dec, double radius) {
+    const double theta = (90.0 - dec) * DEG2RAD;
+    const double phi = ra * DEG2RAD;
+    const double sin_theta = sin(theta);
+    const healpix::Vec3 center{sin_theta * cos(phi), sin_theta * sin(phi), cos(theta)};
     
-    while (left <= right) {
-        uint64_t mid = left + (right - left) / 2;
-        auto record = readRecord(mid);
-        
-        if (!record) {
-            return std::nullopt;
-        }
-        
-        if (record->source_id == source_id) {
-            return record;
-        } else if (record->source_id < source_id) {
-            left = mid + 1;
-        } else {
-            if (mid == 0) break;
-            right = mid - 1;
+    std::vector<healpix::PixelRange> inner, boundary;
+    healpix::queryDisc(header_.healpix_nside, center, radius * DEG2RAD, inner, boundary);
+    
+    // Pixels entirely inside the cone are counted from the index alone
+    size_t count = 0;
+    for (const auto& entry : getIndexEntries(inner)) {
+        count += entry.num_stars;
+    }
+    
+    // Only pixels crossing the edge need their records tested
+    auto entries = getIndexEntries(boundary);
+    
+    forEachPinnedBatch(entries, [&](const std::vector<size_t>& batch, const PinnedChunks& pinned) {
+        const long num_entries = static_cast<long>(batch.size());
+        size_t batch_count = 0;
+        #pragma omp parallel for schedule(dynamic) reduction(+:batch_count) if(enable_parallel_.load() && num_entries >= 4)
+        for (long b = 0; b < num_entries; ++b) {
+            const HEALPixIndexEntry& entry = entries[batch[b]];
+            forEachPinnedRecord(pinned, entry.first_star_idx, entry.num_stars,
+                [&](const Mag18RecordV2& record) {
+                    double dist = angularDistance(ra, dec, record.ra, record.dec);
+                    if (dist <= radius) {
+                        batch_count++;
+                    }
+                    return true;
+                });
         }
-    }
+        count += batch_count;
+        return true;
+    });
     
-    return std::nullopt;
+    return count;
+}
+
+std::optional<Mag18RecordV2> Mag18CatalogV2::getExtendedRecord(uint64_t source_id) {
+    return findRecord(source_id);
 }
 
 GaiaStar Mag18CatalogV2::recordToStar(const Mag18RecordV2& record) const {
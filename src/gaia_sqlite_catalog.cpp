@@ -4,128 +4,434 @@
 #include <iostream>
 #include <sstream>
 #include <cmath>
+#include <algorithm>
+#include <limits>
+#include <functional>
 
 namespace ioc::gaia {
 
+namespace {
+
+// Read-only tuning applied to every pooled connection
+const char* const kConnectionPragmas =
+    "PRAGMA query_only = ON;"
+    "PRAGMA mmap_size = 268435456;"   // Map up to 256 MB of the file
+    "PRAGMA cache_size = -65536;"     // 64 MB page cache per connection
+    "PRAGMA temp_store = MEMORY;";
+
+// Idle connections kept for reuse; busier bursts open extra ones
+constexpr size_t kMaxIdleConnections = 16;
+
+// Keys bound per IN list in batched lookups
+constexpr size_t kLookupBatch = 256;
+
+// Catalog number from "1234" or "HD 1234"; -1 if not a number
+int64_t parseCatalogNumber(const std::string& designation) {
+    size_t last_space = designation.find_last_of(' ');
+    std::string numeric = (last_space == std::string::npos) ? designation : designation.substr(last_space + 1);
+    try {
+        return std::stoll(numeric);
+    } catch (...) {
+        return -1;
+    }
+}
+
+} // namespace
+
 GaiaSqliteCatalog::GaiaSqliteCatalog(const std::string& db_path) : db_path_(db_path) {
-    openDatabase();
+    auto connection = openConnection();
+    if (!connection) {
+        throw std::runtime_error("Failed to open Gaia SQLite database: " + db_path);
+    }
+    loadSchema(*connection);
+    open_ = true;
+    release(std::move(connection));
+}
+
+GaiaSqliteCatalog::~GaiaSqliteCatalog() = default;
+
+GaiaSqliteCatalog::Connection::~Connection() {
+    for (auto& entry : statements) {
+        sqlite3_finalize(entry.second);
+    }
+    if (db) {
+        sqlite3_close(db);
+    }
+}
+
+sqlite3_stmt* GaiaSqliteCatalog::Connection::prepare(const std::string& sql) {
+    auto it = statements.find(sql);
+    if (it != statements.end()) {
+        sqlite3_reset(it->second);
+        sqlite3_clear_bindings(it->second);
+        return it->second;
+    }
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v3(db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+        return nullptr;
+    }
+    statements.emplace(sql, stmt);
+    return stmt;
 }
 
-GaiaSqliteCatalog::~GaiaSqliteCatalog() {
-    closeDatabase();
+GaiaSqliteCatalog::Lease::~Lease() {
+    if (connection_) {
+        owner_->release(std::move(connection_));
+    }
 }
 
-void GaiaSqliteCatalog::openDatabase() {
-    int rc = sqlite3_open_v2(db_path_.c_str(), &db_, SQLITE_OPEN_READONLY, nullptr);
+std::unique_ptr<GaiaSqliteCatalog::Connection> GaiaSqliteCatalog::openConnection() const {
+    auto connection = std::make_unique<Connection>();
+    // Each connection serves one thread at a time: no per-call mutex
+    int rc = sqlite3_open_v2(db_path_.c_str(), &connection->db,
+                             SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr);
     if (rc != SQLITE_OK) {
-        std::string error = sqlite3_errmsg(db_);
-        closeDatabase();
-        throw std::runtime_error("Failed to open Gaia SQLite database: " + error);
+        std::cerr << "Failed to open Gaia SQLite database: "
+                  << (connection->db ? sqlite3_errmsg(connection->db) : db_path_) << std::endl;
+        return nullptr;
+    }
+    sqlite3_exec(connection->db, kConnectionPragmas, nullptr, nullptr, nullptr);
+    return connection;
+}
+
+GaiaSqliteCatalog::Lease GaiaSqliteCatalog::lease() const {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        if (!idle_connections_.empty()) {
+            auto connection = std::move(idle_connections_.back());
+            idle_connections_.pop_back();
+            return Lease(this, std::move(connection));
+        }
+    }
+    // Opened outside the lock; null (failed open) leases are checked by callers
+    return Lease(this, open_ ? openConnection() : nullptr);
+}
+
+void GaiaSqliteCatalog::release(std::unique_ptr<Connection> connection) const {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (idle_connections_.size() < kMaxIdleConnections) {
+        idle_connections_.push_back(std::move(connection));
+    }
+}
+
+void GaiaSqliteCatalog::loadSchema(Connection& connection) {
+    star_columns_.clear();
+    sqlite3_stmt* stmt = connection.prepare("PRAGMA table_info(stars)");
+    if (!stmt) {
+        return;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* name = (const char*)sqlite3_column_text(stmt, 1);
+        star_columns_.push_back(name ? name : "");
+    }
+    sqlite3_reset(stmt);
+
+    // Leading column of each index: lookups on these can use IN lists
+    indexed_columns_.clear();
+    stmt = connection.prepare("SELECT ii.name FROM pragma_index_list('stars') il, "
+                              "pragma_index_info(il.name) ii WHERE ii.seqno = 0");
+    if (!stmt) {
+        return;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* name = (const char*)sqlite3_column_text(stmt, 0);
+        if (name) indexed_columns_.push_back(name);
     }
+    sqlite3_reset(stmt);
+}
+
+std::string GaiaSqliteCatalog::starColumn(size_t index) const {
+    return index < star_columns_.size() ? star_columns_[index] : std::string();
+}
+
+bool GaiaSqliteCatalog::hasStarColumn(const std::string& name) const {
+    return std::find(star_columns_.begin(), star_columns_.end(), name) != star_columns_.end();
 }
 
-void GaiaSqliteCatalog::closeDatabase() {
-    if (db_) {
-        sqlite3_close(db_);
-        db_ = nullptr;
+// NULL is a missing value: NaN, as in the multi-file catalog
+static double columnReal(sqlite3_stmt* stmt, int column) {
+    if (sqlite3_column_type(stmt, column) == SQLITE_NULL) {
+        return std::numeric_limits<double>::quiet_NaN();
     }
+    return sqlite3_column_double(stmt, column);
 }
 
+// Reads a row projected by GaiaSqliteCatalog::selectColumns
 static GaiaStar rowToStar(sqlite3_stmt* stmt) {
     GaiaStar star;
     star.source_id = sqlite3_column_int64(stmt, 0);
     star.ra = sqlite3_column_double(stmt, 1);
     star.dec = sqlite3_column_double(stmt, 2);
-    star.pmra = sqlite3_column_double(stmt, 3);
-    star.pmdec = sqlite3_column_double(stmt, 4);
-    star.parallax = sqlite3_column_double(stmt, 5);
-    star.phot_g_mean_mag = sqlite3_column_double(stmt, 6);
-    star.ruwe = sqlite3_column_double(stmt, 7);
+    star.pmra = columnReal(stmt, 3);
+    star.pmdec = columnReal(stmt, 4);
+    star.parallax = columnReal(stmt, 5);
+    star.phot_g_mean_mag = columnReal(stmt, 6);
+    star.ruwe = columnReal(stmt, 7);
     
     const char* name = (const char*)sqlite3_column_text(stmt, 8);
     if (name) star.common_name = name;
     
     // Cross-references
-    int hd = sqlite3_column_int(stmt, 12);
+    int hd = sqlite3_column_int(stmt, 9);
     if (hd > 0) star.hd_designation = "HD " + std::to_string(hd);
     
-    int hip = sqlite3_column_int(stmt, 13);
+    int hip = sqlite3_column_int(stmt, 10);
     if (hip > 0) star.hip_designation = std::to_string(hip);
     
-    int sao = sqlite3_column_int(stmt, 14);
+    int sao = sqlite3_column_int(stmt, 11);
     if (sao > 0) star.sao_designation = "SAO " + std::to_string(sao);
     
     return star;
 }
 
 std::vector<GaiaStar> GaiaSqliteCatalog::queryCone(double ra, double dec, double radius, double max_mag) {
-    if (!db_) return {};
+    StarFilter filter;
+    filter.max_magnitude = max_mag;
+    return queryCone(ra, dec, radius, filter);
+}
 
-    std::vector<GaiaStar> results;
+StarFilter GaiaSqliteCatalog::appendFilterClauses(const StarFilter& filter, std::string& sql,
+                                                  std::vector<double>& values) const {
+    constexpr double kInf = std::numeric_limits<double>::infinity();
+    // Limits SQLite could not evaluate, re-checked on the converted rows
+    StarFilter residual = filter;
     
-    // 1. Precise bounding box for R*Tree
-    double min_ra = ra - radius / std::cos(dec * M_PI / 180.0);
-    double max_ra = ra + radius / std::cos(dec * M_PI / 180.0);
-    double min_dec = dec - radius;
-    double max_dec = dec + radius;
-
-    // Handle RA wrap-around if needed (simplified here for broad regions)
-    // For narrow searches typical of occultations, wrap-around is rare 
-    // but should be handled by two queries if cross 0/360 boundary.
+    // A NULL column is a missing value and passes, as NaN does in StarFilter
+    auto addBound = [&](const std::string& expression, const char* op, double value) {
+        sql += " AND (" + expression + " IS NULL OR " + expression + " " + op + " ?)";
+        values.push_back(value);
+    };
     
-    std::string sql;
-    if (min_ra < 0 || max_ra > 360) {
-        // Simple wrap-around handling
-        sql = "SELECT s.* FROM stars s JOIN stars_spatial sp ON s.sid = sp.id "
-              "WHERE ((sp.min_ra >= ? AND sp.max_ra <= 360) OR (sp.min_ra >= 0 AND sp.max_ra <= ?)) "
-              "AND sp.min_dec >= ? AND sp.max_dec <= ? AND s.mag <= ?";
-    } else {
-        sql = "SELECT s.* FROM stars s JOIN stars_spatial sp ON s.sid = sp.id "
-              "WHERE sp.min_ra >= ? AND sp.max_ra <= ? AND sp.min_dec >= ? AND sp.max_dec <= ? "
-              "AND s.mag <= ?";
+    // Columns read by rowToStar: 3 pmra, 4 pmdec, 5 parallax, 6 mag, 7 ruwe
+    auto addRange = [&](const std::string& column, double min_value, double max_value) {
+        if (column.empty()) return false;
+        const std::string expression = "s.\"" + column + "\"";
+        if (min_value > -kInf) addBound(expression, ">=", min_value);
+        if (max_value < kInf) addBound(expression, "<=", max_value);
+        return true;
+    };
+    
+    if (addRange(starColumn(6), filter.min_magnitude, filter.max_magnitude)) {
+        residual.min_magnitude = -kInf;
+        residual.max_magnitude = kInf;
+    }
+    if (addRange(starColumn(5), filter.min_parallax, filter.max_parallax)) {
+        residual.min_parallax = -kInf;
+        residual.max_parallax = kInf;
+    }
+    if (addRange(starColumn(7), -kInf, filter.max_ruwe)) {
+        residual.max_ruwe = kInf;
+    }
+    if (hasStarColumn("bp_rp")) {
+        addRange("bp_rp", filter.min_bp_rp, filter.max_bp_rp);
+    }
+    residual.min_bp_rp = -kInf;  // rowToStar does not read the color
+    residual.max_bp_rp = kInf;
+    
+    const std::string pmra = starColumn(3);
+    const std::string pmdec = starColumn(4);
+    if (filter.hasProperMotionLimit() && !pmra.empty() && !pmdec.empty()) {
+        const std::string pm2 = "(s.\"" + pmra + "\" * s.\"" + pmra + "\" + s.\"" +
+                                pmdec + "\" * s.\"" + pmdec + "\")";
+        if (filter.min_proper_motion > 0.0) {
+            addBound(pm2, ">=", filter.min_proper_motion * filter.min_proper_motion);
+        }
+        if (filter.max_proper_motion < kInf) {
+            addBound(pm2, "<=", filter.max_proper_motion * filter.max_proper_motion);
+        }
+        residual.min_proper_motion = 0.0;
+        residual.max_proper_motion = kInf;
     }
+    
+    return residual;
+}
+
+std::vector<GaiaStar> GaiaSqliteCatalog::queryCone(double ra, double dec, double radius,
+                                                   const StarFilter& filter) {
+    std::vector<GaiaStar> results;
+    forEachInCone(ra, dec, radius, filter, false, [&](const GaiaStar& star) {
+        results.push_back(star);
+        return true;
+    });
+    return results;
+}
+
+std::vector<GaiaStar> GaiaSqliteCatalog::queryBrightest(double ra, double dec, double radius,
+                                                        size_t num_stars, const StarFilter& filter) {
+    std::vector<GaiaStar> results;
+    if (num_stars == 0) return results;
+    
+    // Rows arrive brightest first, so the first num_stars inside the cone
+    // are the answer and the remaining rows are never converted
+    forEachInCone(ra, dec, radius, filter, true, [&](const GaiaStar& star) {
+        results.push_back(star);
+        return results.size() < num_stars;
+    });
+    return results;
+}
 
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        return {};
+std::string GaiaSqliteCatalog::selectColumns() const {
+    // Order read by rowToStar: schema columns 0-8, then hd, hip, sao (12-14)
+    static const size_t kRowColumns[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 13, 14};
+    std::string columns;
+    for (size_t index : kRowColumns) {
+        const std::string name = starColumn(index);
+        if (!columns.empty()) columns += ", ";
+        columns += name.empty() ? std::string("NULL") : "s.\"" + name + "\"";
     }
+    return columns;
+}
+
+StarFilter GaiaSqliteCatalog::buildConeQuery(double ra, double dec, double radius, const StarFilter& filter,
+                                             bool brightest_first, std::string& sql,
+                                             std::vector<double>& values) const {
+    // 1. Bounding box: the widest point of the cone is asin(sin(radius) / cos(dec))
+    // from its centre in RA; a cone that contains a pole spans every RA
+    const double dec_min = std::max(-90.0, dec - radius);
+    const double dec_max = std::min(90.0, dec + radius);
+    const double cos_dec = std::cos(dec * M_PI / 180.0);
+    const bool contains_pole = (dec + radius >= 90.0 || dec - radius <= -90.0);
+    const double sin_ratio = std::sin(radius * M_PI / 180.0) / cos_dec;
+    const bool all_ra = contains_pole || radius >= 90.0 || cos_dec <= 0.0 || sin_ratio >= 1.0;
 
-    if (min_ra < 0 || max_ra > 360) {
-        double wrapped_min = (min_ra < 0) ? min_ra + 360 : min_ra;
-        double wrapped_max = (max_ra > 360) ? max_ra - 360 : max_ra;
-        sqlite3_bind_double(stmt, 1, wrapped_min);
-        sqlite3_bind_double(stmt, 2, wrapped_max);
-        sqlite3_bind_double(stmt, 3, min_dec);
-        sqlite3_bind_double(stmt, 4, max_dec);
-        sqlite3_bind_double(stmt, 5, max_mag);
+    // 2. RA intervals; a box crossing RA 0/360 becomes two ranges
+    std::vector<std::pair<double, double>> ra_ranges;
+    if (!all_ra) {
+        const double half_width = std::asin(sin_ratio) * 180.0 / M_PI + 1e-9;
+        double center = std::fmod(ra, 360.0);
+        if (center < 0) center += 360.0;
+        const double ra_min = center - half_width;
+        const double ra_max = center + half_width;
+        if (ra_min < 0) {
+            ra_ranges = {{ra_min + 360.0, 360.0}, {0.0, ra_max}};
+        } else if (ra_max > 360.0) {
+            ra_ranges = {{ra_min, 360.0}, {0.0, ra_max - 360.0}};
+        } else {
+            ra_ranges = {{ra_min, ra_max}};
+        }
+    }
+
+    // 3. One range scan per interval. Entries overlapping the box are
+    // candidates (R*Tree boxes are float32, rounded outwards), which lets
+    // the R*Tree module drive the join
+    const std::string columns = selectColumns();
+    StarFilter residual = filter;
+    auto addScan = [&](const std::pair<double, double>* ra_range) {
+        sql += "SELECT " + columns + " FROM stars_spatial sp JOIN stars s ON s.sid = sp.id "
+               "WHERE sp.max_dec >= ? AND sp.min_dec <= ?";
+        values.push_back(dec_min);
+        values.push_back(dec_max);
+        if (ra_range) {
+            sql += " AND sp.max_ra >= ? AND sp.min_ra <= ?";
+            values.push_back(ra_range->first);
+            values.push_back(ra_range->second);
+        }
+        // Column limits in the WHERE clause
+        residual = appendFilterClauses(filter, sql, values);
+    };
+
+    if (ra_ranges.size() > 1) {
+        // The ranges are disjoint, so UNION ALL needs no de-duplication
+        sql = "SELECT * FROM (";
+        addScan(&ra_ranges[0]);
+        sql += " UNION ALL ";
+        addScan(&ra_ranges[1]);
+        sql += ")";
     } else {
-        sqlite3_bind_double(stmt, 1, min_ra);
-        sqlite3_bind_double(stmt, 2, max_ra);
-        sqlite3_bind_double(stmt, 3, min_dec);
-        sqlite3_bind_double(stmt, 4, max_dec);
-        sqlite3_bind_double(stmt, 5, max_mag);
+        addScan(ra_ranges.empty() ? nullptr : &ra_ranges[0]);
+    }
+
+    // Missing magnitudes last, as in BrightestSelector
+    const std::string mag = starColumn(6);
+    if (brightest_first && !mag.empty()) {
+        const std::string prefix = ra_ranges.size() > 1 ? "" : "s.";
+        sql += " ORDER BY " + prefix + "\"" + mag + "\" IS NULL, " + prefix + "\"" + mag + "\", " +
+               prefix + "\"" + starColumn(0) + "\"";
+    }
+    return residual;
+}
+
+void GaiaSqliteCatalog::forEachInCone(double ra, double dec, double radius, const StarFilter& filter,
+                                      bool brightest_first,
+                                      const std::function<bool(const GaiaStar&)>& on_hit) {
+    Lease connection = lease();
+    if (!connection) return;
+
+    std::string sql;
+    std::vector<double> values;
+    const StarFilter residual = buildConeQuery(ra, dec, radius, filter, brightest_first, sql, values);
+    const bool check_residual = residual.isActive();
+
+    sqlite3_stmt* stmt = connection->prepare(sql);
+    if (!stmt) {
+        return;
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        sqlite3_bind_double(stmt, static_cast<int>(i + 1), values[i]);
     }
 
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         GaiaStar star = rowToStar(stmt);
+        if (check_residual && !residual.accepts(star)) continue;
         
         // Final angular distance filter
         double dist = angularDistance({ra, dec}, {star.ra, star.dec});
-        if (dist <= radius) {
-            results.push_back(star);
+        if (dist <= radius && !on_hit(star)) {
+            break;
         }
     }
 
-    sqlite3_finalize(stmt);
-    return results;
+    sqlite3_reset(stmt);
+}
+
+std::vector<std::string> GaiaSqliteCatalog::explainConeQuery(double ra, double dec, double radius,
+                                                             const StarFilter& filter,
+                                                             bool brightest_first) const {
+    std::vector<std::string> plan;
+    Lease connection = lease();
+    if (!connection) return plan;
+
+    std::string sql;
+    std::vector<double> values;
+    buildConeQuery(ra, dec, radius, filter, brightest_first, sql, values);
+
+    sqlite3_stmt* stmt = connection->prepare("EXPLAIN QUERY PLAN " + sql);
+    if (!stmt) {
+        return plan;
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        sqlite3_bind_double(stmt, static_cast<int>(i + 1), values[i]);
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* detail = (const char*)sqlite3_column_text(stmt, 3);
+        plan.push_back(detail ? detail : "");
+    }
+
+    sqlite3_reset(stmt);
+    return plan;
+}
+
+bool GaiaSqliteCatalog::coneUsesSpatialIndex(double ra, double dec, double radius) const {
+    // The R*Tree module reports its own searches as "VIRTUAL TABLE INDEX"
+    const auto plan = explainConeQuery(ra, dec, radius);
+    if (plan.empty()) return false;
+    for (const auto& line : plan) {
+        if (line.find("stars_spatial") != std::string::npos &&
+            line.find("VIRTUAL TABLE INDEX") == std::string::npos) {
+            return false;
+        }
+    }
+    return std::any_of(plan.begin(), plan.end(), [](const std::string& line) {
+        return line.find("VIRTUAL TABLE INDEX") != std::string::npos;
+    });
 }
 
 std::optional<GaiaStar> GaiaSqliteCatalog::queryBySourceId(uint64_t source_id) {
-    if (!db_) return std::nullopt;
+    Lease connection = lease();
+    if (!connection) return std::nullopt;
 
-    const char* sql = "SELECT * FROM stars WHERE sid = ?";
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_stmt* stmt = connection->prepare("SELECT " + selectColumns() + " FROM stars s WHERE s.sid = ?");
+    if (!stmt) {
         return std::nullopt;
     }
 
@@ -136,12 +442,13 @@ std::optional<GaiaStar> GaiaSqliteCatalog::queryBySourceId(uint64_t source_id) {
         result = rowToStar(stmt);
     }
 
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     return result;
 }
 
 std::optional<GaiaStar> GaiaSqliteCatalog::queryByDesignation(const std::string& catalog, const std::string& designation) {
-    if (!db_) return std::nullopt;
+    Lease connection = lease();
+    if (!connection) return std::nullopt;
 
     std::string column;
     if (catalog == "SAO") column = "sao";
@@ -150,25 +457,20 @@ std::optional<GaiaStar> GaiaSqliteCatalog::queryByDesignation(const std::string&
     else if (catalog == "NAME") column = "name";
     else return std::nullopt;
 
-    std::string sql = "SELECT * FROM stars WHERE " + column + " = ?";
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_stmt* stmt = connection->prepare("SELECT " + selectColumns() + " FROM stars s WHERE s." + column + " = ?");
+    if (!stmt) {
         return std::nullopt;
     }
 
     if (catalog == "NAME") {
         sqlite3_bind_text(stmt, 1, designation.c_str(), -1, SQLITE_TRANSIENT);
     } else {
-        try {
-            // Remove prefix if present (e.g. "HD 1234" -> 1234)
-            size_t last_space = designation.find_last_of(' ');
-            std::string numeric = (last_space == std::string::npos) ? designation : designation.substr(last_space + 1);
-            int id = std::stoi(numeric);
-            sqlite3_bind_int(stmt, 1, id);
-        } catch (...) {
-            sqlite3_finalize(stmt);
+        // Remove prefix if present (e.g. "HD 1234" -> 1234)
+        const int64_t id = parseCatalogNumber(designation);
+        if (id < 0) {
             return std::nullopt;
         }
+        sqlite3_bind_int64(stmt, 1, id);
     }
 
     std::optional<GaiaStar> result;
@@ -176,26 +478,140 @@ std::optional<GaiaStar> GaiaSqliteCatalog::queryByDesignation(const std::string&
         result = rowToStar(stmt);
     }
 
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     return result;
 }
 
+std::vector<std::optional<GaiaStar>> GaiaSqliteCatalog::queryBySourceIds(const std::vector<uint64_t>& source_ids) {
+    std::vector<int64_t> keys(source_ids.begin(), source_ids.end());
+    return lookupBatch(starColumn(0), 0, keys);
+}
+
+std::vector<std::optional<GaiaStar>> GaiaSqliteCatalog::queryByDesignations(
+    const std::string& catalog, const std::vector<std::string>& designations) {
+    // Projected position of the looked-up column (see selectColumns)
+    std::string column;
+    size_t key_index = 0;
+    if (catalog == "HD") { column = "hd"; key_index = 9; }
+    else if (catalog == "HIP") { column = "hip"; key_index = 10; }
+    else if (catalog == "SAO") { column = "sao"; key_index = 11; }
+    else if (catalog == "NAME") {
+        // Text keys: one cached statement, re-bound per name
+        std::vector<std::optional<GaiaStar>> results;
+        results.reserve(designations.size());
+        for (const auto& name : designations) {
+            results.push_back(queryByDesignation(catalog, name));
+        }
+        return results;
+    } else {
+        return std::vector<std::optional<GaiaStar>>(designations.size());
+    }
+
+    std::vector<int64_t> keys;
+    keys.reserve(designations.size());
+    for (const auto& designation : designations) {
+        keys.push_back(parseCatalogNumber(designation));
+    }
+    return lookupBatch(column, key_index, keys);
+}
+
+std::vector<std::optional<GaiaStar>> GaiaSqliteCatalog::lookupBatch(const std::string& column, size_t key_index,
+                                                                    const std::vector<int64_t>& keys) {
+    std::vector<std::optional<GaiaStar>> results(keys.size());
+    if (keys.empty() || column.empty()) return results;
+
+    Lease connection = lease();
+    if (!connection) return results;
+
+    // (key, input position) in key order: rows are matched back by binary
+    // search, and sorted IN lists walk the index in order
+    std::vector<std::pair<int64_t, size_t>> wanted;
+    wanted.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        wanted.emplace_back(keys[i], i);
+    }
+    std::sort(wanted.begin(), wanted.end());
+
+    std::vector<int64_t> distinct;
+    for (const auto& entry : wanted) {
+        if (distinct.empty() || distinct.back() != entry.first) distinct.push_back(entry.first);
+    }
+
+    auto deliver = [&](sqlite3_stmt* stmt) {
+        const int64_t key = sqlite3_column_int64(stmt, static_cast<int>(key_index));
+        auto range = std::equal_range(wanted.begin(), wanted.end(), std::make_pair(key, size_t(0)),
+                                      [](const auto& a, const auto& b) { return a.first < b.first; });
+        if (range.first == range.second || results[range.first->second]) return;  // First row wins
+        const GaiaStar star = rowToStar(stmt);
+        for (auto it = range.first; it != range.second; ++it) {
+            results[it->second] = star;
+        }
+    };
+
+    const bool indexed = (key_index == 0) ||
+        std::find(indexed_columns_.begin(), indexed_columns_.end(), column) != indexed_columns_.end();
+
+    if (!indexed) {
+        // One pass over the table beats a full scan per IN list
+        sqlite3_stmt* stmt = connection->prepare("SELECT " + selectColumns() + " FROM stars s WHERE s.\"" +
+                                                 column + "\" IS NOT NULL");
+        if (!stmt) {
+            return results;
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            deliver(stmt);
+        }
+        sqlite3_reset(stmt);
+        return results;
+    }
+
+    std::string sql = "SELECT " + selectColumns() + " FROM stars s WHERE s.\"" + column + "\" IN (?";
+    for (size_t i = 1; i < kLookupBatch; ++i) {
+        sql += ", ?";
+    }
+    sql += ")";
+    sqlite3_stmt* stmt = connection->prepare(sql);
+    if (!stmt) {
+        return results;
+    }
+
+    for (size_t begin = 0; begin < distinct.size(); begin += kLookupBatch) {
+        sqlite3_reset(stmt);
+        // A short last batch repeats its last key
+        for (size_t i = 0; i < kLookupBatch; ++i) {
+            const size_t index = std::min(begin + i, distinct.size() - 1);
+            sqlite3_bind_int64(stmt, static_cast<int>(i + 1), distinct[index]);
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            deliver(stmt);
+        }
+    }
+
+    sqlite3_reset(stmt);
+    return results;
+}
+
 size_t GaiaSqliteCatalog::getTotalStars() const {
-    if (!db_) return 0;
+    const int64_t cached = total_stars_.load();
+    if (cached >= 0) return static_cast<size_t>(cached);
+
+    Lease connection = lease();
+    if (!connection) return 0;
 
-    const char* sql = "SELECT COUNT(*) FROM stars";
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_stmt* stmt = connection->prepare("SELECT COUNT(*) FROM stars");
+    if (!stmt) {
         return 0;
     }
 
-    size_t count = 0;
+    int64_t count = -1;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         count = sqlite3_column_int64(stmt, 0);
     }
 
-    sqlite3_finalize(stmt);
-    return count;
+    sqlite3_reset(stmt);
+    if (count < 0) return 0;
+    total_stars_.store(count);
+    return static_cast<size_t>(count);
 }
 
 } // namespace ioc::gaia
@@ -0,0 +1,365 @@
+#include "ioc_gaialib/healpix.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+namespace ioc::gaia::healpix {
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr double TWOPI = 2.0 * PI;
+constexpr double HALFPI = 0.5 * PI;
+constexpr double DEG2RAD = PI / 180.0;
+constexpr double TWOTHIRD = 2.0 / 3.0;
+constexpr int MAX_ORDER = 13;
+
+// Ring and phase offsets of the 12 base faces
+constexpr int JRLL[12] = {2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4};
+constexpr int JPLL[12] = {1, 3, 5, 7, 0, 2, 4, 6, 1, 3, 5, 7};
+
+// Interleave the low 16 bits of v with zeros (x -> even bits)
+uint32_t spreadBits(uint32_t v) {
+    v &= 0x0000ffffu;
+    v = (v | (v << 8)) & 0x00ff00ffu;
+    v = (v | (v << 4)) & 0x0f0f0f0fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+// Inverse of spreadBits: gather the even bits of v
+uint32_t compressBits(uint32_t v) {
+    v &= 0x55555555u;
+    v = (v | (v >> 1)) & 0x33333333u;
+    v = (v | (v >> 2)) & 0x0f0f0f0fu;
+    v = (v | (v >> 4)) & 0x00ff00ffu;
+    v = (v | (v >> 8)) & 0x0000ffffu;
+    return v;
+}
+
+uint32_t xyf2nest(int order, uint32_t ix, uint32_t iy, uint32_t face) {
+    return (face << (2 * order)) + spreadBits(ix) + (spreadBits(iy) << 1);
+}
+
+void nest2xyf(int order, uint32_t pixel, int& ix, int& iy, int& face) {
+    const uint32_t npface = 1u << (2 * order);
+    face = static_cast<int>(pixel >> (2 * order));
+    const uint32_t p = pixel & (npface - 1);
+    ix = static_cast<int>(compressBits(p));
+    iy = static_cast<int>(compressBits(p >> 1));
+}
+
+// Pixel center as z = cos(theta), phi and (near the poles) sin(theta)
+void pix2loc(uint32_t nside, uint32_t pixel, double& z, double& phi,
+             double& sth, bool& have_sth) {
+    const int order = nsideToOrder(nside);
+    const int64_t ns = nside;
+    const double fact2 = 4.0 / npix(nside);
+    const double fact1 = (ns << 1) * fact2;
+
+    int ix, iy, face;
+    nest2xyf(order, pixel, ix, iy, face);
+
+    const int64_t jr = (static_cast<int64_t>(JRLL[face]) << order) - ix - iy - 1;
+    int64_t nr;
+    have_sth = false;
+
+    if (jr < ns) {
+        nr = jr;
+        const double tmp = (nr * nr) * fact2;
+        z = 1.0 - tmp;
+        if (z > 0.99) {
+            sth = std::sqrt(tmp * (2.0 - tmp));
+            have_sth = true;
+        }
+    } else if (jr > 3 * ns) {
+        nr = 4 * ns - jr;
+        const double tmp = (nr * nr) * fact2;
+        z = tmp - 1.0;
+        if (z < -0.99) {
+            sth = std::sqrt(tmp * (2.0 - tmp));
+            have_sth = true;
+        }
+    } else {
+        nr = ns;
+        z = (2 * ns - jr) * fact1;
+    }
+
+    int64_t tmp = static_cast<int64_t>(JPLL[face]) * nr + ix - iy;
+    if (tmp < 0) tmp += 8 * nr;
+    phi = (nr == ns) ? 0.75 * HALFPI * tmp * fact1 : (0.5 * HALFPI * tmp) / nr;
+}
+
+struct DiscQuery {
+    int order;
+    Vec3 center;
+    double radius;
+    double max_radius[MAX_ORDER + 1];
+    std::vector<PixelRange> ranges;
+    std::vector<PixelRange>* inner = nullptr;  // Receives fully inside subtrees when set
+
+    static void emit(std::vector<PixelRange>& out, uint32_t begin, uint32_t end) {
+        if (!out.empty() && out.back().end == begin) {
+            out.back().end = end;
+        } else {
+            out.push_back({begin, end});
+        }
+    }
+
+    void visit(int level, uint32_t pixel) {
+        const double dist = angleBetween(center, pix2vecNest(1u << level, pixel));
+        const double bound = max_radius[level];
+
+        if (dist > radius + bound) {
+            return;  // Whole subtree outside the disc
+        }
+
+        const int shift = 2 * (order - level);
+        if (dist + bound <= radius) {
+            // Subtree fully inside
+            emit(inner ? *inner : ranges, pixel << shift, (pixel + 1) << shift);
+            return;
+        }
+        if (level == order) {
+            // Boundary pixel at target resolution
+            emit(ranges, pixel << shift, (pixel + 1) << shift);
+            return;
+        }
+
+        for (uint32_t child = 0; child < 4; ++child) {
+            visit(level + 1, 4 * pixel + child);
+        }
+    }
+};
+
+} // anonymous namespace
+
+bool isValidNside(uint32_t nside) {
+    return nside > 0 && nside <= (1u << MAX_ORDER) && (nside & (nside - 1)) == 0;
+}
+
+int nsideToOrder(uint32_t nside) {
+    int order = 0;
+    while ((1u << order) < nside) {
+        ++order;
+    }
+    return order;
+}
+
+Vec3 radecToVec(double ra, double dec) {
+    const double ra_rad = ra * DEG2RAD;
+    const double dec_rad = dec * DEG2RAD;
+    const double cos_dec = std::cos(dec_rad);
+    return {cos_dec * std::cos(ra_rad), cos_dec * std::sin(ra_rad), std::sin(dec_rad)};
+}
+
+double angleBetween(const Vec3& a, const Vec3& b) {
+    // atan2 form stays accurate for both tiny and near-antipodal angles
+    const double cx = a.y * b.z - a.z * b.y;
+    const double cy = a.z * b.x - a.x * b.z;
+    const double cz = a.x * b.y - a.y * b.x;
+    return std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), a.dot(b));
+}
+
+uint32_t ang2pixNest(uint32_t nside, double theta, double phi) {
+    const int order = nsideToOrder(nside);
+    const int64_t ns = nside;
+    const double z = std::cos(theta);
+    const double za = std::fabs(z);
+
+    double tt = std::fmod(phi / HALFPI, 4.0);  // in [0,4)
+    if (tt < 0) tt += 4.0;
+
+    if (za <= TWOTHIRD) {
+        // Equatorial region
+        const double temp1 = ns * (0.5 + tt);
+        const double temp2 = ns * (z * 0.75);
+        const int64_t jp = static_cast<int64_t>(temp1 - temp2);  // ascending edge line
+        const int64_t jm = static_cast<int64_t>(temp1 + temp2);  // descending edge line
+        const int64_t ifp = jp >> order;  // in {0,4}
+        const int64_t ifm = jm >> order;
+        const int64_t face = (ifp == ifm) ? (ifp | 4) : ((ifp < ifm) ? ifp : (ifm + 8));
+        const int64_t ix = jm & (ns - 1);
+        const int64_t iy = ns - (jp & (ns - 1)) - 1;
+        return xyf2nest(order, static_cast<uint32_t>(ix), static_cast<uint32_t>(iy),
+                        static_cast<uint32_t>(face));
+    }
+
+    // Polar caps
+    const int ntt = std::min(3, static_cast<int>(tt));
+    const double tp = tt - ntt;
+    const double tmp = ns * std::sqrt(3.0 * (1.0 - za));
+    const int64_t jp = std::min<int64_t>(static_cast<int64_t>(tp * tmp), ns - 1);
+    const int64_t jm = std::min<int64_t>(static_cast<int64_t>((1.0 - tp) * tmp), ns - 1);
+
+    if (z > 0) {
+        return xyf2nest(order, static_cast<uint32_t>(ns - jm - 1),
+                        static_cast<uint32_t>(ns - jp - 1), static_cast<uint32_t>(ntt));
+    }
+    return xyf2nest(order, static_cast<uint32_t>(jp), static_cast<uint32_t>(jm),
+                    static_cast<uint32_t>(ntt + 8));
+}
+
+uint32_t radec2pixNest(uint32_t nside, double ra, double dec) {
+    return ang2pixNest(nside, (90.0 - dec) * DEG2RAD, ra * DEG2RAD);
+}
+
+void pix2angNest(uint32_t nside, uint32_t pixel, double& theta, double& phi) {
+    double z, sth;
+    bool have_sth;
+    pix2loc(nside, pixel, z, phi, sth, have_sth);
+    theta = have_sth ? std::atan2(sth, z) : std::acos(z);
+}
+
+Vec3 pix2vecNest(uint32_t nside, uint32_t pixel) {
+    double z, phi, sth;
+    bool have_sth;
+    pix2loc(nside, pixel, z, phi, sth, have_sth);
+    if (!have_sth) {
+        sth = std::sqrt((1.0 - z) * (1.0 + z));
+    }
+    return {sth * std::cos(phi), sth * std::sin(phi), z};
+}
+
+double maxPixelRadius(uint32_t nside) {
+    // Distance between the pixel center and the farthest corner of the
+    // worst-shaped pixel (Healpix_Base::max_pixrad)
+    auto from_z_phi = [](double z, double phi) {
+        const double sth = std::sqrt((1.0 - z) * (1.0 + z));
+        return Vec3{sth * std::cos(phi), sth * std::sin(phi), z};
+    };
+    const Vec3 va = from_z_phi(TWOTHIRD, PI / (4.0 * nside));
+    double t1 = 1.0 - 1.0 / nside;
+    t1 *= t1;
+    const Vec3 vb = from_z_phi(1.0 - t1 / 3.0, 0.0);
+    return angleBetween(va, vb);
+}
+
+namespace {
+
+// Shared traversal; fully inside subtrees go to inner when it is non-null
+std::vector<PixelRange> runDiscQuery(uint32_t nside, const Vec3& center, double radius,
+                                     std::vector<PixelRange>* inner) {
+    DiscQuery query;
+    query.order = nsideToOrder(nside);
+    query.center = center;
+    query.radius = radius;
+    query.inner = inner;
+    for (int level = 0; level <= query.order; ++level) {
+        // Small relative margin keeps the bound conservative under rounding
+        query.max_radius[level] = maxPixelRadius(1u << level) * (1.0 + 1e-9);
+    }
+
+    for (uint32_t face = 0; face < 12; ++face) {
+        query.visit(0, face);
+    }
+
+    return std::move(query.ranges);
+}
+
+} // anonymous namespace
+
+std::vector<PixelRange> queryDisc(uint32_t nside, const Vec3& center, double radius) {
+    if (!isValidNside(nside) || radius < 0) {
+        return {};
+    }
+    if (radius >= PI) {
+        return {{0, npix(nside)}};
+    }
+    return runDiscQuery(nside, center, radius, nullptr);
+}
+
+void queryDisc(uint32_t nside, const Vec3& center, double radius,
+               std::vector<PixelRange>& inner, std::vector<PixelRange>& boundary) {
+    inner.clear();
+    boundary.clear();
+    if (!isValidNside(nside) || radius < 0) {
+        return;
+    }
+    if (radius >= PI) {
+        inner.push_back({0, npix(nside)});
+        return;
+    }
+    boundary = runDiscQuery(nside, center, radius, &inner);
+}
+
+std::vector<PixelRange> queryDisc(uint32_t nside, double ra, double dec, double radius) {
+    return queryDisc(nside, radecToVec(ra, dec), radius * DEG2RAD);
+}
+
+void walkByDistance(uint32_t nside, const Vec3& center,
+                    const std::function<double(uint32_t, double)>& visit) {
+    if (!isValidNside(nside)) {
+        return;
+    }
+    const int order = nsideToOrder(nside);
+    double max_radius[MAX_ORDER + 1];
+    for (int level = 0; level <= order; ++level) {
+        max_radius[level] = maxPixelRadius(1u << level) * (1.0 + 1e-9);
+    }
+    
+    struct Cell {
+        double bound;
+        int level;
+        uint32_t pixel;
+    };
+    auto farther = [](const Cell& a, const Cell& b) { return a.bound > b.bound; };
+    std::priority_queue<Cell, std::vector<Cell>, decltype(farther)> frontier(farther);
+    auto push = [&](int level, uint32_t pixel) {
+        const double dist = angleBetween(center, pix2vecNest(1u << level, pixel));
+        frontier.push({std::max(0.0, dist - max_radius[level]), level, pixel});
+    };
+    
+    for (uint32_t face = 0; face < 12; ++face) {
+        push(0, face);
+    }
+    
+    double limit = std::numeric_limits<double>::infinity();
+    while (!frontier.empty() && frontier.top().bound <= limit) {
+        const Cell cell = frontier.top();
+        frontier.pop();
+        if (cell.level == order) {
+            limit = std::min(limit, visit(cell.pixel, cell.bound));
+            continue;
+        }
+        for (uint32_t child = 0; child < 4; ++child) {
+            push(cell.level + 1, (cell.pixel << 2) | child);
+        }
+    }
+}
+
+std::vector<uint32_t> expandRanges(const std::vector<PixelRange>& ranges) {
+    std::vector<uint32_t> pixels;
+    size_t total = 0;
+    for (const auto& range : ranges) {
+        total += range.size();
+    }
+    pixels.reserve(total);
+    for (const auto& range : ranges) {
+        for (uint32_t pix = range.begin; pix < range.end; ++pix) {
+            pixels.push_back(pix);
+        }
+    }
+    return pixels;
+}
+
+void mergeRanges(std::vector<PixelRange>& ranges) {
+    if (ranges.empty()) {
+        return;
+    }
+    std::sort(ranges.begin(), ranges.end(),
+              [](const PixelRange& a, const PixelRange& b) { return a.begin < b.begin; });
+    size_t out = 0;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        if (ranges[i].begin <= ranges[out].end) {
+            ranges[out].end = std::max(ranges[out].end, ranges[i].end);
+        } else {
+            ranges[++out] = ranges[i];
+        }
+    }
+    ranges.resize(out + 1);
+}
+
+} // namespace ioc::gaia::healpix
@@ -0,0 +1,314 @@
+#include "ioc_gaialib/http_transport.h"
+#include "ioc_gaialib/types.h"
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+#include <curl/curl.h>
+
+namespace ioc {
+namespace gaia {
+
+// =============================================================================
+// RateLimiter - Token bucket
+// =============================================================================
+
+RateLimiter::RateLimiter(int queries_per_minute, int burst)
+    : tokens_per_second_(queries_per_minute > 0 ? queries_per_minute / 60.0 : 0.0),
+      capacity_(std::max(burst, 1)),
+      tokens_(capacity_),
+      last_refill_(std::chrono::steady_clock::now()) {}
+
+void RateLimiter::setRate(int queries_per_minute) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tokens_per_second_ = queries_per_minute > 0 ? queries_per_minute / 60.0 : 0.0;
+}
+
+std::chrono::steady_clock::duration RateLimiter::tryAcquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tokens_per_second_ <= 0.0) {
+        return std::chrono::steady_clock::duration::zero();  // No limit
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - last_refill_).count();
+    tokens_ = std::min(capacity_, tokens_ + elapsed * tokens_per_second_);
+    last_refill_ = now;
+
+    if (tokens_ >= 1.0) {
+        tokens_ -= 1.0;
+        return std::chrono::steady_clock::duration::zero();
+    }
+    auto wait = std::chrono::duration<double>((1.0 - tokens_) / tokens_per_second_);
+    return std::max<std::chrono::steady_clock::duration>(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(wait),
+        std::chrono::milliseconds(1));
+}
+
+void RateLimiter::acquire() {
+    for (;;) {
+        auto wait = tryAcquire();
+        if (wait == std::chrono::steady_clock::duration::zero()) return;
+        std::this_thread::sleep_for(wait);
+    }
+}
+
+// =============================================================================
+// HttpTransport::Impl - curl multi worker
+// =============================================================================
+
+namespace {
+
+size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    ((std::string*)userp)->append((char*)contents, size * nmemb);
+    return size * nmemb;
+}
+
+bool initializeCurl() {
+    // Thread-safe once: function-local static
+    static const bool initialized = (curl_global_init(CURL_GLOBAL_DEFAULT) == CURLE_OK);
+    return initialized;
+}
+
+} // anonymous namespace
+
+class HttpTransport::Impl {
+public:
+    explicit Impl(long max_host_connections) {
+        if (!initializeCurl() || !(multi_ = curl_multi_init())) {
+            throw GaiaException(ErrorCode::NETWORK_ERROR, "Failed to initialize CURL");
+        }
+        curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, max_host_connections);
+        curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, std::max(max_host_connections * 4, 16L));
+        worker_ = std::thread([this] { run(); });
+    }
+
+    ~Impl() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        curl_multi_wakeup(multi_);
+        worker_.join();
+        for (CURL* easy : idle_handles_) {
+            curl_easy_cleanup(easy);
+        }
+        curl_multi_cleanup(multi_);
+    }
+
+    std::future<HttpResponse> submit(HttpRequest request) {
+        auto transfer = std::make_unique<Transfer>();
+        transfer->request = std::move(request);
+        auto future = transfer->promise.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                transfer->promise.set_exception(std::make_exception_ptr(
+                    GaiaException(ErrorCode::NETWORK_ERROR, "HTTP transport is shutting down")));
+                return future;
+            }
+            submitted_.push_back(std::move(transfer));
+        }
+        curl_multi_wakeup(multi_);
+        return future;
+    }
+
+private:
+    struct Transfer {
+        HttpRequest request;
+        std::promise<HttpResponse> promise;
+        HttpResponse response;
+        int attempt = 0;
+        std::chrono::steady_clock::time_point not_before;
+        curl_slist* header_list = nullptr;
+        char error[CURL_ERROR_SIZE] = {};
+    };
+
+    CURLM* multi_ = nullptr;
+    std::thread worker_;
+    std::mutex mutex_;
+    bool stopping_ = false;
+    std::vector<std::unique_ptr<Transfer>> submitted_;  // Guarded by mutex_
+
+    // Worker thread only
+    std::vector<std::unique_ptr<Transfer>> waiting_;     // Queued, backing off or rate limited
+    std::unordered_map<CURL*, std::unique_ptr<Transfer>> active_;
+    std::vector<CURL*> idle_handles_;
+
+    void run() {
+        for (;;) {
+            bool stopping;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping = stopping_;
+                for (auto& transfer : submitted_) {
+                    waiting_.push_back(std::move(transfer));
+                }
+                submitted_.clear();
+            }
+            if (stopping) {
+                abortAll();
+                return;
+            }
+
+            // Start what is due
+            auto now = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < waiting_.size();) {
+                Transfer& transfer = *waiting_[i];
+                if (transfer.not_before <= now && transfer.request.rate_limiter) {
+                    auto wait = transfer.request.rate_limiter->tryAcquire();
+                    if (wait != std::chrono::steady_clock::duration::zero()) {
+                        transfer.not_before = now + wait;
+                    }
+                }
+                if (transfer.not_before > now) {
+                    ++i;
+                    continue;
+                }
+                std::unique_ptr<Transfer> ready = std::move(waiting_[i]);
+                waiting_.erase(waiting_.begin() + i);
+                start(std::move(ready));
+            }
+
+            int running = 0;
+            curl_multi_perform(multi_, &running);
+
+            int queued = 0;
+            while (CURLMsg* message = curl_multi_info_read(multi_, &queued)) {
+                if (message->msg == CURLMSG_DONE) {
+                    finish(message->easy_handle, message->data.result);
+                }
+            }
+
+            // The earliest deferred start (backoff or rate limit) bounds the poll
+            now = std::chrono::steady_clock::now();
+            auto next_start = now + std::chrono::seconds(1);
+            for (const auto& transfer : waiting_) {
+                next_start = std::min(next_start, transfer->not_before);
+            }
+            auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(next_start - now);
+            int timeout_ms = static_cast<int>(std::clamp<long long>(timeout.count(), 0, 1000));
+            curl_multi_poll(multi_, nullptr, 0, timeout_ms, nullptr);
+        }
+    }
+
+    void start(std::unique_ptr<Transfer> transfer) {
+        CURL* easy = nullptr;
+        if (!idle_handles_.empty()) {
+            easy = idle_handles_.back();
+            idle_handles_.pop_back();
+            curl_easy_reset(easy);
+        } else {
+            easy = curl_easy_init();
+        }
+        if (!easy) {
+            transfer->promise.set_exception(std::make_exception_ptr(
+                GaiaException(ErrorCode::NETWORK_ERROR, "Failed to initialize CURL")));
+            return;
+        }
+
+        const HttpRequest& request = transfer->request;
+        curl_slist_free_all(transfer->header_list);
+        transfer->header_list = nullptr;
+        for (const auto& header : request.headers) {
+            transfer->header_list = curl_slist_append(transfer->header_list, header.c_str());
+        }
+        transfer->response.body.clear();
+        transfer->error[0] = '\0';
+
+        curl_easy_setopt(easy, CURLOPT_URL, request.url.c_str());
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, static_cast<long>(request.body.size()));
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDS, request.body.c_str());
+        curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->header_list);
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer->response.body);
+        curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, transfer->error);
+        curl_easy_setopt(easy, CURLOPT_TIMEOUT, request.timeout_seconds);
+        curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+        // Keep-alive, HTTP/2 multiplexing (HTTP/1.1 on plain http) and compressed responses
+        curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+        curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING, "");
+
+        if (curl_multi_add_handle(multi_, easy) != CURLM_OK) {
+            curl_easy_cleanup(easy);
+            curl_slist_free_all(transfer->header_list);
+            transfer->promise.set_exception(std::make_exception_ptr(
+                GaiaException(ErrorCode::NETWORK_ERROR, "Failed to start HTTP transfer")));
+            return;
+        }
+        active_.emplace(easy, std::move(transfer));
+    }
+
+    void finish(CURL* easy, CURLcode result) {
+        auto it = active_.find(easy);
+        if (it == active_.end()) return;
+        std::unique_ptr<Transfer> transfer = std::move(it->second);
+        active_.erase(it);
+
+        long status = 0;
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+        curl_multi_remove_handle(multi_, easy);
+        idle_handles_.push_back(easy);  // Connections stay in the multi handle's cache
+
+        const bool retryable = result != CURLE_OK || status == 429 || status >= 500;
+        if (retryable && transfer->attempt < transfer->request.max_retries) {
+            ++transfer->attempt;
+            transfer->not_before = std::chrono::steady_clock::now() +
+                                   transfer->request.retry_delay * transfer->attempt;
+            waiting_.push_back(std::move(transfer));
+            return;
+        }
+
+        curl_slist_free_all(transfer->header_list);
+        transfer->header_list = nullptr;
+        if (result != CURLE_OK) {
+            std::string detail = transfer->error[0] ? transfer->error : curl_easy_strerror(result);
+            transfer->promise.set_exception(std::make_exception_ptr(
+                GaiaException(ErrorCode::NETWORK_ERROR, "CURL error: " + detail)));
+            return;
+        }
+        transfer->response.status = status;
+        transfer->promise.set_value(std::move(transfer->response));
+    }
+
+    void abortAll() {
+        auto shutdown = std::make_exception_ptr(
+            GaiaException(ErrorCode::NETWORK_ERROR, "HTTP transport is shutting down"));
+        for (auto& entry : active_) {
+            curl_multi_remove_handle(multi_, entry.first);
+            curl_easy_cleanup(entry.first);
+            curl_slist_free_all(entry.second->header_list);
+            entry.second->promise.set_exception(shutdown);
+        }
+        active_.clear();
+        for (auto& transfer : waiting_) {
+            curl_slist_free_all(transfer->header_list);
+            transfer->promise.set_exception(shutdown);
+        }
+        waiting_.clear();
+    }
+};
+
+// =============================================================================
+// HttpTransport Public Interface
+// =============================================================================
+
+HttpTransport::HttpTransport(long max_host_connections)
+    : pImpl_(std::make_unique<Impl>(max_host_connections)) {}
+
+HttpTransport::~HttpTransport() = default;
+
+HttpTransport& HttpTransport::instance() {
+    static HttpTransport transport;
+    return transport;
+}
+
+std::future<HttpResponse> HttpTransport::submit(HttpRequest request) {
+    return pImpl_->submit(std::move(request));
+}
+
+} // namespace gaia
+} // namespace ioc
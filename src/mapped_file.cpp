@@ -0,0 +1,87 @@
+#include "ioc_gaialib/mapped_file.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace ioc {
+namespace gaia {
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : fd_(std::exchange(other.fd_, -1)),
+      data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        fd_ = std::exchange(other.fd_, -1);
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    const size_t size = static_cast<size_t>(st.st_size);
+    if (size > 0) {
+        void* addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        data_ = static_cast<const uint8_t*>(addr);
+    }
+
+    fd_ = fd;
+    size_ = size;
+    return true;
+}
+
+void MappedFile::advise(Advice advice) const {
+    if (data_ == nullptr) {
+        return;
+    }
+    int posix_advice = POSIX_MADV_NORMAL;
+    switch (advice) {
+        case Advice::Normal:     posix_advice = POSIX_MADV_NORMAL; break;
+        case Advice::Sequential: posix_advice = POSIX_MADV_SEQUENTIAL; break;
+        case Advice::Random:     posix_advice = POSIX_MADV_RANDOM; break;
+        case Advice::WillNeed:   posix_advice = POSIX_MADV_WILLNEED; break;
+    }
+    // Advisory only: failure leaves the default paging behaviour
+    ::posix_madvise(const_cast<uint8_t*>(data_), size_, posix_advice);
+}
+
+void MappedFile::close() {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+        data_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+}
+
+} // namespace gaia
+} // namespace ioc
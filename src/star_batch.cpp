@@ -0,0 +1,120 @@
+#include "ioc_gaialib/star_batch.h"
+
+namespace ioc::gaia {
+
+void StarBatch::reserve(size_t n) {
+    source_id.reserve(n);
+    for (auto* column : {&ra, &dec, &parallax, &pmra, &pmdec, &phot_g_mean_mag,
+                         &phot_bp_mean_mag, &phot_rp_mean_mag, &bp_rp, &ruwe}) {
+        column->reserve(n);
+    }
+}
+
+void StarBatch::clear() {
+    source_id.clear();
+    for (auto* column : {&ra, &dec, &parallax, &pmra, &pmdec, &phot_g_mean_mag,
+                         &phot_bp_mean_mag, &phot_rp_mean_mag, &bp_rp, &ruwe}) {
+        column->clear();
+    }
+}
+
+void StarBatch::truncate(size_t n) {
+    if (n >= size()) {
+        return;
+    }
+    source_id.resize(n);
+    for (auto* column : {&ra, &dec, &parallax, &pmra, &pmdec, &phot_g_mean_mag,
+                         &phot_bp_mean_mag, &phot_rp_mean_mag, &bp_rp, &ruwe}) {
+        column->resize(n);
+    }
+}
+
+void StarBatch::retain(const std::vector<uint8_t>& keep) {
+    size_t out = 0;
+    for (size_t i = 0; i < size(); ++i) {
+        if (!keep[i]) {
+            continue;
+        }
+        if (out != i) {
+            source_id[out] = source_id[i];
+            for (auto* column : {&ra, &dec, &parallax, &pmra, &pmdec, &phot_g_mean_mag,
+                                 &phot_bp_mean_mag, &phot_rp_mean_mag, &bp_rp, &ruwe}) {
+                (*column)[out] = (*column)[i];
+            }
+        }
+        ++out;
+    }
+    truncate(out);
+}
+
+void StarBatch::push_back(int64_t id, double ra_deg, double dec_deg, double plx,
+                          double pm_ra, double pm_dec, double g_mag, double bp_mag,
+                          double rp_mag, double color, double ruwe_value) {
+    source_id.push_back(id);
+    ra.push_back(ra_deg);
+    dec.push_back(dec_deg);
+    parallax.push_back(plx);
+    pmra.push_back(pm_ra);
+    pmdec.push_back(pm_dec);
+    phot_g_mean_mag.push_back(g_mag);
+    phot_bp_mean_mag.push_back(bp_mag);
+    phot_rp_mean_mag.push_back(rp_mag);
+    bp_rp.push_back(color);
+    ruwe.push_back(ruwe_value);
+}
+
+void StarBatch::push_back(const GaiaStar& star) {
+    push_back(star.source_id, star.ra, star.dec, star.parallax, star.pmra, star.pmdec,
+              star.phot_g_mean_mag, star.phot_bp_mean_mag, star.phot_rp_mean_mag,
+              star.bp_rp, star.ruwe);
+}
+
+void StarBatch::append(const StarBatch& other) {
+    source_id.insert(source_id.end(), other.source_id.begin(), other.source_id.end());
+    ra.insert(ra.end(), other.ra.begin(), other.ra.end());
+    dec.insert(dec.end(), other.dec.begin(), other.dec.end());
+    parallax.insert(parallax.end(), other.parallax.begin(), other.parallax.end());
+    pmra.insert(pmra.end(), other.pmra.begin(), other.pmra.end());
+    pmdec.insert(pmdec.end(), other.pmdec.begin(), other.pmdec.end());
+    phot_g_mean_mag.insert(phot_g_mean_mag.end(), other.phot_g_mean_mag.begin(), other.phot_g_mean_mag.end());
+    phot_bp_mean_mag.insert(phot_bp_mean_mag.end(), other.phot_bp_mean_mag.begin(), other.phot_bp_mean_mag.end());
+    phot_rp_mean_mag.insert(phot_rp_mean_mag.end(), other.phot_rp_mean_mag.begin(), other.phot_rp_mean_mag.end());
+    bp_rp.insert(bp_rp.end(), other.bp_rp.begin(), other.bp_rp.end());
+    ruwe.insert(ruwe.end(), other.ruwe.begin(), other.ruwe.end());
+}
+
+GaiaStar StarBatch::toGaiaStar(size_t i) const {
+    GaiaStar star;
+    star.source_id = source_id[i];
+    star.ra = ra[i];
+    star.dec = dec[i];
+    star.parallax = parallax[i];
+    star.pmra = pmra[i];
+    star.pmdec = pmdec[i];
+    star.phot_g_mean_mag = phot_g_mean_mag[i];
+    star.phot_bp_mean_mag = phot_bp_mean_mag[i];
+    star.phot_rp_mean_mag = phot_rp_mean_mag[i];
+    star.bp_rp = bp_rp[i];
+    star.ruwe = ruwe[i];
+    return star;
+}
+
+std::vector<GaiaStar> StarBatch::toGaiaStars() const {
+    std::vector<GaiaStar> stars;
+    stars.reserve(size());
+    for (size_t i = 0; i < size(); ++i) {
+        stars.push_back(toGaiaStar(i));
+    }
+    return stars;
+}
+
+StarBatch StarBatch::fromGaiaStars(const std::vector<GaiaStar>& stars) {
+    StarBatch batch;
+    batch.reserve(stars.size());
+    for (const auto& star : stars) {
+        batch.push_back(star);
+    }
+    return batch;
+}
+
+} // namespace ioc::gaia
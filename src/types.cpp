@@ -3,6 +3,7 @@
 #include <iomanip>
 #include <cmath>
 #include <vector>
+#include <algorithm>
 
 namespace ioc {
 namespace gaia {
@@ -209,6 +210,32 @@ bool isValidBoxRegion(const BoxRegion& box) {
     return true;
 }
 
+// =============================================================================
+// Query filters
+// =============================================================================
+
+namespace {
+
+StarFilter tightenFilter(StarFilter filter, double max_magnitude, double min_parallax) {
+    if (max_magnitude > 0) {
+        filter.max_magnitude = std::min(filter.max_magnitude, max_magnitude);
+    }
+    if (min_parallax >= 0) {
+        filter.min_parallax = std::max(filter.min_parallax, min_parallax);
+    }
+    return filter;
+}
+
+} // namespace
+
+StarFilter QueryParams::starFilter() const {
+    return tightenFilter(filter, max_magnitude, min_parallax);
+}
+
+StarFilter CorridorQueryParams::starFilter() const {
+    return tightenFilter(filter, max_magnitude, min_parallax);
+}
+
 // =============================================================================
 // CorridorQueryParams Implementation
 // =============================================================================
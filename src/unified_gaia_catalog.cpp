@@ -1,5 +1,8 @@
 #include "ioc_gaialib/unified_gaia_catalog.h"
 #include "ioc_gaialib/concurrent_multifile_catalog_v2.h"
+#include "ioc_gaialib/corridor.h"
+#include "ioc_gaialib/brightest_selector.h"
+#include "ioc_gaialib/healpix.h"
 #include "ioc_gaialib/gaia_mag18_catalog.h"
 #include "ioc_gaialib/gaia_mag18_catalog_v2.h"
 #include "ioc_gaialib/gaia_client.h"
@@ -115,9 +118,11 @@ public:
     
     bool initializeMultiFile(const std::string& directory) {
         try {
-            multifile_catalog_ = std::make_unique<ConcurrentMultiFileCatalogV2>(
-                directory, config_.max_cached_chunks
-            );
+            MultiFileCatalogOptions options;
+            options.max_cached_chunks = config_.max_cached_chunks;
+            options.max_cache_bytes = config_.max_cache_mb * 1024 * 1024;
+            options.use_mmap = config_.use_mmap;
+            multifile_catalog_ = std::make_unique<ConcurrentMultiFileCatalogV2>(directory, options);
             return true;
         } catch (const std::exception& e) {
             std::cerr << "Failed to initialize multi-file catalog: " << e.what() << std::endl;
@@ -127,12 +132,17 @@ public:
     
     bool initializeCompressed(const std::string& file_path) {
         try {
-            // Try to open as V2 first
-            auto cat_v2 = std::make_unique<ioc::gaia::Mag18CatalogV2>(file_path);
-            if (cat_v2->getTotalStars() > 0) { // Simple check if loaded successfully
-                 compressed_catalog_v2_ = std::move(cat_v2);
-                 std::cout << "Loaded Gaia Compressed V2 catalog: " << file_path << std::endl;
-                 return true;
+            // Try to open as V2 first; its constructor throws on other formats
+            std::string v2_error;
+            try {
+                auto cat_v2 = std::make_unique<ioc::gaia::Mag18CatalogV2>(file_path);
+                if (cat_v2->getTotalStars() > 0) { // Simple check if loaded successfully
+                     compressed_catalog_v2_ = std::move(cat_v2);
+                     std::cout << "Loaded Gaia Compressed V2 catalog: " << file_path << std::endl;
+                     return true;
+                }
+            } catch (const std::exception& e) {
+                v2_error = e.what();
             }
             
             // Fallback to V1
@@ -141,7 +151,11 @@ public:
                 std::cout << "Loaded Gaia Compressed V1 catalog (no proper motions)" << std::endl;
                 return true;
             }
+            compressed_catalog_.reset();
             
+            if (!v2_error.empty()) {
+                std::cerr << "Failed to initialize compressed catalog: " << v2_error << std::endl;
+            }
             return false;
         } catch (const std::exception& e) {
             std::cerr << "Failed to initialize compressed catalog: " << e.what() << std::endl;
@@ -178,38 +192,28 @@ public:
         total_queries_++;
         
         std::vector<GaiaStar> results;
+        const StarFilter filter = params.starFilter();
         
         try {
             switch (config_.catalog_type) {
                 case GaiaCatalogConfig::CatalogType::MULTIFILE_V2:
                     if (multifile_catalog_) {
                         results = multifile_catalog_->queryCone(
-                            params.ra_center, params.dec_center, params.radius
+                            params.ra_center, params.dec_center, params.radius, filter
                         );
                     }
                     break;
                     
                 case GaiaCatalogConfig::CatalogType::COMPRESSED_V2:
                     if (compressed_catalog_v2_) {
-                         results = compressed_catalog_v2_->queryCone(
-                            params.ra_center, params.dec_center, params.radius,
-                             // Map limiting magnitude if set (primitive optimization)
-                            0 
+                        results = compressed_catalog_v2_->queryCone(
+                            params.ra_center, params.dec_center, params.radius, filter
                         );
-                        // Apply magnitude filter manually if needed, or V2 might support it
-                        if (params.max_magnitude < 21.0) {
-                             results.erase(
-                                std::remove_if(results.begin(), results.end(),
-                                    [&](const GaiaStar& star) {
-                                        return star.phot_g_mean_mag > params.max_magnitude;
-                                    }),
-                                results.end()
-                            );
-                        }
                     } else if (compressed_catalog_) {
                         results = compressed_catalog_->queryCone(
                             params.ra_center, params.dec_center, params.radius
                         );
+                        applyFilters(results, filter);
                     }
                     break;
                     
@@ -219,14 +223,14 @@ public:
                             params.ra_center, params.dec_center, params.radius,
                             params.max_magnitude
                         );
+                        applyFilters(results, filter);
                     }
                     break;
                     
                 case GaiaCatalogConfig::CatalogType::SQLITE_DR3:
                     if (sqlite_catalog_) {
                         results = sqlite_catalog_->queryCone(
-                            params.ra_center, params.dec_center, params.radius,
-                            params.max_magnitude
+                            params.ra_center, params.dec_center, params.radius, filter
                         );
                     }
                     break;
@@ -236,28 +240,6 @@ public:
                     throw std::runtime_error("VizieR support not yet implemented");
                     break;
             }
-            
-            // Apply additional filters
-            if (params.max_magnitude > 0) {
-                results.erase(
-                    std::remove_if(results.begin(), results.end(),
-                        [&](const GaiaStar& star) {
-                            return star.phot_g_mean_mag > params.max_magnitude;
-                        }),
-                    results.end()
-                );
-            }
-            
-            if (params.min_parallax >= 0) {
-                results.erase(
-                    std::remove_if(results.begin(), results.end(),
-                        [&](const GaiaStar& star) {
-                            return star.parallax < params.min_parallax;
-                        }),
-                    results.end()
-                );
-            }
-            
         } catch (const std::exception& e) {
             std::cerr << "Query failed: " << e.what() << std::endl;
         }
@@ -276,6 +258,298 @@ public:
         return results;
     }
     
+    // Statistics for one query answered outside performQuery
+    void recordQuery(std::chrono::high_resolution_clock::time_point start_time, size_t stars) {
+        total_queries_++;
+        auto end_time = std::chrono::high_resolution_clock::now();
+        double duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+        double old_time = total_query_time_.load();
+        while (!total_query_time_.compare_exchange_weak(old_time, old_time + duration_ms)) {
+        }
+        total_stars_returned_ += stars;
+    }
+    
+    StarBatch performColumnQuery(const QueryParams& params) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        StarBatch batch;
+        if (config_.catalog_type == GaiaCatalogConfig::CatalogType::MULTIFILE_V2 && multifile_catalog_) {
+            batch = multifile_catalog_->queryConeColumns(
+                params.ra_center, params.dec_center, params.radius, params.starFilter());
+        } else if (config_.catalog_type == GaiaCatalogConfig::CatalogType::COMPRESSED_V2 && compressed_catalog_v2_) {
+            batch = compressed_catalog_v2_->queryConeColumns(
+                params.ra_center, params.dec_center, params.radius, params.starFilter());
+        } else {
+            // No columnar path: convert the regular result (already filtered and counted)
+            return StarBatch::fromGaiaStars(performQuery(params));
+        }
+        
+        recordQuery(start_time, batch.size());
+        return batch;
+    }
+    
+    std::vector<GaiaStar> performBrightest(const QueryParams& params, size_t num_stars) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        const StarFilter filter = params.starFilter();
+        std::vector<GaiaStar> results;
+        
+        if (config_.catalog_type == GaiaCatalogConfig::CatalogType::MULTIFILE_V2 && multifile_catalog_) {
+            results = multifile_catalog_->queryBrightest(
+                params.ra_center, params.dec_center, params.radius, num_stars, filter);
+        } else if (config_.catalog_type == GaiaCatalogConfig::CatalogType::COMPRESSED_V2 && compressed_catalog_v2_) {
+            results = compressed_catalog_v2_->queryBrightest(
+                params.ra_center, params.dec_center, params.radius, num_stars, filter);
+        } else if (config_.catalog_type == GaiaCatalogConfig::CatalogType::SQLITE_DR3 && sqlite_catalog_) {
+            results = sqlite_catalog_->queryBrightest(
+                params.ra_center, params.dec_center, params.radius, num_stars, filter);
+        } else if (config_.catalog_type == GaiaCatalogConfig::CatalogType::COMPRESSED_V2 && compressed_catalog_ &&
+                   isMagnitudeCutOnly(filter) && filter.max_magnitude >= compressed_catalog_->getMagLimit()) {
+            // V1 streams through a bounded heap but takes no filter: only
+            // when the filter keeps every star of the catalog
+            results = compressed_catalog_->queryBrightest(
+                params.ra_center, params.dec_center, params.radius, num_stars);
+        } else {
+            // No streaming path: select from the regular result (already counted)
+            BrightestSelector<size_t> best(num_stars);
+            std::vector<GaiaStar> stars = performQuery(params);
+            for (size_t i = 0; i < stars.size(); ++i) {
+                best.offer(stars[i].phot_g_mean_mag, static_cast<uint64_t>(stars[i].source_id), i);
+            }
+            for (size_t i : best.take()) {
+                results.push_back(std::move(stars[i]));
+            }
+            return results;
+        }
+        
+        recordQuery(start_time, results.size());
+        return results;
+    }
+    
+    bool hasNearestEngine() const {
+        return (config_.catalog_type == GaiaCatalogConfig::CatalogType::MULTIFILE_V2 && multifile_catalog_) ||
+               (config_.catalog_type == GaiaCatalogConfig::CatalogType::COMPRESSED_V2 && compressed_catalog_v2_);
+    }
+    
+    std::vector<GaiaStar> performNearest(double ra, double dec, size_t k, double max_magnitude) {
+        StarFilter filter;
+        filter.max_magnitude = max_magnitude;
+        
+        if (hasNearestEngine()) {
+            auto start_time = std::chrono::high_resolution_clock::now();
+            std::vector<GaiaStar> results;
+            try {
+                results = multifile_catalog_ ? multifile_catalog_->queryNearest(ra, dec, k, filter)
+                                             : compressed_catalog_v2_->queryNearest(ra, dec, k, filter);
+            } catch (const std::exception& e) {
+                std::cerr << "Nearest query failed: " << e.what() << std::endl;
+            }
+            recordQuery(start_time, results.size());
+            return results;
+        }
+        
+        // Other backends: widen a cone until it holds k stars; the k
+        // closest within the radius are then the k closest overall
+        QueryParams params;
+        params.ra_center = ra;
+        params.dec_center = dec;
+        params.max_magnitude = std::isfinite(max_magnitude) ? max_magnitude : 21.0;  // Online ADQL needs a number
+        for (double radius = 0.25; ; radius *= 2.0) {
+            params.radius = std::min(radius, 180.0);
+            std::vector<GaiaStar> stars = performQuery(params);
+            if (stars.size() < k && radius < 180.0) {
+                continue;
+            }
+            BrightestSelector<size_t> nearest(k);  // Ranked by distance
+            for (size_t i = 0; i < stars.size(); ++i) {
+                nearest.offer(angularDistance({ra, dec}, {stars[i].ra, stars[i].dec}),
+                              static_cast<uint64_t>(stars[i].source_id), i);
+            }
+            std::vector<GaiaStar> results;
+            for (size_t i : nearest.take()) {
+                results.push_back(std::move(stars[i]));
+            }
+            return results;
+        }
+    }
+    
+    std::vector<std::vector<GaiaStar>> performNearestBatch(const std::vector<EquatorialCoordinates>& targets,
+                                                           size_t k, double max_magnitude) {
+        std::vector<std::vector<GaiaStar>> results(targets.size());
+        
+        // Answer targets in pixel order so neighbours reuse cached chunks
+        std::vector<std::pair<uint32_t, size_t>> order(targets.size());
+        for (size_t i = 0; i < targets.size(); ++i) {
+            order[i] = {healpix::radec2pixNest(256, targets[i].ra, targets[i].dec), i};
+        }
+        std::sort(order.begin(), order.end());
+        
+        const long num_targets = static_cast<long>(targets.size());
+        #pragma omp parallel for schedule(dynamic, 8) if(hasNearestEngine() && num_targets > 1)
+        for (long n = 0; n < num_targets; ++n) {
+            const size_t i = order[n].second;
+            results[i] = performNearest(targets[i].ra, targets[i].dec, k, max_magnitude);
+        }
+        return results;
+    }
+    
+    // Only a faint magnitude cut, as passed by the QueryParams defaults
+    static bool isMagnitudeCutOnly(const StarFilter& filter) {
+        return std::isinf(filter.min_magnitude) && !filter.hasParallaxLimit() &&
+               !filter.hasRuweLimit() && !filter.hasColorLimit() && !filter.hasProperMotionLimit();
+    }
+    
+    size_t performCount(const QueryParams& params) {
+        const StarFilter filter = params.starFilter();
+        if (isMagnitudeCutOnly(filter)) {
+            if (config_.catalog_type == GaiaCatalogConfig::CatalogType::MULTIFILE_V2 && multifile_catalog_) {
+                return multifile_catalog_->countInCone(
+                    params.ra_center, params.dec_center, params.radius, filter.max_magnitude);
+            }
+            if (config_.catalog_type == GaiaCatalogConfig::CatalogType::COMPRESSED_V2 && compressed_catalog_v2_ &&
+                filter.max_magnitude >= compressed_catalog_v2_->getMagLimit()) {
+                return compressed_catalog_v2_->countInCone(
+                    params.ra_center, params.dec_center, params.radius);
+            }
+        }
+        return performColumnQuery(params).size();
+    }
+    
+    void attachNames(GaiaStar& star) const {
+        if (!star_names_loaded_ || !star.common_name.empty()) {
+            return;
+        }
+        auto cross_match = star_names_.getCrossMatch(star.source_id);
+        if (cross_match.has_value()) {
+            if (star.sao_designation.empty()) star.sao_designation = cross_match->sao_designation;
+            if (star.hd_designation.empty()) star.hd_designation = cross_match->hd_designation;
+            if (star.hip_designation.empty()) star.hip_designation = cross_match->hip_designation;
+            if (star.tycho2_designation.empty()) star.tycho2_designation = cross_match->tycho2_designation;
+            if (star.common_name.empty()) star.common_name = cross_match->common_name;
+        }
+    }
+    
+    // For backends that cannot test the limits inside their scan
+    static void applyFilters(std::vector<GaiaStar>& results, const StarFilter& filter) {
+        if (!filter.isActive()) {
+            return;
+        }
+        results.erase(
+            std::remove_if(results.begin(), results.end(),
+                [&](const GaiaStar& star) { return !filter.accepts(star); }),
+            results.end()
+        );
+    }
+    
+    std::vector<std::vector<GaiaStar>> performBatchQuery(const std::vector<QueryParams>& param_list) {
+        if (config_.catalog_type == GaiaCatalogConfig::CatalogType::ONLINE_ESA && online_client_) {
+            return performOnlineBatchQuery(param_list);
+        }
+        
+        // Only the multi-file backend has a shared-work planner; other
+        // backends answer the cones one by one
+        if (config_.catalog_type != GaiaCatalogConfig::CatalogType::MULTIFILE_V2 || !multifile_catalog_) {
+            std::vector<std::vector<GaiaStar>> results;
+            results.reserve(param_list.size());
+            for (const auto& params : param_list) {
+                results.push_back(performQuery(params));
+            }
+            return results;
+        }
+        
+        auto start_time = std::chrono::high_resolution_clock::now();
+        total_queries_ += param_list.size();
+        
+        std::vector<std::vector<GaiaStar>> results;
+        size_t stars_returned = 0;
+        try {
+            results = multifile_catalog_->queryConeBatch(param_list);
+            for (const auto& cone_results : results) {
+                stars_returned += cone_results.size();
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Batch query failed: " << e.what() << std::endl;
+            results.assign(param_list.size(), {});
+        }
+        
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+        double duration_ms = duration.count();
+        
+        double old_time = total_query_time_.load();
+        while (!total_query_time_.compare_exchange_weak(old_time, old_time + duration_ms)) {
+            // Retry if another thread modified the value
+        }
+        total_stars_returned_ += stars_returned;
+        
+        return results;
+    }
+    
+    // All cones are submitted before the first answer is awaited, so they
+    // share the transport's connections instead of running back to back
+    std::vector<std::vector<GaiaStar>> performOnlineBatchQuery(const std::vector<QueryParams>& param_list) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        total_queries_ += param_list.size();
+        
+        std::vector<std::future<std::vector<GaiaStar>>> pending;
+        pending.reserve(param_list.size());
+        for (const auto& params : param_list) {
+            pending.push_back(online_client_->queryConeAsync(
+                params.ra_center, params.dec_center, params.radius, params.max_magnitude
+            ));
+        }
+        
+        std::vector<std::vector<GaiaStar>> results(param_list.size());
+        size_t stars_returned = 0;
+        for (size_t i = 0; i < pending.size(); ++i) {
+            try {
+                results[i] = pending[i].get();
+                applyFilters(results[i], param_list[i].starFilter());
+                stars_returned += results[i].size();
+            } catch (const std::exception& e) {
+                std::cerr << "Query failed: " << e.what() << std::endl;
+            }
+        }
+        
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+        double duration_ms = duration.count();
+        
+        double old_time = total_query_time_.load();
+        while (!total_query_time_.compare_exchange_weak(old_time, old_time + duration_ms)) {
+            // Retry if another thread modified the value
+        }
+        total_stars_returned_ += stars_returned;
+        
+        return results;
+    }
+    
+    bool hasCorridorEngine() const {
+        return config_.catalog_type == GaiaCatalogConfig::CatalogType::MULTIFILE_V2 && multifile_catalog_;
+    }
+    
+    std::vector<GaiaStar> performCorridorQuery(const CorridorQueryParams& params) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        total_queries_++;
+        
+        std::vector<GaiaStar> results;
+        try {
+            results = multifile_catalog_->queryCorridor(params);
+        } catch (const std::exception& e) {
+            std::cerr << "Corridor query failed: " << e.what() << std::endl;
+        }
+        
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+        double duration_ms = duration.count();
+        
+        double old_time = total_query_time_.load();
+        while (!total_query_time_.compare_exchange_weak(old_time, old_time + duration_ms)) {
+            // Retry if another thread modified the value
+        }
+        total_stars_returned_ += results.size();
+        
+        return results;
+    }
+    
     std::optional<GaiaStar> queryBySourceId(uint64_t source_id) {
         std::optional<GaiaStar> result;
         if (config_.catalog_type == GaiaCatalogConfig::CatalogType::SQLITE_DR3 && sqlite_catalog_) {
@@ -286,16 +560,7 @@ public:
 
         if (result.has_value()) {
             // Fallback to internal star names if the catalog didn't provide them
-            if (star_names_loaded_ && result->common_name.empty()) {
-                auto cross_match = star_names_.getCrossMatch(source_id);
-                if (cross_match.has_value()) {
-                    if (result->sao_designation.empty()) result->sao_designation = cross_match->sao_designation;
-                    if (result->hd_designation.empty()) result->hd_designation = cross_match->hd_designation;
-                    if (result->hip_designation.empty()) result->hip_designation = cross_match->hip_designation;
-                    if (result->tycho2_designation.empty()) result->tycho2_designation = cross_match->tycho2_designation;
-                    if (result->common_name.empty()) result->common_name = cross_match->common_name;
-                }
-            }
+            attachNames(*result);
         }
         return result;
     }
@@ -332,6 +597,66 @@ public:
         return std::nullopt;
     }
     
+    std::vector<std::optional<GaiaStar>> queryBySourceIds(const std::vector<uint64_t>& source_ids) {
+        std::vector<std::optional<GaiaStar>> results;
+        if (config_.catalog_type == GaiaCatalogConfig::CatalogType::SQLITE_DR3 && sqlite_catalog_) {
+            results = sqlite_catalog_->queryBySourceIds(source_ids);
+        } else {
+            results.reserve(source_ids.size());
+            for (uint64_t source_id : source_ids) {
+                results.push_back(performSourceIdQuery(source_id));
+            }
+        }
+
+        for (auto& result : results) {
+            if (result.has_value()) {
+                attachNames(*result);
+            }
+        }
+        return results;
+    }
+    
+    std::vector<std::optional<GaiaStar>> queryByCatalogDesignations(const std::string& catalog_type,
+                                                                    const std::vector<std::string>& designations) {
+        std::vector<std::optional<GaiaStar>> results(designations.size());
+        if (config_.catalog_type == GaiaCatalogConfig::CatalogType::SQLITE_DR3 && sqlite_catalog_) {
+            results = sqlite_catalog_->queryByDesignations(catalog_type, designations);
+        }
+        if (!star_names_loaded_) {
+            return results;
+        }
+        
+        // Designations the database did not resolve go through the cross-match
+        // table, then one batched source_id lookup
+        std::vector<size_t> positions;
+        std::vector<uint64_t> source_ids;
+        for (size_t i = 0; i < designations.size(); ++i) {
+            if (results[i]) continue;
+            std::optional<uint64_t> source_id;
+            if (catalog_type == "SAO") {
+                source_id = star_names_.findBySAO(designations[i]);
+            } else if (catalog_type == "HD") {
+                source_id = star_names_.findByHD(designations[i]);
+            } else if (catalog_type == "HIP") {
+                source_id = star_names_.findByHipparcos(designations[i]);
+            } else if (catalog_type == "TYC") {
+                source_id = star_names_.findByTycho2(designations[i]);
+            } else if (catalog_type == "NAME") {
+                source_id = star_names_.findByName(designations[i]);
+            }
+            if (source_id.has_value()) {
+                positions.push_back(i);
+                source_ids.push_back(source_id.value());
+            }
+        }
+        
+        auto found = queryBySourceIds(source_ids);
+        for (size_t j = 0; j < positions.size(); ++j) {
+            results[positions[j]] = std::move(found[j]);
+        }
+        return results;
+    }
+    
     std::optional<GaiaStar> queryByCatalogDesignation(const std::string& catalog_type, const std::string& designation) {
         if (config_.catalog_type == GaiaCatalogConfig::CatalogType::SQLITE_DR3 && sqlite_catalog_) {
             auto result = sqlite_catalog_->queryByDesignation(catalog_type, designation);
@@ -422,6 +747,14 @@ bool UnifiedGaiaCatalog::initialize(const std::string& json_config) {
                 impl.config_.max_cached_chunks = std::stoull(config_map["max_cached_chunks"]);
             }
             
+            if (config_map.find("max_cache_mb") != config_map.end()) {
+                impl.config_.max_cache_mb = std::stoull(config_map["max_cache_mb"]);
+            }
+            
+            if (config_map.find("use_mmap") != config_map.end()) {
+                impl.config_.use_mmap = (config_map["use_mmap"] == "true");
+            }
+            
             if (!impl.initializeMultiFile(impl.config_.multifile_directory)) {
                 return false;
             }
@@ -547,6 +880,56 @@ std::vector<GaiaStar> UnifiedGaiaCatalog::queryCone(const QueryParams& params) c
     return pimpl_->performQuery(params);
 }
 
+StarBatch UnifiedGaiaCatalog::queryConeColumns(const QueryParams& params) const {
+    if (!pimpl_) {
+        throw std::runtime_error("Catalog not initialized");
+    }
+    return pimpl_->performColumnQuery(params);
+}
+
+std::vector<GaiaStar> UnifiedGaiaCatalog::queryBrightest(const QueryParams& params, size_t num_stars) const {
+    if (!pimpl_) {
+        throw std::runtime_error("Catalog not initialized");
+    }
+    return pimpl_->performBrightest(params, num_stars);
+}
+
+std::vector<GaiaStar> UnifiedGaiaCatalog::queryNearest(double ra, double dec, size_t k,
+                                                       double max_magnitude) const {
+    if (!pimpl_) {
+        throw std::runtime_error("Catalog not initialized");
+    }
+    return pimpl_->performNearest(ra, dec, k, max_magnitude);
+}
+
+std::vector<std::vector<GaiaStar>> UnifiedGaiaCatalog::queryNearestBatch(
+    const std::vector<EquatorialCoordinates>& targets, size_t k, double max_magnitude) const {
+    if (!pimpl_) {
+        throw std::runtime_error("Catalog not initialized");
+    }
+    return pimpl_->performNearestBatch(targets, k, max_magnitude);
+}
+
+size_t UnifiedGaiaCatalog::countInCone(const QueryParams& params) const {
+    if (!pimpl_) {
+        throw std::runtime_error("Catalog not initialized");
+    }
+    return pimpl_->performCount(params);
+}
+
+std::vector<GaiaStar> UnifiedGaiaCatalog::toGaiaStars(const StarBatch& batch, bool with_names) const {
+    if (!pimpl_) {
+        throw std::runtime_error("Catalog not initialized");
+    }
+    std::vector<GaiaStar> stars = batch.toGaiaStars();
+    if (with_names) {
+        for (auto& star : stars) {
+            pimpl_->attachNames(star);
+        }
+    }
+    return stars;
+}
+
 std::future<std::vector<GaiaStar>> UnifiedGaiaCatalog::queryAsync(
     const QueryParams& params,
     ProgressCallback progress_callback
@@ -569,14 +952,10 @@ std::future<std::vector<GaiaStar>> UnifiedGaiaCatalog::queryAsync(
 std::vector<std::vector<GaiaStar>> UnifiedGaiaCatalog::batchQuery(
     const std::vector<QueryParams>& param_list
 ) const {
-    std::vector<std::vector<GaiaStar>> results;
-    results.reserve(param_list.size());
-    
-    for (const auto& params : param_list) {
-        results.push_back(queryCone(params));
+    if (!pimpl_) {
+        throw std::runtime_error("Catalog not initialized");
     }
-    
-    return results;
+    return pimpl_->performBatchQuery(param_list);
 }
 
 std::optional<GaiaStar> UnifiedGaiaCatalog::queryBySourceId(uint64_t source_id) const {
@@ -621,96 +1000,29 @@ std::optional<GaiaStar> UnifiedGaiaCatalog::queryByName(const std::string& commo
     return pimpl_->queryByCatalogDesignation("NAME", common_name);
 }
 
-// =============================================================================
-// Corridor Query Implementation
-// =============================================================================
-
-namespace {
-    // Calculate distance from a point to a line segment on a sphere
-    // Uses the cross-track distance formula
-    double pointToSegmentDistance(double point_ra, double point_dec,
-                                   double seg_start_ra, double seg_start_dec,
-                                   double seg_end_ra, double seg_end_dec) {
-        constexpr double DEG_TO_RAD = M_PI / 180.0;
-        
-        // Convert to radians
-        double p_ra = point_ra * DEG_TO_RAD;
-        double p_dec = point_dec * DEG_TO_RAD;
-        double s_ra = seg_start_ra * DEG_TO_RAD;
-        double s_dec = seg_start_dec * DEG_TO_RAD;
-        double e_ra = seg_end_ra * DEG_TO_RAD;
-        double e_dec = seg_end_dec * DEG_TO_RAD;
-        
-        // Angular distance from start to point
-        double d_sp = std::acos(
-            std::sin(s_dec) * std::sin(p_dec) +
-            std::cos(s_dec) * std::cos(p_dec) * std::cos(p_ra - s_ra)
-        );
-        
-        // Angular distance from start to end
-        double d_se = std::acos(
-            std::sin(s_dec) * std::sin(e_dec) +
-            std::cos(s_dec) * std::cos(e_dec) * std::cos(e_ra - s_ra)
-        );
-        
-        // If segment has zero length, return distance to start point
-        if (d_se < 1e-10) {
-            return d_sp / DEG_TO_RAD;
-        }
-        
-        // Bearing from start to end
-        double theta_se = std::atan2(
-            std::sin(e_ra - s_ra) * std::cos(e_dec),
-            std::cos(s_dec) * std::sin(e_dec) - std::sin(s_dec) * std::cos(e_dec) * std::cos(e_ra - s_ra)
-        );
-        
-        // Bearing from start to point
-        double theta_sp = std::atan2(
-            std::sin(p_ra - s_ra) * std::cos(p_dec),
-            std::cos(s_dec) * std::sin(p_dec) - std::sin(s_dec) * std::cos(p_dec) * std::cos(p_ra - s_ra)
-        );
-        
-        // Cross-track distance (perpendicular distance to great circle)
-        double dxt = std::asin(std::sin(d_sp) * std::sin(theta_sp - theta_se));
-        
-        // Along-track distance (how far along the segment)
-        double dat = std::acos(std::cos(d_sp) / std::cos(dxt));
-        
-        // Check if the closest point is within the segment
-        if (dat > d_se) {
-            // Closest point is past the end - return distance to end
-            double d_pe = std::acos(
-                std::sin(e_dec) * std::sin(p_dec) +
-                std::cos(e_dec) * std::cos(p_dec) * std::cos(p_ra - e_ra)
-            );
-            return d_pe / DEG_TO_RAD;
-        } else if (dat < 0 || std::cos(theta_sp - theta_se) < 0) {
-            // Closest point is before the start - return distance to start
-            return d_sp / DEG_TO_RAD;
-        }
-        
-        // Return cross-track distance
-        return std::abs(dxt) / DEG_TO_RAD;
+std::vector<std::optional<GaiaStar>> UnifiedGaiaCatalog::queryBySourceIds(
+    const std::vector<uint64_t>& source_ids
+) const {
+    if (!pimpl_) {
+        throw std::runtime_error("Catalog not initialized");
     }
-    
-    // Calculate minimum distance from a point to a polyline
-    double pointToPolylineDistance(double ra, double dec, 
-                                    const std::vector<CelestialPoint>& path) {
-        double min_dist = std::numeric_limits<double>::max();
-        
-        for (size_t i = 0; i + 1 < path.size(); ++i) {
-            double dist = pointToSegmentDistance(
-                ra, dec,
-                path[i].ra, path[i].dec,
-                path[i+1].ra, path[i+1].dec
-            );
-            min_dist = std::min(min_dist, dist);
-        }
-        
-        return min_dist;
+    return pimpl_->queryBySourceIds(source_ids);
+}
+
+std::vector<std::optional<GaiaStar>> UnifiedGaiaCatalog::queryByDesignations(
+    const std::string& catalog,
+    const std::vector<std::string>& designations
+) const {
+    if (!pimpl_) {
+        throw std::runtime_error("Catalog not initialized");
     }
+    return pimpl_->queryByCatalogDesignations(catalog, designations);
 }
 
+// =============================================================================
+// Corridor Query Implementation
+// =============================================================================
+
 std::vector<GaiaStar> UnifiedGaiaCatalog::queryCorridor(const CorridorQueryParams& params) const {
     if (!pimpl_) {
         throw std::runtime_error("Catalog not initialized");
@@ -720,6 +1032,11 @@ std::vector<GaiaStar> UnifiedGaiaCatalog::queryCorridor(const CorridorQueryParam
         throw std::runtime_error("Invalid corridor query parameters");
     }
     
+    // The multi-file catalog scans the whole tube in one pass
+    if (pimpl_->hasCorridorEngine()) {
+        return pimpl_->performCorridorQuery(params);
+    }
+    
     std::vector<GaiaStar> results;
     std::set<uint64_t> seen_source_ids;  // Avoid duplicates
     
@@ -784,12 +1101,12 @@ std::vector<GaiaStar> UnifiedGaiaCatalog::queryCorridor(const CorridorQueryParam
         }
     }
     
-    // Execute batched queries
-    // We collect ALL candidates first, then filter.
-    // This allows using the batchQuery API if available, or just loop.
+    // Execute the cones as one batch, then filter candidates exactly
     std::cout << "Optimized Corridor: " << params.path.size() << " points -> " 
               << search_cones.size() << " query cones." << std::endl;
-              
+    
+    std::vector<QueryParams> cone_list;
+    cone_list.reserve(search_cones.size());
     for (const auto& cone : search_cones) {
         QueryParams cone_params;
         cone_params.ra_center = cone.ra;
@@ -797,21 +1114,18 @@ std::vector<GaiaStar> UnifiedGaiaCatalog::queryCorridor(const CorridorQueryParam
         cone_params.radius = cone.radius;
         cone_params.max_magnitude = params.max_magnitude;
         cone_params.min_parallax = params.min_parallax;
-        
-        // Perform query
-        // Note: In a real high-perf scenario, we would use batchQuery/async here
-        auto cone_results = pimpl_->performQuery(cone_params);
-        
+        cone_params.filter = params.filter;
+        cone_list.push_back(cone_params);
+    }
+    
+    const corridor::CorridorFilter filter(params.path, params.width);
+    for (const auto& cone_results : pimpl_->performBatchQuery(cone_list)) {
         // Accumulate and Filter
         for (const auto& star : cone_results) {
             if (seen_source_ids.count(star.source_id) > 0) continue;
             
             // Precise geometric check
-            // Only calculate expensive distance if star is roughly close
-            // (performQuery already did a coarse check via cone radius)
-            
-            double dist = pointToPolylineDistance(star.ra, star.dec, params.path);
-            if (dist <= params.width) {
+            if (filter.contains(star.ra, star.dec)) {
                 seen_source_ids.insert(star.source_id);
                 results.push_back(star);
                 
@@ -826,40 +1140,6 @@ std::vector<GaiaStar> UnifiedGaiaCatalog::queryCorridor(const CorridorQueryParam
 }
 
 
-
-namespace {
-    double evaluateChebyshev(double t, double t_start, double t_end, const std::vector<double>& coeffs) {
-        if (coeffs.empty()) return 0.0;
-        
-        // Normalize time to [-1, 1]
-        // Handle singularity if t_start == t_end
-        if (std::abs(t_end - t_start) < 1e-9) return coeffs[0];
-
-        double u = 2.0 * (t - t_start) / (t_end - t_start) - 1.0;
-        
-        // Clamping to handle potential floating point epsilon issues at boundaries
-        if (u < -1.0) u = -1.0;
-        if (u > 1.0) u = 1.0;
-        
-        double T_prev = 1.0;
-        double T_curr = u;
-        
-        double result = coeffs[0] * T_prev;
-        if (coeffs.size() > 1) {
-            result += coeffs[1] * T_curr;
-        }
-        
-        for (size_t k = 2; k < coeffs.size(); ++k) {
-            double T_next = 2.0 * u * T_curr - T_prev;
-            result += coeffs[k] * T_next;
-            T_prev = T_curr;
-            T_curr = T_next;
-        }
-        
-        return result;
-    }
-}
-
 std::vector<GaiaStar> UnifiedGaiaCatalog::queryOrbit(const OrbitQueryParams& params) const {
     if (!params.isValid()) {
         throw std::runtime_error("Invalid orbit query parameters");
@@ -872,65 +1152,11 @@ std::vector<GaiaStar> UnifiedGaiaCatalog::queryOrbit(const OrbitQueryParams& par
     corridor_params.min_parallax = -1.0; // Default
     corridor_params.max_results = 0; // Default
 
-    double step = params.step_size;
-    if (step <= 0) {
-        // Default sampling: 100 points across the interval
-        step = (params.t_end - params.t_start) / 100.0;
-        if (step <= 0) step = 1.0; // Should not happen given isValid check
-    }
-
-    // Sort polynomials by start time to optimize search (optional but good)
-    // We make a copy to sort
-    std::vector<ChebyshevPolynomial> sorted_polys = params.polynomials;
-    std::sort(sorted_polys.begin(), sorted_polys.end(), 
-        [](const ChebyshevPolynomial& a, const ChebyshevPolynomial& b) {
-            return a.t_start < b.t_start;
-        });
-
-    for (double t = params.t_start; t <= params.t_end; t += step) {
-        // Find valid polynomial
-        const ChebyshevPolynomial* active_poly = nullptr;
-        for (const auto& poly : sorted_polys) {
-            if (t >= poly.t_start && t <= poly.t_end) {
-                active_poly = &poly;
-                break;
-            }
-            // Optimization: if we passed the time, stop (since sorted)
-            if (poly.t_start > t) break; 
-        }
-
-        if (active_poly) {
-            // Evaluate RA/Dec
-            double ra = evaluateChebyshev(t, active_poly->t_start, active_poly->t_end, active_poly->coeffs_ra);
-            double dec = evaluateChebyshev(t, active_poly->t_start, active_poly->t_end, active_poly->coeffs_dec);
-            
-            corridor_params.path.emplace_back(ra, dec);
-        }
-    }
-    
-    // Ensure we process the exact end time if loop missed it
-    if (std::abs(params.t_end - params.t_start) > 1e-9) { // If not a point query
-         double t = params.t_end;
-         const ChebyshevPolynomial* active_poly = nullptr;
-         for (const auto& poly : sorted_polys) {
-             if (t >= poly.t_start && t <= poly.t_end) {
-                 active_poly = &poly;
-                 break;
-             }
-         }
-         
-         if (active_poly) {
-             double ra = evaluateChebyshev(t, active_poly->t_start, active_poly->t_end, active_poly->coeffs_ra);
-             double dec = evaluateChebyshev(t, active_poly->t_start, active_poly->t_end, active_poly->coeffs_dec);
-             
-             // Avoid duplicate if step landed exactly on end
-             if (corridor_params.path.empty() || 
-                 std::abs(corridor_params.path.back().ra - ra) > 1e-6 || 
-                 std::abs(corridor_params.path.back().dec - dec) > 1e-6) {
-                 corridor_params.path.emplace_back(ra, dec);
-             }
-         }
-    }
+    // Adaptive sampling: as few vertices as keep the path within
+    // path_tolerance * width of the orbit
+    const double tolerance_fraction = params.path_tolerance > 0 ? params.path_tolerance : 0.1;
+    corridor_params.path = corridor::sampleOrbit(params.polynomials, params.t_start, params.t_end,
+                                                 tolerance_fraction * params.width, params.step_size);
 
     if (corridor_params.path.size() < 2) {
          // Need at least 2 points for a corridor.
@@ -0,0 +1,155 @@
+/**
+ * @file bench_concurrent_cache.cpp
+ * @brief Chunk cache contention benchmark for ConcurrentMultiFileCatalogV2
+ * 
+ * Runs the same random cone-search workload with 1, 8, 32 and 64 threads
+ * against one shared catalog instance and reports throughput, latency
+ * percentiles and cache behaviour. The cache is kept smaller than the
+ * catalog so that cold chunk reads and cache hits interleave; a second
+ * pass with the whole catalog resident measures the pure read-hit path.
+ * 
+ * Usage: bench_concurrent_cache <catalog_dir> [queries_per_thread] [max_cached_chunks]
+ */
+
+#include "ioc_gaialib/concurrent_multifile_catalog_v2.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace ioc::gaia;
+
+namespace {
+
+void printHeader() {
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "queries" 
+              << std::setw(12) << "wall [s]" << std::setw(12) << "q/s"
+              << std::setw(12) << "p50 [ms]" << std::setw(12) << "p99 [ms]"
+              << std::setw(10) << "misses" << std::setw(10) << "hit %" << "\n";
+}
+
+// Random cone workload; one table row per call
+void runWorkload(ConcurrentMultiFileCatalogV2& catalog, int num_threads, size_t queries_per_thread) {
+    auto stats_before = catalog.getStats();
+    
+    std::vector<std::vector<double>> latencies(num_threads);
+    std::vector<std::thread> threads;
+    
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            // Same seed per thread index: every run replays the same queries
+            std::mt19937_64 rng(1000 + t);
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+            latencies[t].reserve(queries_per_thread);
+            
+            for (size_t q = 0; q < queries_per_thread; ++q) {
+                double ra = uniform(rng) * 360.0;
+                double dec = std::asin(2.0 * uniform(rng) - 1.0) * 180.0 / M_PI;
+                double radius = 0.1 + uniform(rng) * 0.9;
+                
+                auto q_start = std::chrono::steady_clock::now();
+                auto stars = catalog.queryCone(ra, dec, radius);
+                auto q_end = std::chrono::steady_clock::now();
+                latencies[t].push_back(
+                    std::chrono::duration<double, std::milli>(q_end - q_start).count());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    std::vector<double> all;
+    for (const auto& l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p) {
+        return all.empty() ? 0.0 : all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))];
+    };
+    
+    auto stats = catalog.getStats();
+    size_t hits = stats.cache_hits - stats_before.cache_hits;
+    size_t misses = stats.cache_misses - stats_before.cache_misses;
+    double hit_rate = (hits + misses) > 0 ? 100.0 * hits / (hits + misses) : 0.0;
+    
+    std::cout << std::fixed << std::setprecision(2)
+              << std::setw(8) << num_threads << std::setw(12) << all.size()
+              << std::setw(12) << wall << std::setw(12) << (all.size() / wall)
+              << std::setw(12) << percentile(0.50) << std::setw(12) << percentile(0.99)
+              << std::setw(10) << misses << std::setw(10) << std::setprecision(1) << hit_rate << "\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <catalog_directory> [queries_per_thread] [max_cached_chunks]\n";
+        return 1;
+    }
+    
+    std::string catalog_dir = argv[1];
+    const size_t queries_per_thread = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+    size_t max_cached = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 0;
+    
+    std::unique_ptr<ConcurrentMultiFileCatalogV2> catalog;
+    try {
+        catalog = std::make_unique<ConcurrentMultiFileCatalogV2>(catalog_dir, 
+            max_cached > 0 ? max_cached : 50);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    const size_t num_chunks = catalog->getNumChunks();
+    if (max_cached == 0) {
+        // Default: a quarter of the catalog, so the workload keeps missing
+        max_cached = std::max<size_t>(1, num_chunks / 4);
+        catalog = std::make_unique<ConcurrentMultiFileCatalogV2>(catalog_dir, max_cached);
+    }
+    
+    std::cout << "=== Concurrent Chunk Cache Benchmark ===\n\n";
+    std::cout << "Catalog: " << catalog_dir << "\n";
+    std::cout << "Chunks: " << num_chunks << ", cache: " << max_cached << " chunks\n";
+    std::cout << "Queries per thread: " << queries_per_thread << "\n\n";
+    
+    std::cout << "Cold cache (loads and hits interleaved):\n";
+    printHeader();
+    for (int num_threads : {1, 8, 32, 64}) {
+        catalog->clearCache();
+        runWorkload(*catalog, num_threads, queries_per_thread);
+    }
+    
+    // Whole catalog resident: pure read-hit path, should scale with cores
+    MultiFileCatalogOptions warm_options;
+    warm_options.max_cached_chunks = num_chunks + 1;
+    ConcurrentMultiFileCatalogV2 warm(catalog_dir, warm_options);
+    std::vector<uint64_t> all_chunks(num_chunks);
+    for (uint64_t i = 0; i < num_chunks; ++i) all_chunks[i] = i;
+    warm.preloadChunks(all_chunks);
+    
+    std::cout << "\nWarm cache (all hits):\n";
+    printHeader();
+    for (int num_threads : {1, 8, 32, 64}) {
+        runWorkload(warm, num_threads, queries_per_thread);
+    }
+    
+    std::cout << "\nPer-shard counters (warm cache):\n";
+    std::cout << std::setw(8) << "shard" << std::setw(12) << "hits" << std::setw(10) << "misses"
+              << std::setw(12) << "evictions" << std::setw(10) << "chunks" << std::setw(12) << "MB" << "\n";
+    auto shard_stats = warm.getShardStats();
+    for (size_t i = 0; i < shard_stats.size(); ++i) {
+        const auto& shard = shard_stats[i];
+        std::cout << std::setw(8) << i << std::setw(12) << shard.hits << std::setw(10) << shard.misses
+                  << std::setw(12) << shard.evictions << std::setw(10) << shard.chunks
+                  << std::setw(12) << (shard.bytes / (1024 * 1024)) << "\n";
+    }
+    
+    return 0;
+}
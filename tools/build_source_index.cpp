@@ -0,0 +1,211 @@
+/**
+ * @file build_source_index.cpp
+ * @brief Builds the source_id sidecar index for a multifile catalog
+ * 
+ * Scans all chunks and writes source_index.dat next to metadata.dat so
+ * that ConcurrentMultiFileCatalogV2::queryBySourceId touches at most one
+ * chunk per lookup. When every chunk is sorted by source_id and the chunk
+ * ranges are disjoint and increasing, only the per-chunk min/max fences
+ * are written (16 bytes per chunk); otherwise a sorted
+ * (source_id, chunk, offset) array follows the fences.
+ * 
+ * Usage: build_source_index <catalog_dir> [--full]
+ *   --full  Always write the (source_id, chunk, offset) array
+ */
+
+#include "ioc_gaialib/gaia_mag18_catalog_v2.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <iomanip>
+#include <limits>
+#include <algorithm>
+
+using namespace ioc::gaia;
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <catalog_directory> [--full]\n";
+        std::cerr << "Example: " << argv[0] << " ~/.catalog/gaia_mag18_v2_multifile\n";
+        return 1;
+    }
+    
+    std::string catalog_dir = argv[1];
+    bool force_full = (argc > 2 && std::strcmp(argv[2], "--full") == 0);
+    std::string metadata_path = catalog_dir + "/metadata.dat";
+    std::string chunks_dir = catalog_dir + "/chunks";
+    
+    std::cout << "=== Source ID Index Builder ===\n\n";
+    std::cout << "Catalog: " << catalog_dir << "\n";
+    
+    std::ifstream meta_in(metadata_path, std::ios::binary);
+    if (!meta_in) {
+        std::cerr << "Cannot open metadata file: " << metadata_path << "\n";
+        return 1;
+    }
+    
+    Mag18CatalogHeaderV2 header;
+    meta_in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!meta_in) {
+        std::cerr << "Failed to read catalog header\n";
+        return 1;
+    }
+    meta_in.close();
+    
+    std::cout << "Total stars: " << header.total_stars << "\n";
+    std::cout << "Total chunks: " << header.total_chunks << "\n\n";
+    
+    std::vector<SourceIdFence> fences(header.total_chunks);
+    std::vector<SourceIdEntry> entries;
+    
+    // Reads one chunk file; false (after reporting) on failure
+    auto readChunk = [&](uint32_t chunk_id, std::vector<Mag18RecordV2>& records) {
+        char chunk_name[32];
+        snprintf(chunk_name, sizeof(chunk_name), "/chunk_%03u.dat", chunk_id);
+        std::string chunk_path = chunks_dir + chunk_name;
+        
+        std::ifstream chunk_file(chunk_path, std::ios::binary);
+        if (!chunk_file) {
+            std::cerr << "\nCannot open chunk: " << chunk_path << "\n";
+            return false;
+        }
+        
+        chunk_file.seekg(0, std::ios::end);
+        size_t file_size = chunk_file.tellg();
+        size_t num_records = file_size / sizeof(Mag18RecordV2);
+        chunk_file.seekg(0);
+        
+        records.resize(num_records);
+        chunk_file.read(reinterpret_cast<char*>(records.data()), 
+                        num_records * sizeof(Mag18RecordV2));
+        if (!chunk_file) {
+            std::cerr << "\nFailed to read chunk: " << chunk_path << "\n";
+            return false;
+        }
+        return true;
+    };
+    
+    // Entries are buffered only when they will be written: with --full from
+    // the start, otherwise by a second pass once the chunks turn out to be
+    // unsorted or overlapping (the normal fence-only case never holds them)
+    auto appendEntries = [&](uint32_t chunk_id, const std::vector<Mag18RecordV2>& records) {
+        for (size_t i = 0; i < records.size(); ++i) {
+            entries.push_back({records[i].source_id, chunk_id, static_cast<uint32_t>(i)});
+        }
+    };
+    if (force_full) {
+        entries.reserve(header.total_stars);
+    }
+    
+    bool sorted_and_disjoint = true;
+    uint64_t total_processed = 0;
+    auto start_time = std::chrono::steady_clock::now();
+    std::vector<Mag18RecordV2> records;
+    
+    for (uint32_t chunk_id = 0; chunk_id < header.total_chunks; ++chunk_id) {
+        if (!readChunk(chunk_id, records)) {
+            return 1;
+        }
+        
+        SourceIdFence& fence = fences[chunk_id];
+        fence.min_source_id = std::numeric_limits<uint64_t>::max();
+        fence.max_source_id = 0;
+        
+        for (size_t i = 0; i < records.size(); ++i) {
+            const uint64_t id = records[i].source_id;
+            fence.min_source_id = std::min(fence.min_source_id, id);
+            fence.max_source_id = std::max(fence.max_source_id, id);
+            if (i > 0 && id <= records[i - 1].source_id) {
+                sorted_and_disjoint = false;
+            }
+        }
+        if (force_full) {
+            appendEntries(chunk_id, records);
+        }
+        
+        if (records.empty() ||
+            (chunk_id > 0 && fence.min_source_id <= fences[chunk_id - 1].max_source_id)) {
+            sorted_and_disjoint = false;
+        }
+        
+        total_processed += records.size();
+        
+        if ((chunk_id + 1) % 20 == 0 || chunk_id == header.total_chunks - 1) {
+            auto now = std::chrono::steady_clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
+            double progress = 100.0 * (chunk_id + 1) / header.total_chunks;
+            std::cout << "\rProcessed chunk " << (chunk_id + 1) << "/" << header.total_chunks 
+                      << " (" << std::fixed << std::setprecision(1) << progress << "%) "
+                      << total_processed << " stars, " << elapsed << "s" << std::flush;
+        }
+    }
+    std::cout << "\n\n";
+    
+    if (total_processed != header.total_stars) {
+        std::cerr << "Star count mismatch: header says " << header.total_stars 
+                  << ", chunks contain " << total_processed << "\n";
+        return 1;
+    }
+    
+    const bool fences_only = sorted_and_disjoint && !force_full;
+    if (fences_only) {
+        std::cout << "Chunks are sorted and disjoint: writing fence-only index\n";
+    } else {
+        if (!force_full) {
+            std::cout << "Chunks are unsorted or overlap: collecting entries...\n";
+            entries.reserve(header.total_stars);
+            for (uint32_t chunk_id = 0; chunk_id < header.total_chunks; ++chunk_id) {
+                if (!readChunk(chunk_id, records)) {
+                    return 1;
+                }
+                appendEntries(chunk_id, records);
+            }
+        }
+        std::cout << "Sorting " << entries.size() << " entries...\n";
+        std::sort(entries.begin(), entries.end(),
+            [](const SourceIdEntry& a, const SourceIdEntry& b) {
+                return a.source_id < b.source_id;
+            });
+    }
+    
+    SourceIndexHeader index_header{};
+    std::memcpy(index_header.magic, "GAIASIDX", 8);
+    index_header.version = 1;
+    index_header.flags = fences_only ? static_cast<uint32_t>(SOURCE_INDEX_FENCES_ONLY) : 0u;
+    index_header.total_stars = header.total_stars;
+    index_header.total_chunks = header.total_chunks;
+    index_header.fence_offset = sizeof(SourceIndexHeader);
+    index_header.entry_offset = index_header.fence_offset + fences.size() * sizeof(SourceIdFence);
+    index_header.num_entries = entries.size();
+    
+    // Write to a temporary name, then rename so readers never see a partial file
+    std::string index_path = catalog_dir + "/source_index.dat";
+    std::string tmp_path = index_path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot create: " << tmp_path << "\n";
+        return 1;
+    }
+    out.write(reinterpret_cast<const char*>(&index_header), sizeof(index_header));
+    out.write(reinterpret_cast<const char*>(fences.data()), fences.size() * sizeof(SourceIdFence));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(SourceIdEntry));
+    out.close();
+    if (!out || std::rename(tmp_path.c_str(), index_path.c_str()) != 0) {
+        std::cerr << "Failed to write: " << index_path << "\n";
+        std::remove(tmp_path.c_str());
+        return 1;
+    }
+    
+    auto end_time = std::chrono::steady_clock::now();
+    auto total_seconds = std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time).count();
+    uint64_t index_size = index_header.entry_offset + entries.size() * sizeof(SourceIdEntry);
+    
+    std::cout << "Index written to: " << index_path << "\n";
+    std::cout << "Index size: " << (index_size / 1024) << " KB\n";
+    std::cout << "Total time: " << total_seconds << " seconds\n";
+    
+    return 0;
+}
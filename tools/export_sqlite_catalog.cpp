@@ -0,0 +1,375 @@
+/**
+ * @file export_sqlite_catalog.cpp
+ * @brief Exports a multifile V2 catalog into a SQLite DR3 database
+ *
+ * Writes the stars / stars_spatial layout read by GaiaSqliteCatalog
+ * (the SQLITE_DR3 backend), so both backends can be compared on identical
+ * data:
+ * - stars is a WITHOUT ROWID table keyed on source_id. Gaia source ids
+ *   carry their level-12 NESTED HEALPix pixel in the high bits, so the
+ *   B-tree is in sky order and the rows of a cone share pages. Each chunk
+ *   is sorted by source_id and inserted in bulk transactions.
+ * - The stars_spatial R*Tree is filled after the load, in one pass in key
+ *   order, instead of being updated on every insert.
+ * - Names and SAO/HD/HIP numbers come from CommonStarNames (embedded
+ *   table, a CSV file or the IAU JSON), followed by partial indexes on
+ *   those columns and ANALYZE.
+ *
+ * Usage: export_sqlite_catalog <catalog_dir> <output.db> [options]
+ *   --page-size N   Database page size in bytes (default 8192)
+ *   --max-mag G     Export only stars with G <= max-mag
+ *   --names FILE    Cross-IDs from a CSV file (default: embedded table)
+ *   --iau FILE      Cross-IDs from the IAU-CSN JSON catalog
+ */
+
+#include "ioc_gaialib/gaia_mag18_catalog_v2.h"
+#include "ioc_gaialib/common_star_names.h"
+#include "ioc_gaialib/iau_star_catalog_parser.h"
+#include <sqlite3.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <iomanip>
+#include <limits>
+#include <algorithm>
+
+using namespace ioc::gaia;
+
+namespace {
+
+// Rows per bulk-insert transaction
+constexpr uint64_t kRowsPerTransaction = 1000000;
+
+bool exec(sqlite3* db, const std::string& sql) {
+    char* error = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+        std::cerr << "SQLite error: " << (error ? error : sqlite3_errmsg(db))
+                  << "\n  in: " << sql << "\n";
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+// Missing values (NaN) are stored as NULL
+void bindReal(sqlite3_stmt* stmt, int index, double value) {
+    if (std::isnan(value)) {
+        sqlite3_bind_null(stmt, index);
+    } else {
+        sqlite3_bind_double(stmt, index, value);
+    }
+}
+
+// Catalog number from "1234" or "HD 1234"; -1 if absent or not a number
+int64_t parseCatalogNumber(const std::string& designation) {
+    size_t last_space = designation.find_last_of(' ');
+    std::string numeric = (last_space == std::string::npos) ? designation : designation.substr(last_space + 1);
+    try {
+        return numeric.empty() ? -1 : std::stoll(numeric);
+    } catch (...) {
+        return -1;
+    }
+}
+
+void bindCatalogNumber(sqlite3_stmt* stmt, int index, const std::string& designation) {
+    const int64_t number = parseCatalogNumber(designation);
+    if (number > 0) {
+        sqlite3_bind_int64(stmt, index, number);
+    } else {
+        sqlite3_bind_null(stmt, index);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <catalog_directory> <output.db> [--page-size N] "
+                  << "[--max-mag G] [--names FILE.csv] [--iau FILE.json]\n";
+        std::cerr << "Example: " << argv[0] << " ~/.catalog/gaia_mag18_v2_multifile gaia_dr3.db\n";
+        return 1;
+    }
+
+    std::string catalog_dir = argv[1];
+    std::string output_path = argv[2];
+    int page_size = 8192;
+    double max_mag = std::numeric_limits<double>::infinity();
+    std::string names_path;
+    std::string iau_path;
+    for (int i = 3; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--page-size") == 0 && i + 1 < argc) {
+            page_size = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--max-mag") == 0 && i + 1 < argc) {
+            max_mag = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--names") == 0 && i + 1 < argc) {
+            names_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--iau") == 0 && i + 1 < argc) {
+            iau_path = argv[++i];
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            return 1;
+        }
+    }
+    if (page_size < 512 || page_size > 65536 || (page_size & (page_size - 1)) != 0) {
+        std::cerr << "Page size must be a power of two between 512 and 65536\n";
+        return 1;
+    }
+
+    std::string metadata_path = catalog_dir + "/metadata.dat";
+    std::string chunks_dir = catalog_dir + "/chunks";
+
+    std::cout << "=== SQLite Catalog Export ===\n\n";
+    std::cout << "Catalog: " << catalog_dir << "\n";
+    std::cout << "Output: " << output_path << " (page size " << page_size << ")\n";
+
+    std::ifstream meta_in(metadata_path, std::ios::binary);
+    if (!meta_in) {
+        std::cerr << "Cannot open metadata file: " << metadata_path << "\n";
+        return 1;
+    }
+
+    Mag18CatalogHeaderV2 header;
+    meta_in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!meta_in) {
+        std::cerr << "Failed to read catalog header\n";
+        return 1;
+    }
+    meta_in.close();
+
+    std::cout << "Total stars: " << header.total_stars << "\n";
+    std::cout << "Total chunks: " << header.total_chunks << "\n\n";
+
+    // Build under a temporary name, then rename so readers never see a partial database
+    std::string tmp_path = output_path + ".tmp";
+    std::remove(tmp_path.c_str());
+    sqlite3* db = nullptr;
+    if (sqlite3_open(tmp_path.c_str(), &db) != SQLITE_OK) {
+        std::cerr << "Cannot create: " << tmp_path << "\n";
+        sqlite3_close(db);
+        return 1;
+    }
+    auto fail = [&]() {
+        sqlite3_close(db);
+        std::remove(tmp_path.c_str());
+        return 1;
+    };
+
+    // The file is rebuilt from scratch on failure: no journal, no fsync
+    if (!exec(db, "PRAGMA page_size = " + std::to_string(page_size)) ||
+        !exec(db, "PRAGMA journal_mode = OFF") ||
+        !exec(db, "PRAGMA synchronous = OFF") ||
+        !exec(db, "PRAGMA locking_mode = EXCLUSIVE") ||
+        !exec(db, "PRAGMA cache_size = -524288") ||
+        !exec(db, "PRAGMA temp_store = MEMORY")) {
+        return fail();
+    }
+
+    // Column order is the one GaiaSqliteCatalog reads: 0-8, then hd, hip, sao at 12-14
+    if (!exec(db, "CREATE TABLE stars ("
+                  "sid INTEGER PRIMARY KEY, ra REAL NOT NULL, dec REAL NOT NULL, "
+                  "pmra REAL, pmdec REAL, parallax REAL, mag REAL, ruwe REAL, name TEXT, "
+                  "bp_rp REAL, bp_mag REAL, rp_mag REAL, hd INTEGER, hip INTEGER, sao INTEGER"
+                  ") WITHOUT ROWID")) {
+        return fail();
+    }
+
+    sqlite3_stmt* insert = nullptr;
+    if (sqlite3_prepare_v2(db, "INSERT INTO stars (sid, ra, dec, pmra, pmdec, parallax, mag, ruwe, "
+                               "bp_rp, bp_mag, rp_mag) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+                           -1, &insert, nullptr) != SQLITE_OK) {
+        std::cerr << "SQLite error: " << sqlite3_errmsg(db) << "\n";
+        return fail();
+    }
+
+    uint64_t total_processed = 0;
+    uint64_t total_exported = 0;
+    uint64_t rows_in_transaction = 0;
+    auto start_time = std::chrono::steady_clock::now();
+
+    if (!exec(db, "BEGIN")) {
+        sqlite3_finalize(insert);
+        return fail();
+    }
+
+    for (uint32_t chunk_id = 0; chunk_id < header.total_chunks; ++chunk_id) {
+        char chunk_name[32];
+        snprintf(chunk_name, sizeof(chunk_name), "/chunk_%03u.dat", chunk_id);
+        std::string chunk_path = chunks_dir + chunk_name;
+
+        std::ifstream chunk_file(chunk_path, std::ios::binary);
+        if (!chunk_file) {
+            std::cerr << "\nCannot open chunk: " << chunk_path << "\n";
+            sqlite3_finalize(insert);
+            return fail();
+        }
+
+        chunk_file.seekg(0, std::ios::end);
+        size_t file_size = chunk_file.tellg();
+        size_t num_records = file_size / sizeof(Mag18RecordV2);
+        chunk_file.seekg(0);
+
+        std::vector<Mag18RecordV2> records(num_records);
+        chunk_file.read(reinterpret_cast<char*>(records.data()),
+                        num_records * sizeof(Mag18RecordV2));
+        if (!chunk_file) {
+            std::cerr << "\nFailed to read chunk: " << chunk_path << "\n";
+            sqlite3_finalize(insert);
+            return fail();
+        }
+
+        // Key order keeps B-tree inserts appending instead of splitting pages
+        std::sort(records.begin(), records.end(),
+            [](const Mag18RecordV2& a, const Mag18RecordV2& b) {
+                return a.source_id < b.source_id;
+            });
+
+        for (const auto& record : records) {
+            if (record.g_mag > max_mag) continue;
+
+            sqlite3_reset(insert);
+            sqlite3_bind_int64(insert, 1, static_cast<sqlite3_int64>(record.source_id));
+            sqlite3_bind_double(insert, 2, record.ra);
+            sqlite3_bind_double(insert, 3, record.dec);
+            bindReal(insert, 4, record.pmra);
+            bindReal(insert, 5, record.pmdec);
+            bindReal(insert, 6, record.parallax);
+            bindReal(insert, 7, record.g_mag);
+            bindReal(insert, 8, record.ruwe);
+            bindReal(insert, 9, record.bp_rp);
+            bindReal(insert, 10, record.bp_mag);
+            bindReal(insert, 11, record.rp_mag);
+            if (sqlite3_step(insert) != SQLITE_DONE) {
+                std::cerr << "\nInsert failed for source_id " << record.source_id << ": "
+                          << sqlite3_errmsg(db) << "\n";
+                sqlite3_finalize(insert);
+                return fail();
+            }
+
+            ++total_exported;
+            if (++rows_in_transaction >= kRowsPerTransaction) {
+                sqlite3_reset(insert);
+                if (!exec(db, "COMMIT") || !exec(db, "BEGIN")) {
+                    sqlite3_finalize(insert);
+                    return fail();
+                }
+                rows_in_transaction = 0;
+            }
+        }
+
+        total_processed += num_records;
+
+        if ((chunk_id + 1) % 20 == 0 || chunk_id == header.total_chunks - 1) {
+            auto now = std::chrono::steady_clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
+            double progress = 100.0 * (chunk_id + 1) / header.total_chunks;
+            std::cout << "\rProcessed chunk " << (chunk_id + 1) << "/" << header.total_chunks
+                      << " (" << std::fixed << std::setprecision(1) << progress << "%) "
+                      << total_exported << " stars, " << elapsed << "s" << std::flush;
+        }
+    }
+    std::cout << "\n\n";
+
+    sqlite3_finalize(insert);
+    if (!exec(db, "COMMIT")) {
+        return fail();
+    }
+
+    if (total_processed != header.total_stars) {
+        std::cerr << "Star count mismatch: header says " << header.total_stars
+                  << ", chunks contain " << total_processed << "\n";
+        return fail();
+    }
+
+    // Deferred spatial index: one pass in key (sky) order after the bulk load
+    std::cout << "Building R*Tree...\n";
+    if (!exec(db, "CREATE VIRTUAL TABLE stars_spatial USING rtree(id, min_ra, max_ra, min_dec, max_dec)") ||
+        !exec(db, "BEGIN") ||
+        !exec(db, "INSERT INTO stars_spatial SELECT sid, ra, ra, dec, dec FROM stars ORDER BY sid") ||
+        !exec(db, "COMMIT")) {
+        return fail();
+    }
+
+    // Cross-IDs
+    CommonStarNames star_names;
+    bool names_loaded = false;
+    if (!iau_path.empty()) {
+        names_loaded = IAUStarCatalogParser::loadFromJSON(iau_path, star_names);
+    } else if (!names_path.empty()) {
+        names_loaded = star_names.loadDatabase(names_path);
+    } else {
+        names_loaded = star_names.loadDefaultDatabase();
+    }
+    if (!names_loaded) {
+        std::cerr << "Cannot load cross-identifications\n";
+        return fail();
+    }
+
+    sqlite3_stmt* update = nullptr;
+    if (sqlite3_prepare_v2(db, "UPDATE stars SET name = ?, hd = ?, hip = ?, sao = ? WHERE sid = ?",
+                           -1, &update, nullptr) != SQLITE_OK) {
+        std::cerr << "SQLite error: " << sqlite3_errmsg(db) << "\n";
+        return fail();
+    }
+
+    size_t cross_matched = 0;
+    if (!exec(db, "BEGIN")) {
+        sqlite3_finalize(update);
+        return fail();
+    }
+    for (const auto& entry : star_names.getSourceIdMap()) {
+        const CrossMatchInfo& info = entry.second;
+        sqlite3_reset(update);
+        if (info.common_name.empty()) {
+            sqlite3_bind_null(update, 1);
+        } else {
+            sqlite3_bind_text(update, 1, info.common_name.c_str(), -1, SQLITE_TRANSIENT);
+        }
+        bindCatalogNumber(update, 2, info.hd_designation);
+        bindCatalogNumber(update, 3, info.hip_designation);
+        bindCatalogNumber(update, 4, info.sao_designation);
+        sqlite3_bind_int64(update, 5, static_cast<sqlite3_int64>(entry.first));
+        if (sqlite3_step(update) != SQLITE_DONE) {
+            std::cerr << "Update failed for source_id " << entry.first << ": " << sqlite3_errmsg(db) << "\n";
+            sqlite3_finalize(update);
+            return fail();
+        }
+        cross_matched += sqlite3_changes(db);
+    }
+    sqlite3_finalize(update);
+    if (!exec(db, "COMMIT")) {
+        return fail();
+    }
+    std::cout << "Cross-identified " << cross_matched << " of " << star_names.size()
+              << " named stars\n";
+
+    // Partial indexes: most stars have no cross-ID
+    std::cout << "Indexing cross-IDs and analyzing...\n";
+    if (!exec(db, "CREATE INDEX stars_hd ON stars(hd) WHERE hd IS NOT NULL") ||
+        !exec(db, "CREATE INDEX stars_hip ON stars(hip) WHERE hip IS NOT NULL") ||
+        !exec(db, "CREATE INDEX stars_sao ON stars(sao) WHERE sao IS NOT NULL") ||
+        !exec(db, "CREATE INDEX stars_name ON stars(name) WHERE name IS NOT NULL") ||
+        !exec(db, "ANALYZE")) {
+        return fail();
+    }
+
+    sqlite3_close(db);
+    if (std::rename(tmp_path.c_str(), output_path.c_str()) != 0) {
+        std::cerr << "Failed to write: " << output_path << "\n";
+        std::remove(tmp_path.c_str());
+        return 1;
+    }
+
+    auto end_time = std::chrono::steady_clock::now();
+    auto total_seconds = std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time).count();
+
+    std::cout << "Database written to: " << output_path << "\n";
+    std::cout << "Stars exported: " << total_exported << "\n";
+    std::cout << "Total time: " << total_seconds << " seconds\n";
+
+    return 0;
+}
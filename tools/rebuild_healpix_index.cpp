@@ -4,137 +4,198 @@
  * 
  * This tool scans all chunks and creates a correct HEALPix index
  * that maps each pixel to the chunks containing stars in that pixel.
+ * Pixels are reference NESTED numbers (healpix::radec2pixNest) and the
+ * header is tagged with MAG18_FLAG_NESTED_INDEX, so the reader can cover
+ * a cone with exact pixel ranges instead of sampling it.
  * 
- * Usage: rebuild_healpix_index <catalog_dir>
+ * When every chunk is ordered by pixel, the index also stores a
+ * ChunkPixelInfo slice per (pixel, chunk) and sets MAG18_FLAG_PIXEL_SORTED,
+ * so cone queries read only the slices of intersecting pixels. Catalogs
+ * sorted by source_id are nearly pixel-ordered already (source_id encodes
+ * the level-12 NESTED pixel); --sort-chunks rewrites the chunks that are
+ * not, ordering records by (pixel, source_id).
+ * 
+ * --magnitude-order rewrites chunks in (pixel, G, source_id) order instead
+ * and sets MAG18_FLAG_MAGNITUDE_SORTED, so a query with a magnitude limit
+ * reads only the bright prefix of each slice. The order is detected on
+ * later runs, so the flag survives a rebuild without the option.
+ * 
+ * Chunks are processed by a pool of worker threads, each holding a single
+ * chunk in memory at a time. A worker reduces its chunk to one run per
+ * pixel and accumulates per-pixel counts in flat NPIX-sized arrays; the
+ * arrays are summed after the scan and the chunk lists are filled by a
+ * counting pass, so memory stays bounded by threads x chunk size plus the
+ * index itself.
+ * 
+ * Usage: rebuild_healpix_index <catalog_dir> [--sort-chunks] [--magnitude-order] [--threads N]
  */
 
+#include "ioc_gaialib/gaia_mag18_catalog_v2.h"
+#include "ioc_gaialib/healpix.h"
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <map>
-#include <set>
 #include <cmath>
 #include <chrono>
+#include <ctime>
 #include <iomanip>
-#include <filesystem>
 #include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include <mutex>
 
-// Record structure (must match Mag18RecordV2)
-#pragma pack(push, 4)
-struct Mag18RecordV2 {
-    uint64_t source_id;
-    double ra;
-    double dec;
-    float g_mag, bp_mag, rp_mag;
-    float g_mag_error, bp_mag_error, rp_mag_error;
-    float bp_rp;
-    float parallax, parallax_error;
-    float pmra, pmdec, pmra_error;
-    float ruwe;
-    uint16_t phot_bp_n_obs, phot_rp_n_obs;
-    uint32_t healpix_pixel;
-};
+using namespace ioc::gaia;
+
+namespace {
 
-struct Mag18CatalogHeaderV2 {
-    char magic[8];
-    uint32_t version;
-    uint32_t format_flags;
-    uint64_t total_stars;
-    uint64_t total_chunks;
-    uint32_t stars_per_chunk;
-    uint32_t healpix_nside;
-    double mag_limit;
-    double ra_min, ra_max;
-    double dec_min, dec_max;
-    uint64_t header_size;
-    uint64_t healpix_index_offset;
-    uint64_t healpix_index_size;
-    uint32_t num_healpix_pixels;
-    uint64_t chunk_index_offset;
-    uint64_t chunk_index_size;
-    uint64_t data_offset;
-    uint64_t data_size;
-    char creation_date[32];
-    char source_catalog[32];
-    char reserved[64];
+/**
+ * @brief Consecutive records of one chunk falling in the same pixel
+ *
+ * For chunks that are not pixel-ordered, first_star_offset is meaningless
+ * and num_stars is the total count of the pixel in the chunk.
+ */
+struct PixelRun {
+    uint32_t pixel;
+    uint32_t first_star_offset;
+    uint32_t num_stars;
 };
 
-// New index entry: maps pixel to chunks containing stars in that pixel
-struct PixelChunkEntry {
-    uint32_t pixel_id;
-    uint32_t num_chunks;      // Number of chunks with stars in this pixel
-    uint64_t chunk_list_offset;  // Offset into chunk list array
+struct ChunkResult {
+    std::vector<PixelRun> runs;   // Ascending pixel order
+    bool pixel_sorted = true;
+    bool magnitude_sorted = true;   // Ordered by G within each pixel (vacuous for skipped chunks)
+    bool rewritten = false;
 };
 
-struct ChunkPixelInfo {
-    uint32_t chunk_id;
-    uint32_t first_star_offset;  // Offset of first star of this pixel in chunk
-    uint32_t num_stars;          // Number of stars of this pixel in chunk
+/**
+ * @brief Per-thread accumulators, merged once after the scan
+ */
+struct WorkerState {
+    std::vector<uint32_t> chunks_per_pixel;  // Index entries per pixel
+    std::vector<uint32_t> stars_per_pixel;
+    std::vector<Mag18RecordV2> records;      // Reused chunk buffer
+    std::vector<uint32_t> pixels;
+    uint64_t stars = 0;
+    uint64_t bytes = 0;
 };
-#pragma pack(pop)
 
-static_assert(sizeof(Mag18RecordV2) == 84, "Mag18RecordV2 must be 84 bytes");
+std::string chunkPath(const std::string& chunks_dir, uint32_t chunk_id) {
+    char chunk_name[32];
+    snprintf(chunk_name, sizeof(chunk_name), "/chunk_%03u.dat", chunk_id);
+    return chunks_dir + chunk_name;
+}
+
+bool readChunk(const std::string& path, std::vector<Mag18RecordV2>& records, size_t& file_size) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    if (size < 0) {
+        std::fclose(file);
+        return false;
+    }
+    file_size = static_cast<size_t>(size);
+    records.resize(file_size / sizeof(Mag18RecordV2));
+    size_t read = std::fread(records.data(), sizeof(Mag18RecordV2), records.size(), file);
+    std::fclose(file);
+    return read == records.size();
+}
 
-const uint32_t NSIDE = 64;  // HEALPix NSIDE
-const uint32_t NPIX = 12 * NSIDE * NSIDE;  // 49152 pixels
+/**
+ * @brief Slice magnitude order: ascending G with missing values first
+ */
+bool brighterThan(float a, float b) {
+    if (std::isnan(a)) return !std::isnan(b);
+    if (std::isnan(b)) return false;
+    return a < b;
+}
 
-// HEALPix ang2pix_nest implementation
-uint32_t ang2pix_nest(double theta, double phi) {
-    const double z = cos(theta);
-    const double za = fabs(z);
-    const double TWOPI = 2.0 * M_PI;
-    const double HALFPI = M_PI / 2.0;
-    
-    if (za <= 2.0/3.0) {
-        // Equatorial region
-        const double temp1 = NSIDE * (0.5 + phi / TWOPI);
-        const double temp2 = NSIDE * z * 0.75;
-        const int32_t jp = static_cast<int32_t>(temp1 - temp2);
-        const int32_t jm = static_cast<int32_t>(temp1 + temp2);
-        const int32_t ir = NSIDE + 1 + jp - jm;
-        const int32_t kshift = 1 - (ir & 1);
-        const int32_t ip = (jp + jm - NSIDE + kshift + 1) / 2;
-        const int32_t iphi = ip % (4 * NSIDE);
-        
-        return (ir - 1) * 4 * NSIDE + iphi;
+/**
+ * @brief Check that a pixel-ordered chunk is ordered by G within each pixel
+ */
+bool isMagnitudeOrdered(const std::vector<Mag18RecordV2>& records, const std::vector<uint32_t>& pixels) {
+    for (size_t i = 1; i < records.size(); ++i) {
+        if (pixels[i] == pixels[i - 1] && brighterThan(records[i].g_mag, records[i - 1].g_mag)) {
+            return false;
+        }
     }
+    return true;
+}
+
+/**
+ * @brief Reorder a chunk by (pixel, source_id), or by (pixel, G, source_id)
+ *        with by_magnitude, and replace its file atomically
+ */
+bool rewriteSorted(const std::string& path, std::vector<Mag18RecordV2>& records,
+                   std::vector<uint32_t>& pixels, bool by_magnitude) {
+    const size_t n = records.size();
+    std::vector<uint32_t> order(n);
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        if (pixels[a] != pixels[b]) return pixels[a] < pixels[b];
+        if (by_magnitude) {
+            if (brighterThan(records[a].g_mag, records[b].g_mag)) return true;
+            if (brighterThan(records[b].g_mag, records[a].g_mag)) return false;
+        }
+        return records[a].source_id < records[b].source_id;
+    });
     
-    // Polar caps
-    const double tp = phi / HALFPI;
-    const double tmp = NSIDE * sqrt(3.0 * (1.0 - za));
-    int32_t jp = static_cast<int32_t>(tp * tmp);
-    int32_t jm = static_cast<int32_t>((1.0 - tp) * tmp);
-    
-    if (jp >= NSIDE) jp = NSIDE - 1;
-    if (jm >= NSIDE) jm = NSIDE - 1;
+    std::vector<Mag18RecordV2> sorted_records(n);
+    for (size_t i = 0; i < n; ++i) {
+        sorted_records[i] = records[order[i]];
+    }
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = pixels[order[i]];
+    }
+    records.swap(sorted_records);
+    pixels.swap(order);
     
-    if (z > 0) {
-        // North polar cap
-        const int32_t face = static_cast<int32_t>(phi * 2.0 / M_PI);
-        return face * NSIDE * NSIDE + jp * NSIDE + jm;
-    } else {
-        // South polar cap
-        const int32_t face = static_cast<int32_t>(phi * 2.0 / M_PI) + 8;
-        return face * NSIDE * NSIDE + jp * NSIDE + jm;
+    std::string tmp_path = path + ".tmp";
+    FILE* out = std::fopen(tmp_path.c_str(), "wb");
+    if (!out) {
+        return false;
     }
+    bool ok = std::fwrite(records.data(), sizeof(Mag18RecordV2), n, out) == n;
+    ok = (std::fclose(out) == 0) && ok;
+    if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
 }
 
-uint32_t getHEALPixPixel(double ra, double dec) {
-    double theta = (90.0 - dec) * M_PI / 180.0;  // Colatitude
-    double phi = ra * M_PI / 180.0;               // Longitude
-    if (phi < 0) phi += 2 * M_PI;
-    if (phi >= 2 * M_PI) phi -= 2 * M_PI;
-    return ang2pix_nest(theta, phi);
-}
+} // namespace
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <catalog_directory>\n";
+        std::cerr << "Usage: " << argv[0] << " <catalog_directory> [--sort-chunks] [--magnitude-order] [--threads N]\n";
         std::cerr << "Example: " << argv[0] << " ~/.catalog/gaia_mag18_v2_multifile\n";
         return 1;
     }
     
     std::string catalog_dir = argv[1];
+    bool sort_chunks = false;
+    bool magnitude_order = false;
+    unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--sort-chunks") == 0) {
+            sort_chunks = true;
+        } else if (std::strcmp(argv[i], "--magnitude-order") == 0) {
+            magnitude_order = true;
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            return 1;
+        }
+    }
     std::string metadata_path = catalog_dir + "/metadata.dat";
     std::string chunks_dir = catalog_dir + "/chunks";
     
@@ -152,100 +213,236 @@ int main(int argc, char* argv[]) {
     meta_in.read(reinterpret_cast<char*>(&header), sizeof(header));
     meta_in.close();
     
+    if (!healpix::isValidNside(header.healpix_nside)) {
+        std::cerr << "Invalid HEALPix NSIDE in header: " << header.healpix_nside << "\n";
+        return 1;
+    }
+    const uint32_t NPIX = healpix::npix(header.healpix_nside);
+    const uint32_t total_chunks = static_cast<uint32_t>(header.total_chunks);
+    num_threads = std::min<unsigned>(num_threads, std::max(1u, total_chunks));
+    
     std::cout << "Total stars: " << header.total_stars << "\n";
     std::cout << "Total chunks: " << header.total_chunks << "\n";
     std::cout << "HEALPix NSIDE: " << header.healpix_nside << "\n";
-    std::cout << "Max pixels: " << NPIX << "\n\n";
+    std::cout << "Max pixels: " << NPIX << "\n";
+    std::cout << "Threads: " << num_threads << "\n\n";
     
-    // Map: pixel_id -> set of chunk_ids that contain stars in that pixel
-    std::map<uint32_t, std::set<uint32_t>> pixel_to_chunks;
-    
-    // Detailed map: (pixel_id, chunk_id) -> count of stars
-    std::map<std::pair<uint32_t, uint32_t>, uint32_t> pixel_chunk_counts;
+    std::vector<ChunkResult> results(total_chunks);
+    std::vector<WorkerState> workers(num_threads);
+    std::atomic<uint32_t> next_chunk{0};
+    std::atomic<uint32_t> chunks_done{0};
+    std::atomic<uint32_t> missing_chunks{0};
+    std::atomic<bool> failed{false};
+    std::mutex log_mutex;
     
     auto start_time = std::chrono::steady_clock::now();
     
-    // Scan all chunks
-    uint64_t total_processed = 0;
-    for (uint32_t chunk_id = 0; chunk_id < header.total_chunks; ++chunk_id) {
-        char chunk_name[32];
-        snprintf(chunk_name, sizeof(chunk_name), "/chunk_%03u.dat", chunk_id);
-        std::string chunk_path = chunks_dir + chunk_name;
+    auto worker_main = [&](WorkerState& state) {
+        state.chunks_per_pixel.assign(NPIX, 0);
+        state.stars_per_pixel.assign(NPIX, 0);
         
-        std::ifstream chunk_file(chunk_path, std::ios::binary);
-        if (!chunk_file) {
-            std::cerr << "Cannot open chunk: " << chunk_path << "\n";
-            continue;
+        for (uint32_t chunk_id = next_chunk++; chunk_id < total_chunks && !failed;
+             chunk_id = next_chunk++) {
+            std::string chunk_path = chunkPath(chunks_dir, chunk_id);
+            size_t file_size = 0;
+            if (!readChunk(chunk_path, state.records, file_size)) {
+                std::lock_guard<std::mutex> lock(log_mutex);
+                std::cerr << "\nCannot read chunk: " << chunk_path << "\n";
+                missing_chunks++;
+                chunks_done++;
+                continue;
+            }
+            
+            auto& records = state.records;
+            auto& pixels = state.pixels;
+            const size_t num_records = records.size();
+            pixels.resize(num_records);
+            for (size_t i = 0; i < num_records; ++i) {
+                pixels[i] = healpix::radec2pixNest(header.healpix_nside, records[i].ra, records[i].dec);
+            }
+            
+            ChunkResult& result = results[chunk_id];
+            const bool pixel_ordered = std::is_sorted(pixels.begin(), pixels.end());
+            const bool magnitude_ordered = pixel_ordered && isMagnitudeOrdered(records, pixels);
+            if ((!pixel_ordered && sort_chunks) || (magnitude_order && !magnitude_ordered)) {
+                if (!rewriteSorted(chunk_path, records, pixels, magnitude_order)) {
+                    std::lock_guard<std::mutex> lock(log_mutex);
+                    std::cerr << "\nFailed to rewrite chunk: " << chunk_path << "\n";
+                    failed = true;
+                    break;
+                }
+                result.rewritten = true;
+                result.magnitude_sorted = magnitude_order || isMagnitudeOrdered(records, pixels);
+            } else if (!pixel_ordered) {
+                // Only the distinct pixels are needed: collapse a sorted copy
+                result.pixel_sorted = false;
+                result.magnitude_sorted = false;
+                std::sort(pixels.begin(), pixels.end());
+            } else {
+                result.magnitude_sorted = magnitude_ordered;
+            }
+            
+            // One run per pixel (offsets are meaningful for ordered chunks only)
+            for (size_t start = 0; start < num_records; ) {
+                size_t end = start + 1;
+                while (end < num_records && pixels[end] == pixels[start]) ++end;
+                
+                uint32_t pixel = pixels[start];
+                if (pixel < NPIX) {
+                    result.runs.push_back({pixel, static_cast<uint32_t>(start),
+                                           static_cast<uint32_t>(end - start)});
+                    state.chunks_per_pixel[pixel]++;
+                    state.stars_per_pixel[pixel] += static_cast<uint32_t>(end - start);
+                }
+                start = end;
+            }
+            
+            state.stars += num_records;
+            state.bytes += file_size;
+            chunks_done++;
         }
-        
-        // Get chunk size
-        chunk_file.seekg(0, std::ios::end);
-        size_t file_size = chunk_file.tellg();
-        size_t num_records = file_size / sizeof(Mag18RecordV2);
-        chunk_file.seekg(0);
-        
-        // Read all records
-        std::vector<Mag18RecordV2> records(num_records);
-        chunk_file.read(reinterpret_cast<char*>(records.data()), file_size);
-        
-        // Process each record
-        for (const auto& record : records) {
-            uint32_t pixel = getHEALPixPixel(record.ra, record.dec);
-            if (pixel < NPIX) {
-                pixel_to_chunks[pixel].insert(chunk_id);
-                pixel_chunk_counts[{pixel, chunk_id}]++;
+    };
+    
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (unsigned t = 0; t < num_threads; ++t) {
+        threads.emplace_back(worker_main, std::ref(workers[t]));
+    }
+    
+    // Progress from the main thread while the workers scan
+    uint32_t last_reported = 0;
+    while (true) {
+        uint32_t done = chunks_done.load();
+        if (done != last_reported || done == total_chunks || failed) {
+            auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+            double progress = total_chunks > 0 ? 100.0 * done / total_chunks : 100.0;
+            {
+                std::lock_guard<std::mutex> lock(log_mutex);
+                std::cout << "\rProcessed chunk " << done << "/" << total_chunks 
+                          << " (" << std::fixed << std::setprecision(1) << progress << "%) "
+                          << std::setprecision(0) << elapsed << "s" << std::flush;
             }
+            last_reported = done;
         }
-        
-        total_processed += num_records;
-        
-        if ((chunk_id + 1) % 20 == 0 || chunk_id == header.total_chunks - 1) {
-            auto now = std::chrono::steady_clock::now();
-            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
-            double progress = 100.0 * (chunk_id + 1) / header.total_chunks;
-            std::cout << "\rProcessed chunk " << (chunk_id + 1) << "/" << header.total_chunks 
-                      << " (" << std::fixed << std::setprecision(1) << progress << "%) "
-                      << total_processed << " stars, " << elapsed << "s" << std::flush;
+        if (done == total_chunks || failed) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (failed) {
+        return 1;
+    }
+    
+    auto scan_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    
+    // Merge per-thread counts
+    std::vector<uint32_t> chunks_per_pixel(NPIX, 0);
+    std::vector<uint32_t> stars_per_pixel(NPIX, 0);
+    uint64_t total_processed = 0;
+    uint64_t total_bytes = 0;
+    for (auto& state : workers) {
+        for (uint32_t p = 0; p < NPIX; ++p) {
+            chunks_per_pixel[p] += state.chunks_per_pixel[p];
+            stars_per_pixel[p] += state.stars_per_pixel[p];
         }
+        total_processed += state.stars;
+        total_bytes += state.bytes;
+        state = WorkerState();
     }
     
-    std::cout << "\n\nBuilding new index...\n";
+    bool all_pixel_sorted = true;
+    bool all_magnitude_sorted = true;
+    uint32_t chunks_rewritten = 0;
+    for (const auto& result : results) {
+        all_pixel_sorted = all_pixel_sorted && result.pixel_sorted;
+        all_magnitude_sorted = all_magnitude_sorted && result.magnitude_sorted;
+        chunks_rewritten += result.rewritten ? 1 : 0;
+    }
+    
+    double stars_per_second = scan_seconds > 0 ? total_processed / scan_seconds : 0.0;
+    double mb_per_second = scan_seconds > 0 ? total_bytes / (1024.0 * 1024.0) / scan_seconds : 0.0;
+    std::cout << "\n\nScanned " << total_processed << " stars in " 
+              << std::setprecision(2) << scan_seconds << "s ("
+              << std::setprecision(0) << stars_per_second << " stars/s, "
+              << std::setprecision(1) << mb_per_second << " MB/s)\n";
+    if (missing_chunks > 0) {
+        std::cout << "Unreadable chunks skipped: " << missing_chunks << "\n";
+    }
+    
+    std::cout << "\nBuilding new index...\n";
     
     // Statistics
-    uint32_t pixels_with_data = pixel_to_chunks.size();
+    uint32_t pixels_with_data = 0;
     uint32_t max_chunks_per_pixel = 0;
+    uint32_t max_stars_per_pixel = 0;
     uint64_t total_entries = 0;
     
-    for (const auto& [pixel, chunks] : pixel_to_chunks) {
-        max_chunks_per_pixel = std::max(max_chunks_per_pixel, static_cast<uint32_t>(chunks.size()));
-        total_entries += chunks.size();
+    for (uint32_t p = 0; p < NPIX; ++p) {
+        if (chunks_per_pixel[p] == 0) continue;
+        pixels_with_data++;
+        max_chunks_per_pixel = std::max(max_chunks_per_pixel, chunks_per_pixel[p]);
+        max_stars_per_pixel = std::max(max_stars_per_pixel, stars_per_pixel[p]);
+        total_entries += chunks_per_pixel[p];
     }
     
     std::cout << "Pixels with data: " << pixels_with_data << " / " << NPIX << "\n";
     std::cout << "Max chunks per pixel: " << max_chunks_per_pixel << "\n";
-    std::cout << "Total index entries: " << total_entries << "\n\n";
+    std::cout << "Max stars per pixel: " << max_stars_per_pixel << "\n";
+    std::cout << "Total index entries: " << total_entries << "\n";
+    if (chunks_rewritten > 0) {
+        std::cout << "Chunks rewritten in " << (magnitude_order ? "pixel/magnitude" : "pixel")
+                  << " order: " << chunks_rewritten << "\n";
+    }
+    std::cout << "Pixel-sorted layout: " << (all_pixel_sorted ? "yes" : "no (run with --sort-chunks)") << "\n";
+    std::cout << "Magnitude-ordered slices: " << (all_magnitude_sorted ? "yes" : "no (run with --magnitude-order)") << "\n\n";
+    
+    // Rewritten chunks invalidate any source_id sidecar (in-chunk offsets moved)
+    if (chunks_rewritten > 0) {
+        std::string source_index_path = catalog_dir + "/source_index.dat";
+        if (std::remove(source_index_path.c_str()) == 0) {
+            std::cout << "Removed stale " << source_index_path << " (rerun build_source_index)\n\n";
+        }
+    }
     
     // Build compact index structure
     // Format: 
     //   1. Array of PixelChunkEntry (one per pixel with data)
     //   2. Array of chunk_ids (variable length per pixel)
+    //   3. Pixel-sorted layout only: ChunkPixelInfo per chunk_id in (2)
     
     std::vector<PixelChunkEntry> pixel_index;
-    std::vector<uint32_t> chunk_lists;
+    std::vector<uint32_t> chunk_lists(total_entries);
+    std::vector<ChunkPixelInfo> slices(all_pixel_sorted ? total_entries : 0);
     
+    // Counting pass: each pixel's list starts at the prefix sum of its count,
+    // and visiting chunks in ascending order keeps every list sorted
     pixel_index.reserve(pixels_with_data);
-    chunk_lists.reserve(total_entries);
-    
-    for (const auto& [pixel, chunks] : pixel_to_chunks) {
+    std::vector<uint32_t>& cursor = chunks_per_pixel;  // Reused as fill position
+    uint32_t offset = 0;
+    for (uint32_t p = 0; p < NPIX; ++p) {
+        uint32_t count = chunks_per_pixel[p];
+        if (count == 0) continue;
+        
         PixelChunkEntry entry;
-        entry.pixel_id = pixel;
-        entry.num_chunks = chunks.size();
-        entry.chunk_list_offset = chunk_lists.size();
+        entry.pixel_id = p;
+        entry.num_chunks = count;
+        entry.chunk_list_offset = offset;
         pixel_index.push_back(entry);
         
-        for (uint32_t chunk_id : chunks) {
-            chunk_lists.push_back(chunk_id);
+        cursor[p] = offset;
+        offset += count;
+    }
+    
+    for (uint32_t chunk_id = 0; chunk_id < total_chunks; ++chunk_id) {
+        for (const PixelRun& run : results[chunk_id].runs) {
+            uint32_t pos = cursor[run.pixel]++;
+            chunk_lists[pos] = chunk_id;
+            if (all_pixel_sorted) {
+                slices[pos] = {chunk_id, run.first_star_offset, run.num_stars};
+            }
         }
+        results[chunk_id].runs = std::vector<PixelRun>();
     }
     
     // Write new metadata file
@@ -253,10 +450,22 @@ int main(int argc, char* argv[]) {
     std::ofstream meta_out(new_metadata_path, std::ios::binary);
     
     // Update header
+    header.format_flags |= MAG18_FLAG_NESTED_INDEX;
+    if (all_pixel_sorted) {
+        header.format_flags |= MAG18_FLAG_PIXEL_SORTED;
+    } else {
+        header.format_flags &= ~MAG18_FLAG_PIXEL_SORTED;
+    }
+    if (all_pixel_sorted && all_magnitude_sorted) {
+        header.format_flags |= MAG18_FLAG_MAGNITUDE_SORTED;
+    } else {
+        header.format_flags &= ~MAG18_FLAG_MAGNITUDE_SORTED;
+    }
     header.num_healpix_pixels = pixels_with_data;
     header.healpix_index_offset = sizeof(Mag18CatalogHeaderV2);
     header.healpix_index_size = pixel_index.size() * sizeof(PixelChunkEntry) + 
-                                chunk_lists.size() * sizeof(uint32_t);
+                                chunk_lists.size() * sizeof(uint32_t) +
+                                slices.size() * sizeof(ChunkPixelInfo);
     
     // Get current time for creation date
     auto now = std::chrono::system_clock::now();
@@ -275,14 +484,22 @@ int main(int argc, char* argv[]) {
     meta_out.write(reinterpret_cast<const char*>(chunk_lists.data()),
                    chunk_lists.size() * sizeof(uint32_t));
     
+    // Write pixel slices
+    meta_out.write(reinterpret_cast<const char*>(slices.data()),
+                   slices.size() * sizeof(ChunkPixelInfo));
+    
     meta_out.close();
+    if (!meta_out) {
+        std::cerr << "Failed to write " << new_metadata_path << "\n";
+        return 1;
+    }
     
     auto end_time = std::chrono::steady_clock::now();
-    auto total_seconds = std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time).count();
+    auto total_seconds = std::chrono::duration<double>(end_time - start_time).count();
     
     std::cout << "New index written to: " << new_metadata_path << "\n";
     std::cout << "Index size: " << (header.healpix_index_size / 1024) << " KB\n";
-    std::cout << "Total time: " << total_seconds << " seconds\n\n";
+    std::cout << "Total time: " << std::setprecision(1) << total_seconds << " seconds\n\n";
     
     std::cout << "To apply the new index, run:\n";
     std::cout << "  mv " << metadata_path << " " << catalog_dir << "/metadata_old.dat\n";